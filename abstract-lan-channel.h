@@ -0,0 +1,594 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ABSTRACT_LAN_CHANNEL_H
+#define ABSTRACT_LAN_CHANNEL_H
+
+//
+// Statistical stand-in for the 802.11 PHY and MAC of a LAN.
+//
+// The stations get SimpleNetDevices on an AbstractLanChannel instead of
+// wifi devices on a Yans channel.  The channel has no PHY state machine
+// nor interference tracking: a frame occupies the shared medium for a
+// random backoff, a fixed overhead (DIFS, preamble, and SIFS and ACK for
+// unicast) and its bytes at the data rate, after the frames sent before
+// it; it is lost if it would wait longer than MaxDelay, like a full MAC
+// queue.  Each receiver in range, where the frame arrives above the
+// RxSensitivity of a wifi PHY, gets it with the probability looked up in
+// a PerTable by the SNR of the link, computed from the same propagation
+// loss as the Yans channel.  A unicast frame that is lost is sent again,
+// with a doubled contention window, up to MaxAttempts times.
+//
+// The PerTable holds the frame error rate in 1 dB SNR bins.  It is
+// built by a LanPhyCalibrator from full-PHY runs: for every frame a
+// wifi PHY of the LAN starts sending, every other station of the LAN in
+// range makes an attempt in the bin of its SNR, which succeeds if its
+// PHY receives the frame.  Collisions and hidden stations are thus part
+// of the measured error rate.  Tables are CSV files:
+//
+//   snrDb,attempts,successes,per
+//
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/data-rate.h"
+#include "ns3/double.h"
+#include "ns3/mac48-address.h"
+#include "ns3/mobility-model.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/traced-callback.h"
+#include "ns3/uinteger.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+
+namespace ns3 {
+
+/**
+ * \brief Frame error rate by SNR, measured or loaded from a file.
+ */
+class PerTable : public SimpleRefCount<PerTable>
+{
+public:
+  static const int32_t MIN_SNR = -10;       //!< SNR (dB) of the first bin
+  static const int32_t MAX_SNR = 60;        //!< SNR (dB) of the last bin
+  static const uint64_t MIN_ATTEMPTS = 20;  //!< attempts of a bin used as measured
+
+  PerTable ()
+    : m_attempts (MAX_SNR - MIN_SNR + 1, 0),
+      m_successes (MAX_SNR - MIN_SNR + 1, 0),
+      m_dirty (true)
+  {
+  }
+
+  /// \param snrDb SNR of a link \return its bin
+  static uint32_t GetBin (double snrDb)
+  {
+    double bin = std::floor (snrDb) - MIN_SNR;
+    return static_cast<uint32_t> (std::min (std::max (bin, 0.0), double (MAX_SNR - MIN_SNR)));
+  }
+
+  /**
+   * \brief Count a reception attempt.
+   * \param bin the bin of its SNR
+   * \param success true if the frame was received
+   */
+  void AddAttempt (uint32_t bin, bool success)
+  {
+    ++m_attempts[bin];
+    m_successes[bin] += success ? 1 : 0;
+    m_dirty = true;
+  }
+
+  /// \brief Turn a failed attempt of a bin into a success.
+  void AddSuccess (uint32_t bin)
+  {
+    ++m_successes[bin];
+    m_dirty = true;
+  }
+
+  /**
+   * \param snrDb SNR of a link
+   * \return the error rate of its bin; bins with too few attempts are
+   *         interpolated between their neighbours, and the error rate
+   *         never grows with the SNR
+   */
+  double GetPer (double snrDb)
+  {
+    if (m_dirty)
+      {
+        Smooth ();
+      }
+    return m_per[GetBin (snrDb)];
+  }
+
+  /// \param filename a table written by Write
+  void Load (std::string filename)
+  {
+    std::ifstream is (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (is.is_open (), "PerTable: cannot open " << filename);
+    std::string line;
+    std::getline (is, line);
+    while (std::getline (is, line))
+      {
+        std::replace (line.begin (), line.end (), ',', ' ');
+        std::istringstream fields (line);
+        int32_t snr;
+        uint64_t attempts;
+        uint64_t successes;
+        NS_ABORT_MSG_UNLESS (fields >> snr >> attempts >> successes && snr >= MIN_SNR && snr <= MAX_SNR,
+                             filename << ": bad row " << line);
+        m_attempts[snr - MIN_SNR] += attempts;
+        m_successes[snr - MIN_SNR] += successes;
+      }
+    m_dirty = true;
+  }
+
+  /// \param os the output stream
+  void Write (std::ostream &os)
+  {
+    if (m_dirty)
+      {
+        Smooth ();
+      }
+    os << "snrDb,attempts,successes,per" << std::endl;
+    for (uint32_t i = 0; i < m_attempts.size (); ++i)
+      {
+        os << MIN_SNR + static_cast<int32_t> (i) << "," << m_attempts[i] << "," << m_successes[i]
+           << "," << m_per[i] << std::endl;
+      }
+  }
+
+  /// \return total attempts
+  uint64_t GetAttempts (void) const
+  {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < m_attempts.size (); ++i)
+      {
+        total += m_attempts[i];
+      }
+    return total;
+  }
+
+private:
+  void Smooth (void)
+  {
+    uint32_t n = m_attempts.size ();
+    std::vector<int32_t> measured;
+    for (uint32_t i = 0; i < n; ++i)
+      {
+        if (m_attempts[i] >= MIN_ATTEMPTS)
+          {
+            measured.push_back (i);
+          }
+      }
+    NS_ABORT_MSG_IF (measured.empty (), "PerTable: no bin has " << MIN_ATTEMPTS << " attempts");
+    m_per.assign (n, 0);
+    for (uint32_t i = 0; i < n; ++i)
+      {
+        std::vector<int32_t>::const_iterator hi = std::lower_bound (measured.begin (), measured.end (),
+                                                                    static_cast<int32_t> (i));
+        if (hi == measured.end ())
+          {
+            m_per[i] = Measured (measured.back ());
+          }
+        else if (*hi == static_cast<int32_t> (i) || hi == measured.begin ())
+          {
+            m_per[i] = Measured (*hi);
+          }
+        else
+          {
+            int32_t lo = *(hi - 1);
+            double w = double (i - lo) / (*hi - lo);
+            m_per[i] = (1 - w) * Measured (lo) + w * Measured (*hi);
+          }
+        if (i > 0)
+          {
+            m_per[i] = std::min (m_per[i], m_per[i - 1]);
+          }
+      }
+    m_dirty = false;
+  }
+
+  double Measured (uint32_t i) const
+  {
+    return 1 - double (m_successes[i]) / m_attempts[i];
+  }
+
+  std::vector<uint64_t> m_attempts;   //!< attempts of each bin
+  std::vector<uint64_t> m_successes;  //!< successes of each bin
+  std::vector<double> m_per;          //!< smoothed error rate of each bin
+  bool m_dirty;                       //!< m_per is out of date
+};
+
+/**
+ * \brief Shared medium of a LAN of SimpleNetDevices, with table-driven
+ * frame losses and a simple contention model.
+ */
+class AbstractLanChannel : public SimpleChannel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::AbstractLanChannel")
+      .SetParent<SimpleChannel> ()
+      .SetGroupName ("Network")
+      .AddConstructor<AbstractLanChannel> ()
+      .AddAttribute ("DataRate", "Rate of the frame bytes.",
+                     DataRateValue (DataRate ("54Mbps")),
+                     MakeDataRateAccessor (&AbstractLanChannel::m_rate),
+                     MakeDataRateChecker ())
+      .AddAttribute ("FrameOverhead", "Medium time of every frame besides its bytes: DIFS and preamble.",
+                     TimeValue (MicroSeconds (54)),
+                     MakeTimeAccessor (&AbstractLanChannel::m_frameOverhead),
+                     MakeTimeChecker ())
+      .AddAttribute ("AckOverhead", "Medium time of the SIFS and ACK of a unicast frame.",
+                     TimeValue (MicroSeconds (44)),
+                     MakeTimeAccessor (&AbstractLanChannel::m_ackOverhead),
+                     MakeTimeChecker ())
+      .AddAttribute ("HeaderBytes", "MAC header, LLC and FCS bytes added to every frame.",
+                     UintegerValue (36),
+                     MakeUintegerAccessor (&AbstractLanChannel::m_headerBytes),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddAttribute ("Slot", "Backoff slot.",
+                     TimeValue (MicroSeconds (9)),
+                     MakeTimeAccessor (&AbstractLanChannel::m_slot),
+                     MakeTimeChecker ())
+      .AddAttribute ("MinCw", "Contention window of a first attempt.",
+                     UintegerValue (15),
+                     MakeUintegerAccessor (&AbstractLanChannel::m_minCw),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddAttribute ("MaxCw", "Largest contention window.",
+                     UintegerValue (1023),
+                     MakeUintegerAccessor (&AbstractLanChannel::m_maxCw),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddAttribute ("MaxAttempts", "Attempts of a unicast frame.",
+                     UintegerValue (7),
+                     MakeUintegerAccessor (&AbstractLanChannel::m_maxAttempts),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("MaxDelay", "Longest wait for the medium before a frame is dropped.",
+                     TimeValue (MilliSeconds (500)),
+                     MakeTimeAccessor (&AbstractLanChannel::m_maxDelay),
+                     MakeTimeChecker ())
+      .AddAttribute ("TxPowerDbm", "Transmission power of the stations.",
+                     DoubleValue (16.0206),
+                     MakeDoubleAccessor (&AbstractLanChannel::m_txPowerDbm),
+                     MakeDoubleChecker<double> ())
+      .AddAttribute ("NoiseDbm", "Noise power at the receivers: thermal noise in 20 MHz and a 7 dB noise figure.",
+                     DoubleValue (-93.97),
+                     MakeDoubleAccessor (&AbstractLanChannel::m_noiseDbm),
+                     MakeDoubleChecker<double> ())
+      .AddAttribute ("RxSensitivity", "Weakest frame a station receives, as on WifiPhy; farther stations are out of range.",
+                     DoubleValue (-101.0),
+                     MakeDoubleAccessor (&AbstractLanChannel::m_rxSensitivityDbm),
+                     MakeDoubleChecker<double> ())
+      .AddTraceSource ("Rx", "A frame was delivered to a station.",
+                       MakeTraceSourceAccessor (&AbstractLanChannel::m_rxTrace),
+                       "ns3::Packet::TracedCallback")
+    ;
+    return tid;
+  }
+
+  AbstractLanChannel ()
+    : m_busyUntil (Seconds (0)),
+      m_frames (0),
+      m_deliveries (0),
+      m_losses (0),
+      m_retries (0),
+      m_overflows (0)
+  {
+    m_loss = CreateObject<LogDistancePropagationLossModel> ();
+    m_delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
+    m_backoff = CreateObject<UniformRandomVariable> ();
+    m_error = CreateObject<UniformRandomVariable> ();
+  }
+
+  /// \param loss loss of the links; log-distance, as on YansWifiChannelHelper::Default, if not set
+  void SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+  {
+    m_loss = loss;
+  }
+
+  /// \param delay delay of the links; constant speed if not set
+  void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+  {
+    m_delay = delay;
+  }
+
+  /// \param table the frame error rate by SNR
+  void SetTable (Ptr<PerTable> table)
+  {
+    m_table = table;
+  }
+
+  /// \param stream first stream \return number of streams used
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_backoff->SetStream (stream);
+    m_error->SetStream (stream + 1);
+    return 2;
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    os << "AbstractLanChannel: " << m_frames << " frames, " << m_deliveries << " deliveries, "
+       << m_losses << " losses, " << m_retries << " retries, " << m_overflows << " dropped waiting for the medium"
+       << std::endl;
+  }
+
+  // inherited from SimpleChannel
+  virtual void Add (Ptr<SimpleNetDevice> device)
+  {
+    SimpleChannel::Add (device);
+    m_devices.push_back (device);
+  }
+
+  virtual void Send (Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from,
+                     Ptr<SimpleNetDevice> sender)
+  {
+    NS_ABORT_MSG_IF (m_table == 0, "AbstractLanChannel: no PerTable");
+    ++m_frames;
+    Time now = Simulator::Now ();
+    Time airtime = m_frameOverhead + m_rate.CalculateBytesTxTime (p->GetSize () + m_headerBytes);
+    Ptr<MobilityModel> a = sender->GetNode ()->GetObject<MobilityModel> ();
+    Time start = std::max (now, m_busyUntil);
+    if (to.IsBroadcast () || to.IsGroup ())
+      {
+        // One attempt, which every station receives on its own
+        start += m_slot * m_backoff->GetInteger (0, m_minCw);
+        if (start - now > m_maxDelay)
+          {
+            ++m_overflows;
+            return;
+          }
+        m_busyUntil = start + airtime;
+        for (uint32_t d = 0; d < m_devices.size (); ++d)
+          {
+            if (m_devices[d] == sender)
+              {
+                continue;
+              }
+            Ptr<MobilityModel> b = m_devices[d]->GetNode ()->GetObject<MobilityModel> ();
+            double per = GetPer (a, b);
+            if (per < 0)
+              {
+                continue;
+              }
+            if (m_error->GetValue () < per)
+              {
+                ++m_losses;
+                continue;
+              }
+            ScheduleDelivery (m_devices[d], p, protocol, to, from, m_busyUntil - now + m_delay->GetDelay (a, b));
+          }
+        return;
+      }
+    Ptr<SimpleNetDevice> receiver;
+    for (uint32_t d = 0; d < m_devices.size () && receiver == 0; ++d)
+      {
+        if (Mac48Address::ConvertFrom (m_devices[d]->GetAddress ()) == to)
+          {
+            receiver = m_devices[d];
+          }
+      }
+    Ptr<MobilityModel> b = receiver == 0 ? 0 : receiver->GetNode ()->GetObject<MobilityModel> ();
+    double per = receiver == 0 ? 1 : GetPer (a, b);
+    per = per < 0 ? 1 : per;
+    // Attempts until one gets through, each followed by its ACK or ACK timeout
+    uint32_t cw = m_minCw;
+    for (uint32_t attempt = 1;; ++attempt)
+      {
+        start += m_slot * m_backoff->GetInteger (0, cw);
+        if (start - now > m_maxDelay)
+          {
+            ++m_overflows;
+            return;
+          }
+        start += airtime + m_ackOverhead;
+        m_busyUntil = start;
+        if (m_error->GetValue () >= per)
+          {
+            ScheduleDelivery (receiver, p, protocol, to, from, start - m_ackOverhead - now + m_delay->GetDelay (a, b));
+            return;
+          }
+        ++m_losses;
+        if (attempt == m_maxAttempts)
+          {
+            return;
+          }
+        ++m_retries;
+        cw = std::min (2 * cw + 1, m_maxCw);
+      }
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_devices.clear ();
+    m_table = 0;
+    m_loss = 0;
+    m_delay = 0;
+    SimpleChannel::DoDispose ();
+  }
+
+private:
+  /// \return the error rate of the link, or -1 if b is out of range of a
+  double GetPer (Ptr<MobilityModel> a, Ptr<MobilityModel> b)
+  {
+    double rxDbm = m_loss->CalcRxPower (m_txPowerDbm, a, b);
+    if (rxDbm < m_rxSensitivityDbm)
+      {
+        return -1;
+      }
+    return m_table->GetPer (rxDbm - m_noiseDbm);
+  }
+
+  void ScheduleDelivery (Ptr<SimpleNetDevice> device, Ptr<Packet> p, uint16_t protocol, Mac48Address to,
+                         Mac48Address from, Time delay)
+  {
+    Simulator::ScheduleWithContext (device->GetNode ()->GetId (), delay, &AbstractLanChannel::Deliver,
+                                    this, device, p->Copy (), protocol, to, from);
+  }
+
+  void Deliver (Ptr<SimpleNetDevice> device, Ptr<Packet> p, uint16_t protocol, Mac48Address to,
+                Mac48Address from)
+  {
+    ++m_deliveries;
+    m_rxTrace (p);
+    device->Receive (p, protocol, to, from);
+  }
+
+  std::vector<Ptr<SimpleNetDevice> > m_devices;  //!< the stations
+  Ptr<PerTable> m_table;                         //!< error rate by SNR
+  Ptr<PropagationLossModel> m_loss;              //!< loss of the links
+  Ptr<PropagationDelayModel> m_delay;            //!< delay of the links
+  Ptr<UniformRandomVariable> m_backoff;          //!< backoff slots
+  Ptr<UniformRandomVariable> m_error;            //!< frame losses
+  DataRate m_rate;                               //!< rate of the frame bytes
+  Time m_frameOverhead;                          //!< DIFS and preamble
+  Time m_ackOverhead;                            //!< SIFS and ACK
+  uint32_t m_headerBytes;                        //!< MAC header, LLC and FCS
+  Time m_slot;                                   //!< backoff slot
+  uint32_t m_minCw;                              //!< first contention window
+  uint32_t m_maxCw;                              //!< largest contention window
+  uint32_t m_maxAttempts;                        //!< attempts of a unicast frame
+  Time m_maxDelay;                               //!< longest wait for the medium
+  double m_txPowerDbm;                           //!< transmission power
+  double m_noiseDbm;                             //!< noise power
+  double m_rxSensitivityDbm;                     //!< weakest frame received
+  Time m_busyUntil;                              //!< end of the last frame on the medium
+  TracedCallback<Ptr<const Packet> > m_rxTrace;  //!< delivered frames
+  uint64_t m_frames;                             //!< frames sent
+  uint64_t m_deliveries;                         //!< frames delivered
+  uint64_t m_losses;                             //!< attempts lost
+  uint64_t m_retries;                            //!< unicast retransmissions
+  uint64_t m_overflows;                          //!< frames dropped waiting for the medium
+};
+
+NS_OBJECT_ENSURE_REGISTERED (AbstractLanChannel);
+
+/**
+ * \brief Measure the PerTable of the wifi LANs of a full-PHY run.
+ */
+class LanPhyCalibrator
+{
+public:
+  /// \param noiseDbm noise power at the receivers, as on the AbstractLanChannel
+  LanPhyCalibrator (double noiseDbm = -93.97)
+    : m_table (Create<PerTable> ()),
+      m_noiseDbm (noiseDbm)
+  {
+    // The loss of YansWifiChannelHelper::Default
+    m_loss = CreateObject<LogDistancePropagationLossModel> ();
+  }
+
+  /// \param devices the wifi devices of one LAN, alone on their channel
+  void Install (NetDeviceContainer devices)
+  {
+    Ptr<Lan> lan = Create<Lan> ();
+    lan->calibrator = this;
+    for (uint32_t i = 0; i < devices.GetN (); ++i)
+      {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (devices.Get (i));
+        NS_ABORT_MSG_IF (device == 0, "LanPhyCalibrator: not a wifi device");
+        lan->models.push_back (device->GetNode ()->GetObject<MobilityModel> ());
+        lan->rxSensitivityDbm.push_back (device->GetPhy ()->GetRxSensitivity ());
+        device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&LanPhyCalibrator::TxBegin, lan, i));
+        device->GetPhy ()->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&LanPhyCalibrator::RxEnd, lan, i));
+      }
+    lan->pendingUid.assign (devices.GetN (), 0);
+    lan->pendingBin.assign (devices.GetN (), 0);
+    lan->pending.assign (devices.GetN (), false);
+    m_lans.push_back (lan);
+  }
+
+  /// \return the measured table
+  Ptr<PerTable> GetTable (void) const
+  {
+    return m_table;
+  }
+
+private:
+  /// Stations of one LAN and the frame each one is receiving.
+  struct Lan : public SimpleRefCount<Lan>
+  {
+    LanPhyCalibrator *calibrator;                 //!< the calibrator
+    std::vector<Ptr<MobilityModel> > models;      //!< positions of the stations
+    std::vector<double> rxSensitivityDbm;         //!< weakest frame each station receives
+    std::vector<uint64_t> pendingUid;             //!< frame each station may receive
+    std::vector<uint32_t> pendingBin;             //!< its SNR bin
+    std::vector<bool> pending;                    //!< a frame is on the air
+  };
+
+  static void TxBegin (Ptr<Lan> lan, uint32_t sender, Ptr<const Packet> packet, double txPowerW)
+  {
+    double txPowerDbm = 10 * std::log10 (txPowerW * 1000);
+    for (uint32_t r = 0; r < lan->models.size (); ++r)
+      {
+        if (r == sender)
+          {
+            continue;
+          }
+        double rxDbm = lan->calibrator->m_loss->CalcRxPower (txPowerDbm, lan->models[sender], lan->models[r]);
+        if (rxDbm < lan->rxSensitivityDbm[r])
+          {
+            // Out of range: the PHY does not even try
+            continue;
+          }
+        uint32_t bin = PerTable::GetBin (rxDbm - lan->calibrator->m_noiseDbm);
+        lan->calibrator->m_table->AddAttempt (bin, false);
+        lan->pendingUid[r] = packet->GetUid ();
+        lan->pendingBin[r] = bin;
+        lan->pending[r] = true;
+      }
+  }
+
+  static void RxEnd (Ptr<Lan> lan, uint32_t receiver, Ptr<const Packet> packet)
+  {
+    if (lan->pending[receiver] && lan->pendingUid[receiver] == packet->GetUid ())
+      {
+        lan->calibrator->m_table->AddSuccess (lan->pendingBin[receiver]);
+        lan->pending[receiver] = false;
+      }
+  }
+
+  Ptr<PerTable> m_table;                    //!< the measured table
+  Ptr<PropagationLossModel> m_loss;         //!< loss of the links
+  double m_noiseDbm;                        //!< noise power
+  std::vector<Ptr<Lan> > m_lans;            //!< the LANs
+};
+
+} // namespace ns3
+
+#endif /* ABSTRACT_LAN_CHANNEL_H */
@@ -0,0 +1,441 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+//
+// Logging for hot paths: compile-time filtering and asynchronous
+// formatting.
+//
+// FAST_LOG_ERROR, FAST_LOG_WARN, FAST_LOG_DEBUG, FAST_LOG_INFO,
+// FAST_LOG_FUNCTION and FAST_LOG_LOGIC take a component name, a format
+// with one "{}" per argument and the arguments:
+//
+//   FAST_LOG_INFO ("OnOffApplication", "sent {} bytes to {}", size, address);
+//
+// Levels less severe than FAST_LOG_LEVEL (an ns-3 LogLevel bit, LOG_LOGIC
+// by default) compile to nothing, arguments included:
+//
+//   CXXFLAGS="-DFAST_LOG_LEVEL=0x2" ./waf configure   # errors and warnings only
+//
+// While AsyncLog runs, a log call only copies the simulation time, the
+// node context, the format and the arguments into a binary ring buffer
+// of the calling thread; a background thread formats the records and
+// writes them to the log file.  The producer waits when its ring is full,
+// so nothing is lost.  Otherwise the line is formatted at once to
+// std::clog, in the ns-3 log layout, if the ns-3 log component of that
+// name is enabled at that level, as by LogComponentEnable or NS_LOG:
+//
+//   +1.234567890s 3 OnOffApplication:[INFO ] sent 1000 bytes to 10.1.1.1
+//
+// Arguments are integers, floating point numbers, Time values, Ipv4
+// addresses and string literals; strings must outlive the logger, since
+// only their address is recorded.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/log.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+
+#ifndef FAST_LOG_LEVEL
+#define FAST_LOG_LEVEL 0x20 // LOG_LOGIC: every level
+#endif
+
+#define FAST_LOG(level, component, ...) \
+  ns3::AsyncLog::Get ().Log (level, component, __VA_ARGS__)
+
+#if FAST_LOG_LEVEL >= 0x1
+#define FAST_LOG_ERROR(component, ...) FAST_LOG (ns3::LOG_ERROR, component, __VA_ARGS__)
+#else
+#define FAST_LOG_ERROR(component, ...) do { } while (false)
+#endif
+#if FAST_LOG_LEVEL >= 0x2
+#define FAST_LOG_WARN(component, ...) FAST_LOG (ns3::LOG_WARN, component, __VA_ARGS__)
+#else
+#define FAST_LOG_WARN(component, ...) do { } while (false)
+#endif
+#if FAST_LOG_LEVEL >= 0x4
+#define FAST_LOG_DEBUG(component, ...) FAST_LOG (ns3::LOG_DEBUG, component, __VA_ARGS__)
+#else
+#define FAST_LOG_DEBUG(component, ...) do { } while (false)
+#endif
+#if FAST_LOG_LEVEL >= 0x8
+#define FAST_LOG_INFO(component, ...) FAST_LOG (ns3::LOG_INFO, component, __VA_ARGS__)
+#else
+#define FAST_LOG_INFO(component, ...) do { } while (false)
+#endif
+#if FAST_LOG_LEVEL >= 0x10
+#define FAST_LOG_FUNCTION(component, ...) FAST_LOG (ns3::LOG_FUNCTION, component, __VA_ARGS__)
+#else
+#define FAST_LOG_FUNCTION(component, ...) do { } while (false)
+#endif
+#if FAST_LOG_LEVEL >= 0x20
+#define FAST_LOG_LOGIC(component, ...) FAST_LOG (ns3::LOG_LOGIC, component, __VA_ARGS__)
+#else
+#define FAST_LOG_LOGIC(component, ...) do { } while (false)
+#endif
+
+namespace ns3 {
+
+/**
+ * \brief Logger that formats its records on a background thread.
+ */
+class AsyncLog
+{
+public:
+  /// \return the logger
+  static AsyncLog &Get (void)
+  {
+    static AsyncLog log;
+    return log;
+  }
+
+  ~AsyncLog ()
+  {
+    Stop ();
+  }
+
+  /**
+   * \brief Start the background thread.
+   * \param filename the log file
+   * \param capacity records in the ring buffer of each thread
+   *
+   * The thread does not survive a fork: stop the logger before forking.
+   */
+  void Start (std::string filename, uint32_t capacity = 65536)
+  {
+    NS_ABORT_MSG_IF (m_running, "AsyncLog: already started");
+    m_file.open (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (m_file.is_open (), "AsyncLog: cannot open " << filename);
+    m_capacity = capacity;
+    m_running = true;
+    m_writer = std::thread (&AsyncLog::Drain, this);
+  }
+
+  /// \brief Write the pending records, stop the thread and close the file.
+  void Stop (void)
+  {
+    if (!m_running)
+      {
+        return;
+      }
+    m_running = false;
+    m_writer.join ();
+    m_file.close ();
+  }
+
+  /// \return true if the background thread runs
+  bool IsRunning (void) const
+  {
+    return m_running;
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    os << "AsyncLog: " << m_records << " records, " << m_stalls << " yields on a full buffer" << std::endl;
+  }
+
+  /**
+   * \brief Record or print a log line.
+   * \param level the ns-3 log level
+   * \param component the component name, a string literal
+   * \param format the message, with one "{}" per argument, a string literal
+   * \param args the arguments
+   */
+  template <typename... Args>
+  void Log (LogLevel level, const char *component, const char *format, const Args &... args)
+  {
+    static_assert (sizeof... (Args) <= MAX_ARGS, "AsyncLog: too many arguments");
+    if (!m_running && !IsEnabled (component, level))
+      {
+        return;
+      }
+    Record record;
+    record.time = Simulator::Now ().GetNanoSeconds ();
+    record.context = Simulator::GetContext ();
+    record.level = level;
+    record.component = component;
+    record.format = format;
+    record.nArgs = 0;
+    Fill (record, args...);
+    if (!m_running)
+      {
+        Format (std::clog, record);
+        return;
+      }
+    Ring *ring = GetRing ();
+    uint64_t head = ring->head.load (std::memory_order_relaxed);
+    while (head - ring->tail.load (std::memory_order_acquire) >= ring->records.size ())
+      {
+        ++ring->stalls;
+        std::this_thread::yield ();
+      }
+    ring->records[head % ring->records.size ()] = record;
+    ring->head.store (head + 1, std::memory_order_release);
+  }
+
+private:
+  static const uint32_t MAX_ARGS = 6;  //!< arguments of one record
+
+  /// One recorded argument.
+  struct Arg
+  {
+    char type;          //!< 'i' signed, 'u' unsigned, 'd' double, 's' string, 'a' Ipv4, 't' Time
+    union
+    {
+      int64_t i;
+      uint64_t u;
+      double d;
+      const char *s;
+    };
+  };
+
+  /// One log call.
+  struct Record
+  {
+    int64_t time;             //!< simulation time (ns)
+    uint32_t context;         //!< node id, or 0xffffffff
+    LogLevel level;           //!< the log level
+    const char *component;    //!< component name
+    const char *format;       //!< the message format
+    uint32_t nArgs;           //!< arguments used
+    Arg args[MAX_ARGS];       //!< the arguments
+  };
+
+  /// Ring buffer written by one thread and read by the background thread.
+  struct Ring
+  {
+    std::vector<Record> records;       //!< the slots
+    std::atomic<uint64_t> head;        //!< next slot written
+    std::atomic<uint64_t> tail;        //!< next slot read
+    uint64_t stalls;                   //!< yields on a full ring
+  };
+
+  AsyncLog ()
+    : m_running (false),
+      m_capacity (65536),
+      m_records (0),
+      m_stalls (0)
+  {
+  }
+
+  /// \return true if the ns-3 log component named component is enabled at level
+  bool IsEnabled (const char *component, LogLevel level)
+  {
+    std::unordered_map<const char *, LogComponent *>::const_iterator i = m_components.find (component);
+    if (i == m_components.end ())
+      {
+        LogComponent::ComponentList *list = LogComponent::GetComponentList ();
+        LogComponent::ComponentList::const_iterator c = list->find (component);
+        i = m_components.insert (std::make_pair (component, c != list->end () ? c->second : 0)).first;
+      }
+    return i->second != 0 && i->second->IsEnabled (level);
+  }
+
+  Ring *GetRing (void)
+  {
+    static thread_local Ring *ring = 0;
+    if (ring == 0)
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_rings.push_back (std::unique_ptr<Ring> (new Ring ()));
+        ring = m_rings.back ().get ();
+        ring->records.resize (m_capacity);
+        ring->head = 0;
+        ring->tail = 0;
+        ring->stalls = 0;
+      }
+    return ring;
+  }
+
+  static void Fill (Record &)
+  {
+  }
+
+  template <typename T, typename... Rest>
+  static void Fill (Record &record, const T &value, const Rest &... rest)
+  {
+    record.args[record.nArgs++] = MakeArg (value);
+    Fill (record, rest...);
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value, Arg>::type MakeArg (T value)
+  {
+    Arg arg;
+    if (std::is_signed<T>::value)
+      {
+        arg.type = 'i';
+        arg.i = value;
+      }
+    else
+      {
+        arg.type = 'u';
+        arg.u = value;
+      }
+    return arg;
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value, Arg>::type MakeArg (T value)
+  {
+    Arg arg;
+    arg.type = 'd';
+    arg.d = value;
+    return arg;
+  }
+
+  static Arg MakeArg (const char *value)
+  {
+    Arg arg;
+    arg.type = 's';
+    arg.s = value;
+    return arg;
+  }
+
+  static Arg MakeArg (Ipv4Address value)
+  {
+    Arg arg;
+    arg.type = 'a';
+    arg.u = value.Get ();
+    return arg;
+  }
+
+  static Arg MakeArg (Time value)
+  {
+    Arg arg;
+    arg.type = 't';
+    arg.i = value.GetNanoSeconds ();
+    return arg;
+  }
+
+  static void Format (std::ostream &os, const Record &record)
+  {
+    static const char *levels[] = {"ERROR", "WARN ", "DEBUG", "INFO ", "FUNCT", "LOGIC"};
+    uint32_t level = 0;
+    while (level < 5 && !(record.level & (1 << level)))
+      {
+        ++level;
+      }
+    char time[32];
+    std::snprintf (time, sizeof (time), "+%.9fs ", record.time / 1e9);
+    os << time;
+    if (record.context != 0xffffffff)
+      {
+        os << record.context << " ";
+      }
+    os << record.component << ":[" << levels[level] << "] ";
+    uint32_t arg = 0;
+    for (const char *c = record.format; *c != 0; ++c)
+      {
+        if (c[0] == '{' && c[1] == '}' && arg < record.nArgs)
+          {
+            const Arg &a = record.args[arg++];
+            switch (a.type)
+              {
+              case 'i': os << a.i; break;
+              case 'u': os << a.u; break;
+              case 'd': os << a.d; break;
+              case 's': os << a.s; break;
+              case 'a': os << Ipv4Address (static_cast<uint32_t> (a.u)); break;
+              case 't': std::snprintf (time, sizeof (time), "+%.9fs", a.i / 1e9); os << time; break;
+              }
+            ++c;
+          }
+        else
+          {
+            os << *c;
+          }
+      }
+    os << "\n";
+  }
+
+  /// Body of the background thread.
+  void Drain (void)
+  {
+    while (true)
+      {
+        // Records made before Stop are visible to the drain that follows
+        bool stopping = !m_running;
+        uint64_t drained = 0;
+        {
+          std::lock_guard<std::mutex> lock (m_mutex);
+          for (uint32_t i = 0; i < m_rings.size (); ++i)
+            {
+              Ring *ring = m_rings[i].get ();
+              uint64_t tail = ring->tail.load (std::memory_order_relaxed);
+              uint64_t head = ring->head.load (std::memory_order_acquire);
+              drained += head - tail;
+              for (; tail < head; ++tail)
+                {
+                  Format (m_file, ring->records[tail % ring->records.size ()]);
+                  ring->tail.store (tail + 1, std::memory_order_release);
+                }
+            }
+        }
+        if (stopping)
+          {
+            break;
+          }
+        if (drained == 0)
+          {
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+          }
+      }
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_records = 0;
+    m_stalls = 0;
+    for (uint32_t i = 0; i < m_rings.size (); ++i)
+      {
+        m_records += m_rings[i]->tail;
+        m_stalls += m_rings[i]->stalls;
+      }
+    m_file.flush ();
+  }
+
+  std::atomic<bool> m_running;                 //!< the background thread runs
+  uint32_t m_capacity;                         //!< records per ring
+  std::mutex m_mutex;                          //!< guards m_rings
+  std::vector<std::unique_ptr<Ring> > m_rings; //!< ring of every thread
+  std::thread m_writer;                        //!< the background thread
+  std::ofstream m_file;                        //!< the log file
+  std::unordered_map<const char *, LogComponent *> m_components; //!< ns-3 log component of each name
+  uint64_t m_records;                          //!< records written
+  uint64_t m_stalls;                           //!< yields on a full ring
+};
+
+} // namespace ns3
+
+#endif /* ASYNC_LOG_H */
@@ -0,0 +1,143 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BENCHMARK_REPORT_H
+#define BENCHMARK_REPORT_H
+
+//
+// Wall-clock timing of the phases of one scenario run, written as one
+// CSV row:
+//
+//   scenario,parameters,buildSeconds,runSeconds,outputSeconds,
+//   events,eventsPerSecond,peakRssKb
+//
+// "build" is everything before Simulator::Run, "run" is Simulator::Run
+// itself and "output" is the writing of results up to Simulator::Destroy.
+// The row is appended to the file, whose header is written when it is
+// empty, so the benchmark program can collect the rows of many runs.
+//
+
+#include <sys/resource.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+/// Column names of the rows written by BenchmarkReport.
+static const char BENCHMARK_COLUMNS[] =
+  "scenario,parameters,buildSeconds,runSeconds,outputSeconds,"
+  "events,eventsPerSecond,peakRssKb";
+
+/**
+ * \brief Time the build, run and output phases of a scenario.
+ */
+class BenchmarkReport
+{
+public:
+  /// Phases of a run, in order.
+  enum Phase
+  {
+    BUILD = 0,
+    RUN,
+    OUTPUT,
+    N_PHASES
+  };
+
+  /// Start timing; the build phase begins now.
+  BenchmarkReport ()
+    : m_phase (BUILD),
+      m_events (0)
+  {
+    for (uint32_t i = 0; i <= N_PHASES; ++i)
+      {
+        m_seconds[i] = 0;
+      }
+    m_start = Clock::now ();
+  }
+
+  /**
+   * \brief End the current phase and begin the next one.
+   * \param phase the phase that begins
+   */
+  void Begin (Phase phase)
+  {
+    Clock::time_point now = Clock::now ();
+    m_seconds[m_phase] += std::chrono::duration<double> (now - m_start).count ();
+    m_start = now;
+    if (m_phase == RUN)
+      {
+        m_events = Simulator::GetEventCount ();
+      }
+    m_phase = phase;
+  }
+
+  /**
+   * \brief End the current phase and append the row to a file.
+   * \param filename the CSV file; nothing is written if it is empty
+   * \param scenario name of the scenario
+   * \param parameters the scaling parameters, as "name=value;name=value"
+   */
+  void Write (std::string filename, std::string scenario, std::string parameters)
+  {
+    Begin (N_PHASES);
+    if (filename.empty ())
+      {
+        return;
+      }
+    std::ofstream os (filename.c_str (), std::ios::app);
+    NS_ABORT_MSG_UNLESS (os.is_open (), "BenchmarkReport: cannot open " << filename);
+    if (os.tellp () == 0)
+      {
+        os << BENCHMARK_COLUMNS << std::endl;
+      }
+    double run = m_seconds[RUN];
+    os << scenario << "," << parameters << ","
+       << m_seconds[BUILD] << "," << run << "," << m_seconds[OUTPUT] << ","
+       << m_events << "," << (run > 0 ? m_events / run : 0) << ","
+       << GetPeakRssKb () << std::endl;
+  }
+
+  /// \param phase a phase \return wall-clock seconds spent in it so far
+  double GetSeconds (Phase phase) const
+  {
+    return m_seconds[phase];
+  }
+
+  /// \return the peak resident set size of this process (kB)
+  static long GetPeakRssKb (void)
+  {
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  uint32_t m_phase;                 //!< current phase
+  Clock::time_point m_start;        //!< start of the current phase
+  double m_seconds[N_PHASES + 1];   //!< time spent in each phase
+  uint64_t m_events;                //!< events executed by Simulator::Run
+};
+
+} // namespace ns3
+
+#endif /* BENCHMARK_REPORT_H */
@@ -0,0 +1,373 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Scaling benchmark of the two scenarios.  taller1 is run for every
+// value of taller1Nodes and the mixed wireless scenario for every
+// backboneNodes x infraNodes size of mixedSizes, each in its own process
+// with tracing and animation off and --benchmarkOutput set, so every run
+// appends one row of phase timings, event rate and peak RSS (see
+// benchmark-report.h) to the output file:
+//
+// ./waf --run "benchmark --taller1Nodes=25,100,500,1000,2000,4000 --mixedSizes=6x6,12x12,24x24"
+//
+// The scenarios are started with "<runner> '<program> <options>'", by
+// default through waf.  If a baseline file is given, every row is
+// compared to the baseline row of the same scenario and parameters, and
+// the benchmark fails if the run phase or the peak RSS grew by more than
+// the threshold (0.2 = 20 %) or the event rate dropped by as much.  A
+// run kept as the new baseline is simply a copy of the output file.
+//
+// ./waf --run "benchmark --baseline=benchmark-baseline.csv --threshold=0.1"
+//
+// Every run is repeated with each event scheduler of the schedulers
+// list (map, heap, list, calendar, priority or ladder; see
+// ladder-scheduler.h).  The schedulers are also compared on the classic
+// hold model: a queue of holdSizes events, from which the earliest event
+// is removed and reinserted an exponential time (mean 1 ms) later,
+// holdOperations times.  Hold rows have no build or output phase and no
+// peak RSS, since they run in this process:
+//
+// ./waf --run "benchmark --schedulers=map,heap,calendar,ladder --holdSizes=1000,100000"
+//
+// With compact, both scenarios run in their compact mode, which trims
+// the per-node memory of large runs; the rows are told apart by their
+// parameters:
+//
+// ./waf --run "benchmark --taller1Nodes=2000,5000,10000 --mixedSizes=50x50,100x100 --compact=1"
+//
+// With packetPool every scenario run is repeated with the packet pool
+// of pooled-allocator.h, and the run phase times with and without it
+// are printed side by side; the scenarios must then be built with
+// POOLED_ALLOCATOR.  Comparing a build with it to a stock build, both
+// without packetPool, gives the cost of the replaced allocator itself.  profile does the same with the event
+// profiler of event-profiler.h, timing one event in profile, to measure
+// its overhead:
+//
+// ./waf --run "benchmark --taller1Nodes=500 --mixedSizes=12x12 --packetPool=1 --profile=8"
+//
+// With lanPhy=abstract the mixed wireless LANs use the table-driven
+// channel of abstract-lan-channel.h, whose table a "main2
+// --lanPhy=calibrate" run must have written first.
+//
+// Before any scenario, checkProgram (burst-onoff-check.cc) compares the
+// packets of BurstOnOffApplication to those of OnOffApplication with
+// the same draws, and the benchmark fails if they differ; an empty
+// checkProgram skips the check.
+//
+
+#include <stdio.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/command-line.h"
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/object-factory.h"
+#include "ns3/random-variable-stream.h"
+
+#include "benchmark-report.h"
+#include "ladder-scheduler.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("Benchmark");
+
+namespace {
+
+/// One row written by BenchmarkReport.
+struct Row
+{
+  double runSeconds;       //!< time in Simulator::Run
+  double eventsPerSecond;  //!< event rate in Simulator::Run
+  double peakRssKb;        //!< peak RSS of the run
+};
+
+std::vector<std::string>
+Split (std::string s, char separator)
+{
+  std::vector<std::string> fields;
+  std::istringstream is (s);
+  std::string field;
+  while (std::getline (is, field, separator))
+    {
+      if (!field.empty ())
+        {
+          fields.push_back (field);
+        }
+    }
+  return fields;
+}
+
+/// Read a benchmark file into rows keyed by "scenario,parameters".
+std::map<std::string, Row>
+ReadRows (std::string filename)
+{
+  std::map<std::string, Row> rows;
+  std::ifstream is (filename.c_str ());
+  std::string line;
+  std::getline (is, line);
+  NS_ABORT_MSG_UNLESS (line == BENCHMARK_COLUMNS, filename << " is not a benchmark result file");
+  while (std::getline (is, line))
+    {
+      std::vector<std::string> f = Split (line, ',');
+      if (f.size () < 8)
+        {
+          continue;
+        }
+      Row row;
+      row.runSeconds = std::atof (f[3].c_str ());
+      row.eventsPerSecond = std::atof (f[6].c_str ());
+      row.peakRssKb = std::atof (f[7].c_str ());
+      rows[f[0] + "," + f[1]] = row;
+    }
+  return rows;
+}
+
+/// \return true if cur is worse than base by more than threshold
+bool
+Regressed (double cur, double base, double threshold, bool higherIsBetter)
+{
+  if (base <= 0)
+    {
+      return false;
+    }
+  double change = (cur - base) / base;
+  return higherIsBetter ? change < -threshold : change > threshold;
+}
+
+/**
+ * \brief Run the hold model on a scheduler and append its row to a file.
+ * \param scheduler short name of the scheduler
+ * \param size events in the queue
+ * \param operations removals and reinsertions timed
+ * \param output the benchmark CSV file
+ */
+void
+RunHoldModel (std::string scheduler, uint32_t size, uint32_t operations, std::string output)
+{
+  typedef std::chrono::steady_clock Clock;
+  ObjectFactory factory;
+  factory.SetTypeId (GetSchedulerTypeName (scheduler));
+  Ptr<Scheduler> queue = factory.Create<Scheduler> ();
+  Ptr<ExponentialRandomVariable> hold = CreateObject<ExponentialRandomVariable> ();
+  hold->SetAttribute ("Mean", DoubleValue (1e6)); // ns
+  hold->SetStream (1);
+
+  Clock::time_point start = Clock::now ();
+  Scheduler::Event ev;
+  ev.impl = 0;
+  ev.key.m_context = 0;
+  uint32_t uid = 0;
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      ev.key.m_ts = static_cast<uint64_t> (hold->GetValue ());
+      ev.key.m_uid = uid++;
+      queue->Insert (ev);
+    }
+  Clock::time_point run = Clock::now ();
+  for (uint32_t i = 0; i < operations; ++i)
+    {
+      ev = queue->RemoveNext ();
+      ev.key.m_ts += static_cast<uint64_t> (hold->GetValue ());
+      ev.key.m_uid = uid++;
+      queue->Insert (ev);
+    }
+  Clock::time_point end = Clock::now ();
+  while (!queue->IsEmpty ())
+    {
+      queue->RemoveNext ();
+    }
+
+  double buildSeconds = std::chrono::duration<double> (run - start).count ();
+  double runSeconds = std::chrono::duration<double> (end - run).count ();
+  std::ofstream os (output.c_str (), std::ios::app);
+  if (os.tellp () == 0)
+    {
+      os << BENCHMARK_COLUMNS << std::endl;
+    }
+  os << "hold,queueSize=" << size << ";scheduler=" << scheduler << "," << buildSeconds << ","
+     << runSeconds << ",0," << operations << "," << (runSeconds > 0 ? operations / runSeconds : 0)
+     << ",0" << std::endl;
+}
+
+} // unnamed namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string taller1Nodes = "25,100,500,1000,2000";
+  std::string mixedSizes = "6x6,12x12,24x24";
+  std::string taller1Program = "taller1";
+  std::string mixedProgram = "main2";
+  std::string checkProgram = "burst-onoff-check";
+  std::string runner = "./waf --run";
+  std::string output = "benchmark.csv";
+  std::string baseline;
+  double threshold = 0.2;
+  std::string schedulers = "map";
+  std::string holdSizes = "1000,100000";
+  uint32_t holdOperations = 1000000;
+  bool compact = false;
+  std::string lanPhy = "yans";
+  bool packetPool = false;
+  uint32_t profile = 0;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("taller1Nodes", "taller1: comma separated numNodes values", taller1Nodes);
+  cmd.AddValue ("mixedSizes", "mixed wireless: comma separated backboneNodes x infraNodes, e.g. 6x6,12x12", mixedSizes);
+  cmd.AddValue ("taller1Program", "name of the taller1 program", taller1Program);
+  cmd.AddValue ("mixedProgram", "name of the mixed wireless program", mixedProgram);
+  cmd.AddValue ("checkProgram", "name of the burst source check run first (empty: none)", checkProgram);
+  cmd.AddValue ("runner", "command that runs a program with its options", runner);
+  cmd.AddValue ("output", "CSV file of the results (overwritten)", output);
+  cmd.AddValue ("baseline", "CSV file of a previous run to compare against (empty: none)", baseline);
+  cmd.AddValue ("threshold", "relative regression that fails the benchmark", threshold);
+  cmd.AddValue ("schedulers", "comma separated event schedulers: map, heap, list, calendar, priority, ladder", schedulers);
+  cmd.AddValue ("holdSizes", "hold model: comma separated queue sizes (empty: none)", holdSizes);
+  cmd.AddValue ("holdOperations", "hold model: removals and reinsertions per run", holdOperations);
+  cmd.AddValue ("compact", "run the scenarios in their compact (low memory per node) mode", compact);
+  cmd.AddValue ("lanPhy", "mixed wireless LAN model: yans or abstract", lanPhy);
+  cmd.AddValue ("packetPool", "also run every scenario with the packet pool and compare", packetPool);
+  cmd.AddValue ("profile", "also run every scenario with the event profiler, timing one event in this many (0 = off)", profile);
+  cmd.Parse (argc, argv);
+
+  std::vector<std::pair<std::string, std::string> > runs;
+  std::vector<std::string> schedulerNames = Split (schedulers, ',');
+  std::vector<std::string> nodes = Split (taller1Nodes, ',');
+  std::vector<std::string> sizes = Split (mixedSizes, ',');
+  for (uint32_t s = 0; s < schedulerNames.size (); ++s)
+    {
+      GetSchedulerTypeName (schedulerNames[s]); // fail early on a bad name
+      std::string scheduler = " --scheduler=" + schedulerNames[s] + (compact ? " --compact=1" : "");
+      for (uint32_t i = 0; i < nodes.size (); ++i)
+        {
+          runs.push_back (std::make_pair (taller1Program, "--numNodes=" + nodes[i]
+                                          + " --tracing=0 --animation=none" + scheduler));
+        }
+      for (uint32_t i = 0; i < sizes.size (); ++i)
+        {
+          std::vector<std::string> bi = Split (sizes[i], 'x');
+          NS_ABORT_MSG_UNLESS (bi.size () == 2, "bad mixed wireless size " << sizes[i]);
+          runs.push_back (std::make_pair (mixedProgram, "--backboneNodes=" + bi[0]
+                                          + " --infraNodes=" + bi[1] + " --animation=none" + scheduler
+                                          + (lanPhy != "yans" ? " --lanPhy=" + lanPhy : "")));
+        }
+    }
+  // Variants of every run: command line options and benchmark parameters
+  std::vector<std::pair<std::string, std::string> > variants;
+  if (packetPool)
+    {
+      variants.push_back (std::make_pair (" --packetPool=1", ";packetPool=1"));
+    }
+  if (profile > 0)
+    {
+      std::ostringstream sampling;
+      sampling << profile;
+      variants.push_back (std::make_pair (" --profile=1 --profileSampling=" + sampling.str (),
+                                          ";profile=" + sampling.str ()));
+    }
+  for (uint32_t i = 0, n = runs.size (); i < n; ++i)
+    {
+      for (uint32_t v = 0; v < variants.size (); ++v)
+        {
+          runs.push_back (std::make_pair (runs[i].first, runs[i].second + variants[v].first));
+        }
+    }
+
+  if (!checkProgram.empty ())
+    {
+      std::string command = runner + " '" + checkProgram + "'";
+      NS_LOG_UNCOND ("checking the burst source: " << checkProgram);
+      int status = system (command.c_str ());
+      NS_ABORT_MSG_IF (status != 0, "burst source check failed: " << command);
+    }
+  remove (output.c_str ());
+  for (uint32_t i = 0; i < runs.size (); ++i)
+    {
+      std::string command = runner + " '" + runs[i].first + " " + runs[i].second
+        + " --benchmarkOutput=" + output + "' > /dev/null";
+      NS_LOG_UNCOND ("[" << i + 1 << "/" << runs.size () << "] " << runs[i].first << " " << runs[i].second);
+      int status = system (command.c_str ());
+      NS_ABORT_MSG_IF (status != 0, "benchmark run failed: " << command);
+    }
+  std::vector<std::string> holds = Split (holdSizes, ',');
+  for (uint32_t s = 0; s < schedulerNames.size (); ++s)
+    {
+      for (uint32_t i = 0; i < holds.size (); ++i)
+        {
+          NS_LOG_UNCOND ("hold model: " << schedulerNames[s] << " scheduler, " << holds[i] << " events");
+          RunHoldModel (schedulerNames[s], std::atoi (holds[i].c_str ()), holdOperations, output);
+        }
+    }
+
+  std::map<std::string, Row> rows = ReadRows (output);
+  uint32_t expected = runs.size () + schedulerNames.size () * holds.size ();
+  NS_ABORT_MSG_IF (rows.size () != expected, "expected " << expected << " rows in "
+                   << output << ", found " << rows.size ());
+  for (uint32_t v = 0; v < variants.size (); ++v)
+    {
+      for (std::map<std::string, Row>::const_iterator i = rows.begin (); i != rows.end (); ++i)
+        {
+          std::map<std::string, Row>::const_iterator p = rows.find (i->first + variants[v].second);
+          if (p != rows.end ())
+            {
+              const Row &r = i->second;
+              const Row &c = p->second;
+              NS_LOG_UNCOND (variants[v].second.substr (1) << " " << i->first << ": run "
+                             << r.runSeconds << " -> " << c.runSeconds << " s ("
+                             << (r.runSeconds > 0 ? 100 * (c.runSeconds - r.runSeconds) / r.runSeconds : 0)
+                             << "%), peak RSS " << r.peakRssKb << " -> " << c.peakRssKb << " kB");
+            }
+        }
+    }
+  if (baseline.empty ())
+    {
+      NS_LOG_UNCOND ("Wrote " << rows.size () << " results to " << output);
+      return 0;
+    }
+
+  std::map<std::string, Row> base = ReadRows (baseline);
+  uint32_t regressions = 0;
+  for (std::map<std::string, Row>::const_iterator i = rows.begin (); i != rows.end (); ++i)
+    {
+      std::map<std::string, Row>::const_iterator b = base.find (i->first);
+      if (b == base.end ())
+        {
+          NS_LOG_UNCOND (i->first << ": not in the baseline");
+          continue;
+        }
+      const Row &c = i->second;
+      const Row &r = b->second;
+      bool regressed = Regressed (c.runSeconds, r.runSeconds, threshold, false)
+        || Regressed (c.eventsPerSecond, r.eventsPerSecond, threshold, true)
+        || Regressed (c.peakRssKb, r.peakRssKb, threshold, false);
+      NS_LOG_UNCOND ((regressed ? "REGRESSION " : "ok ") << i->first
+                     << ": run " << r.runSeconds << " -> " << c.runSeconds << " s, "
+                     << r.eventsPerSecond << " -> " << c.eventsPerSecond << " events/s, peak RSS "
+                     << r.peakRssKb << " -> " << c.peakRssKb << " kB");
+      regressions += regressed ? 1 : 0;
+    }
+  NS_LOG_UNCOND (regressions << " regressions above " << threshold * 100 << "% against " << baseline);
+  return regressions == 0 ? 0 : 1;
+}
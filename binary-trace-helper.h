@@ -0,0 +1,457 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BINARY_TRACE_HELPER_H
+#define BINARY_TRACE_HELPER_H
+
+//
+// Binary replacement for the ascii and pcap tracing of wifi devices.
+//
+// Every PHY transmission and successful reception is stored as one
+// fixed-size record header followed by the bytes of the frame.  Records
+// are appended to the current chunk of a ring of chunks; full chunks are
+// written out by a background thread, optionally through an external
+// gzip or zstd process, so the event loop never formats text or waits on
+// the disk unless the whole ring is full.  The compressor is started
+// without a shell, writing to the opened output file.
+//
+// The trace-convert program turns a record file back into the usual
+// "<prefix>.tr" ascii trace and "<prefix>-<node>-<device>.pcap" files.
+//
+// Record layout, in host byte order:
+//
+//   offset  size  field
+//        0     1  type (BinaryTraceHelper::RecordType)
+//        1     1  wifi mode id (TX, RX) or id being defined (MODE)
+//        2     2  device index on the node
+//        4     4  node id
+//        8     8  simulation time (ns)
+//       16     4  length of the data that follows the header
+//       20     1  SNR in dB (RX only)
+//       21     3  padding
+//
+// MODE records define a mode id on first use; their data is the rate in
+// units of 500 kb/s (2 bytes) followed by the mode's unique name.
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-mode.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-phy-state-helper.h"
+
+namespace ns3 {
+
+/**
+ * \brief Byte stream written to a file by a background thread through a
+ * ring of fixed-size chunks.
+ */
+class BinaryTraceWriter : public SimpleRefCount<BinaryTraceWriter>
+{
+public:
+  /**
+   * \param filename output file
+   * \param compression "none", "gzip" or "zstd"
+   * \param chunkSize size of one chunk of the ring (bytes)
+   * \param chunks number of chunks in the ring
+   */
+  BinaryTraceWriter (std::string filename, std::string compression,
+                     uint32_t chunkSize = 1 << 20, uint32_t chunks = 8)
+    : m_chunkSize (chunkSize),
+      m_compressor (-1),
+      m_stop (false),
+      m_stalls (0),
+      m_bytes (0)
+  {
+    if (compression == "none")
+      {
+        m_file = fopen (filename.c_str (), "wb");
+      }
+    else
+      {
+        NS_ABORT_MSG_UNLESS (compression == "gzip" || compression == "zstd",
+                             "BinaryTraceWriter: unknown compression " << compression);
+        m_file = OpenCompressor (compression.c_str (), filename, &m_compressor);
+      }
+    NS_ABORT_MSG_IF (m_file == 0, "BinaryTraceWriter: cannot open " << filename);
+    m_ring.resize (chunks);
+    for (uint32_t i = 0; i < chunks; ++i)
+      {
+        m_ring[i].data.resize (chunkSize);
+        m_ring[i].used = 0;
+        m_free.push_back (&m_ring[i]);
+      }
+    m_current = m_free.back ();
+    m_free.pop_back ();
+    m_thread = std::thread (&BinaryTraceWriter::Run, this);
+  }
+
+  ~BinaryTraceWriter ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Reserve room for the next record.
+   * \param size size of the record (bytes)
+   * \return where the record must be written
+   */
+  uint8_t *Reserve (uint32_t size)
+  {
+    NS_ABORT_MSG_IF (size > m_chunkSize, "BinaryTraceWriter: record larger than a chunk");
+    if (m_current->used + size > m_chunkSize)
+      {
+        Submit (true);
+      }
+    uint8_t *p = &m_current->data[m_current->used];
+    m_current->used += size;
+    m_bytes += size;
+    return p;
+  }
+
+  /// \brief Write out the pending records and wait for the writer thread.
+  void Close (void)
+  {
+    if (m_file == 0)
+      {
+        return;
+      }
+    Submit (false);
+    {
+      std::unique_lock<std::mutex> lock (m_mutex);
+      m_stop = true;
+    }
+    m_ready.notify_one ();
+    m_thread.join ();
+    fclose (m_file);
+    if (m_compressor > 0)
+      {
+        int status;
+        waitpid (m_compressor, &status, 0);
+        NS_ABORT_MSG_UNLESS (WIFEXITED (status) && WEXITSTATUS (status) == 0,
+                             "BinaryTraceWriter: the compressor failed");
+      }
+    m_file = 0;
+  }
+
+  /// \return number of times the simulation waited for a free chunk
+  uint64_t GetStalls (void) const
+  {
+    return m_stalls;
+  }
+
+  /// \return number of bytes recorded so far
+  uint64_t GetBytes (void) const
+  {
+    return m_bytes;
+  }
+
+private:
+  /// One chunk of the ring.
+  struct Chunk
+  {
+    std::vector<uint8_t> data;  //!< chunk storage
+    uint32_t used;              //!< bytes in use
+  };
+
+  /**
+   * \brief Start a compressor, without a shell, writing to a file.
+   * \param program "gzip" or "zstd"
+   * \param filename the compressed output file
+   * \param pid set to the process id of the compressor
+   * \return the write end of its input, or 0 on failure
+   */
+  static FILE *OpenCompressor (const char *program, std::string filename, pid_t *pid)
+  {
+    int out = open (filename.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0)
+      {
+        return 0;
+      }
+    int fds[2];
+    if (pipe (fds) != 0)
+      {
+        close (out);
+        return 0;
+      }
+    *pid = fork ();
+    if (*pid < 0)
+      {
+        close (fds[0]);
+        close (fds[1]);
+        close (out);
+        return 0;
+      }
+    if (*pid == 0)
+      {
+        dup2 (fds[0], STDIN_FILENO);
+        dup2 (out, STDOUT_FILENO);
+        close (fds[0]);
+        close (fds[1]);
+        close (out);
+        execlp (program, program, "-q", "-c", (char *) 0);
+        _exit (127);
+      }
+    close (fds[0]);
+    close (out);
+    return fdopen (fds[1], "wb");
+  }
+
+  /// Hand the current chunk to the writer thread, optionally taking a new one.
+  void Submit (bool next)
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    if (m_current == 0)
+      {
+        return;
+      }
+    m_full.push_back (m_current);
+    m_current = 0;
+    m_ready.notify_one ();
+    if (!next)
+      {
+        return;
+      }
+    if (m_free.empty ())
+      {
+        ++m_stalls;
+        m_space.wait (lock, [this] { return !m_free.empty (); });
+      }
+    m_current = m_free.back ();
+    m_free.pop_back ();
+  }
+
+  /// Body of the writer thread.
+  void Run (void)
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    while (true)
+      {
+        m_ready.wait (lock, [this] { return m_stop || !m_full.empty (); });
+        if (m_full.empty ())
+          {
+            break;
+          }
+        Chunk *chunk = m_full.front ();
+        m_full.pop_front ();
+        lock.unlock ();
+        fwrite (&chunk->data[0], 1, chunk->used, m_file);
+        lock.lock ();
+        chunk->used = 0;
+        m_free.push_back (chunk);
+        m_space.notify_one ();
+      }
+  }
+
+  FILE *m_file;                    //!< output file or compressor pipe
+  uint32_t m_chunkSize;            //!< capacity of a chunk
+  pid_t m_compressor;              //!< compressor writing the file, -1 if none
+  std::vector<Chunk> m_ring;       //!< chunk storage
+  Chunk *m_current;                //!< chunk being filled
+  std::vector<Chunk *> m_free;     //!< chunks ready to be filled
+  std::deque<Chunk *> m_full;      //!< chunks waiting to be written
+  std::mutex m_mutex;              //!< protects the chunk lists
+  std::condition_variable m_ready; //!< signals the writer thread
+  std::condition_variable m_space; //!< signals a free chunk
+  std::thread m_thread;            //!< writer thread
+  bool m_stop;                     //!< asks the writer thread to finish
+  uint64_t m_stalls;               //!< waits for a free chunk
+  uint64_t m_bytes;                //!< bytes recorded
+};
+
+/**
+ * \brief Record the PHY transmissions and receptions of wifi devices into
+ * a BinaryTraceWriter.
+ */
+class BinaryTraceHelper
+{
+public:
+  /// Record types.
+  enum RecordType
+  {
+    MODE = 1,  //!< defines a wifi mode id
+    TX = 2,    //!< frame transmitted (PHY State/Tx)
+    RX = 3     //!< frame received (PHY State/RxOk)
+  };
+
+  /// Size of the record header (bytes).
+  static const uint32_t HEADER_SIZE = 24;
+
+  BinaryTraceHelper ()
+    : m_compression ("none")
+  {
+  }
+
+  ~BinaryTraceHelper ()
+  {
+    Close ();
+  }
+
+  /// \param compression "none", "gzip" or "zstd"
+  void SetCompression (std::string compression)
+  {
+    m_compression = compression;
+  }
+
+  /**
+   * \brief Record the frames of the given wifi devices.
+   * \param prefix prefix of the record file
+   * \param devices the devices to trace
+   * \return the name of the record file
+   */
+  std::string EnableAll (std::string prefix, NetDeviceContainer devices)
+  {
+    std::string filename = prefix + ".trb";
+    if (m_compression == "gzip")
+      {
+        filename += ".gz";
+      }
+    else if (m_compression == "zstd")
+      {
+        filename += ".zst";
+      }
+    m_stream = Create<Stream> ();
+    m_stream->writer = Create<BinaryTraceWriter> (filename, m_compression);
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+      {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+        NS_ABORT_MSG_IF (device == 0, "BinaryTraceHelper: not a WifiNetDevice");
+        Ptr<Context> ctx = Create<Context> ();
+        ctx->stream = m_stream;
+        ctx->node = device->GetNode ()->GetId ();
+        ctx->device = device->GetIfIndex ();
+        ctx->width = device->GetPhy ()->GetChannelWidth ();
+        Ptr<WifiPhyStateHelper> state = device->GetPhy ()->GetState ();
+        state->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&BinaryTraceHelper::TxSink, ctx));
+        state->TraceConnectWithoutContext ("RxOk", MakeBoundCallback (&BinaryTraceHelper::RxSink, ctx));
+      }
+    return filename;
+  }
+
+  /// \brief Flush the records and stop the writer thread.
+  void Close (void)
+  {
+    if (m_stream != 0)
+      {
+        m_stream->writer->Close ();
+        m_stream = 0;
+      }
+  }
+
+private:
+  /// A record file and its mode table.
+  struct Stream : public SimpleRefCount<Stream>
+  {
+    Ptr<BinaryTraceWriter> writer;  //!< the record file
+    std::vector<int16_t> modes;     //!< mode id, indexed by WifiMode uid
+    uint8_t nextMode;               //!< next free mode id
+
+    Stream () : nextMode (0) {}
+  };
+
+  /// What a trace sink needs to know about its device.
+  struct Context : public SimpleRefCount<Context>
+  {
+    Ptr<Stream> stream;  //!< where records go
+    uint32_t node;       //!< node id
+    uint16_t device;     //!< device index on the node
+    uint16_t width;      //!< channel width (MHz)
+  };
+
+  static uint8_t InternMode (Ptr<Context> ctx, WifiMode mode)
+  {
+    Ptr<Stream> s = ctx->stream;
+    uint32_t uid = mode.GetUid ();
+    if (uid >= s->modes.size ())
+      {
+        s->modes.resize (uid + 1, -1);
+      }
+    if (s->modes[uid] < 0)
+      {
+        std::string name = mode.GetUniqueName ();
+        uint16_t rate = static_cast<uint16_t> (mode.GetDataRate (ctx->width) / 500000);
+        uint32_t length = 2 + name.size ();
+        uint8_t *buf = s->writer->Reserve (HEADER_SIZE + length);
+        std::memset (buf, 0, HEADER_SIZE);
+        buf[0] = MODE;
+        buf[1] = s->nextMode;
+        std::memcpy (buf + 16, &length, 4);
+        std::memcpy (buf + HEADER_SIZE, &rate, 2);
+        std::memcpy (buf + HEADER_SIZE + 2, name.data (), name.size ());
+        s->modes[uid] = s->nextMode++;
+      }
+    return static_cast<uint8_t> (s->modes[uid]);
+  }
+
+  static void Record (Ptr<Context> ctx, uint8_t type, Ptr<const Packet> p, WifiMode mode, int8_t snr)
+  {
+    uint8_t modeId = InternMode (ctx, mode);
+    uint32_t size = p->GetSize ();
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    uint8_t *buf = ctx->stream->writer->Reserve (HEADER_SIZE + size);
+    buf[0] = type;
+    buf[1] = modeId;
+    std::memcpy (buf + 2, &ctx->device, 2);
+    std::memcpy (buf + 4, &ctx->node, 4);
+    std::memcpy (buf + 8, &now, 8);
+    std::memcpy (buf + 16, &size, 4);
+    buf[20] = static_cast<uint8_t> (snr);
+    buf[21] = buf[22] = buf[23] = 0;
+    p->CopyData (buf + HEADER_SIZE, size);
+  }
+
+  static void TxSink (Ptr<Context> ctx, Ptr<const Packet> p, WifiMode mode,
+                      WifiPreamble preamble, uint8_t txLevel)
+  {
+    Record (ctx, TX, p, mode, 0);
+  }
+
+  static void RxSink (Ptr<Context> ctx, Ptr<const Packet> p, double snr,
+                      WifiMode mode, WifiPreamble preamble)
+  {
+    double snrDb = 10 * std::log10 (snr);
+    Record (ctx, RX, p, mode, static_cast<int8_t> (std::max (-128.0, std::min (127.0, snrDb))));
+  }
+
+  std::string m_compression;  //!< compression of the record file
+  Ptr<Stream> m_stream;       //!< the record file in use
+};
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_HELPER_H */
@@ -0,0 +1,350 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BURST_ONOFF_APPLICATION_H
+#define BURST_ONOFF_APPLICATION_H
+
+//
+// OnOff traffic source that plans its packet trains instead of walking
+// through the on/off state machine one event at a time.
+//
+// OnOffApplication schedules a start event and a stop event for every
+// on-period and one send event per packet, and cancels the pending send
+// at the end of each period; with the short periods and Poisson off
+// times of the scenarios, most of those events send nothing.  This
+// application computes, from the same OnTime and OffTime draws in the
+// same order, when the next packet of the train leaves, going through as
+// many on/off periods as it takes, and only schedules that: one event
+// per packet, none for the period boundaries.  The timestamps are those
+// of OnOffApplication, including the bits carried over from one period
+// to the next and the order of a send and a stop at the same time.
+//
+// The draws of a period are made when the previous packet leaves rather
+// than at the start of the period, so reseeding the variables while the
+// application runs shifts the schedule.  Runs of periods without a
+// packet end at the StopTime of the application, or after MAX_IDLE_PERIODS
+// periods with one wake-up event.
+//
+// With a reference application set, the transmit times of both are
+// compared as they happen and the differences counted, to check the
+// schedule against an OnOffApplication with the same draws.
+// burst-onoff-check.cc does the same comparison, of the packet count,
+// times and sizes, over a table of attribute values, and the benchmark
+// runs it first.
+//
+
+#include <deque>
+#include <ostream>
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/data-rate.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/packet-socket-address.h"
+#include "ns3/pointer.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/traced-callback.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+/**
+ * \brief OnOff source scheduling one event per packet and none per
+ * on/off period.
+ */
+class BurstOnOffApplication : public Application
+{
+public:
+  /// On/off periods planned without a packet before a wake-up event.
+  static const uint32_t MAX_IDLE_PERIODS = 1000;
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::BurstOnOffApplication")
+      .SetParent<Application> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<BurstOnOffApplication> ()
+      .AddAttribute ("DataRate", "The data rate in on state.",
+                     DataRateValue (DataRate ("500kb/s")),
+                     MakeDataRateAccessor (&BurstOnOffApplication::m_cbrRate),
+                     MakeDataRateChecker ())
+      .AddAttribute ("PacketSize", "The size of packets sent in on state",
+                     UintegerValue (512),
+                     MakeUintegerAccessor (&BurstOnOffApplication::m_pktSize),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("Remote", "The address of the destination",
+                     AddressValue (),
+                     MakeAddressAccessor (&BurstOnOffApplication::m_peer),
+                     MakeAddressChecker ())
+      .AddAttribute ("OnTime", "A RandomVariableStream used to pick the duration of the 'On' state.",
+                     StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"),
+                     MakePointerAccessor (&BurstOnOffApplication::m_onTime),
+                     MakePointerChecker <RandomVariableStream> ())
+      .AddAttribute ("OffTime", "A RandomVariableStream used to pick the duration of the 'Off' state.",
+                     StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"),
+                     MakePointerAccessor (&BurstOnOffApplication::m_offTime),
+                     MakePointerChecker <RandomVariableStream> ())
+      .AddAttribute ("MaxBytes",
+                     "The total number of bytes to send. Once these bytes are sent, "
+                     "no packet is sent again. The value zero means that there is no limit.",
+                     UintegerValue (0),
+                     MakeUintegerAccessor (&BurstOnOffApplication::m_maxBytes),
+                     MakeUintegerChecker<uint64_t> ())
+      .AddAttribute ("Protocol", "The type of protocol to use. This should be "
+                     "a subclass of ns3::SocketFactory",
+                     TypeIdValue (UdpSocketFactory::GetTypeId ()),
+                     MakeTypeIdAccessor (&BurstOnOffApplication::m_tid),
+                     MakeTypeIdChecker ())
+      .AddTraceSource ("Tx", "A new packet is created and is sent",
+                       MakeTraceSourceAccessor (&BurstOnOffApplication::m_txTrace),
+                       "ns3::Packet::TracedCallback")
+      .AddTraceSource ("TxWithAddresses", "A new packet is created and is sent",
+                       MakeTraceSourceAccessor (&BurstOnOffApplication::m_txTraceWithAddresses),
+                       "ns3::Packet::TwoAddressTracedCallback")
+    ;
+    return tid;
+  }
+
+  BurstOnOffApplication ()
+    : m_pktSize (512),
+      m_maxBytes (0),
+      m_residualBits (0),
+      m_first (false),
+      m_totBytes (0),
+      m_periods (0),
+      m_packets (0),
+      m_events (0),
+      m_validate (false),
+      m_mismatches (0)
+  {
+  }
+
+  /**
+   * \param stream first stream index to use
+   * \return number of stream indices used
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_onTime->SetStream (stream);
+    m_offTime->SetStream (stream + 1);
+    return 2;
+  }
+
+  /**
+   * \brief Compare the transmit times with those of another source.
+   * \param reference an application with a "Tx" trace, usually an
+   *        OnOffApplication with the same attributes and draws
+   */
+  void SetReference (Ptr<Application> reference)
+  {
+    reference->TraceConnectWithoutContext ("Tx", MakeCallback (&BurstOnOffApplication::ReferenceTx, this));
+    m_validate = true;
+  }
+
+  /// \return transmit times that differed from the reference, and
+  ///         packets that only one of them sent so far
+  uint64_t GetMismatches (void) const
+  {
+    return m_mismatches + m_ownTimes.size () + m_referenceTimes.size ();
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    os << "BurstOnOffApplication: " << m_periods << " on periods, "
+       << m_packets << " packets, " << m_events << " events";
+    if (m_validate)
+      {
+        os << ", " << GetMismatches () << " mismatches with the reference";
+      }
+    os << std::endl;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_socket = 0;
+    Application::DoDispose ();
+  }
+
+private:
+  virtual void StartApplication (void)
+  {
+    if (m_socket == 0)
+      {
+        m_socket = Socket::CreateSocket (GetNode (), m_tid);
+        if (Inet6SocketAddress::IsMatchingType (m_peer))
+          {
+            m_socket->Bind6 ();
+          }
+        else if (InetSocketAddress::IsMatchingType (m_peer) || PacketSocketAddress::IsMatchingType (m_peer))
+          {
+            m_socket->Bind ();
+          }
+        m_socket->Connect (m_peer);
+        m_socket->SetAllowBroadcast (true);
+        m_socket->ShutdownRecv ();
+      }
+    TimeValue stopTime;
+    GetAttribute ("StopTime", stopTime);
+    m_stopTime = stopTime.Get ();
+    Simulator::Cancel (m_sendEvent);
+    // As OnOffApplication: an off period first
+    StartPeriod (Simulator::Now () + Seconds (m_offTime->GetValue ()));
+    ScheduleNextTx ();
+  }
+
+  virtual void StopApplication (void)
+  {
+    Simulator::Cancel (m_sendEvent);
+    if (m_socket != 0)
+      {
+        m_socket->Close ();
+      }
+  }
+
+  /// Begin the on period starting at the given time.
+  void StartPeriod (Time start)
+  {
+    m_lastStartTime = start;
+    m_periodEnd = start + Seconds (m_onTime->GetValue ());
+    m_first = true;
+    ++m_periods;
+  }
+
+  /// Plan the next packet, through as many periods as needed, and
+  /// schedule its event.
+  void ScheduleNextTx (void)
+  {
+    for (uint32_t idle = 0; idle < MAX_IDLE_PERIODS; ++idle)
+      {
+        uint32_t bits = m_pktSize * 8 - m_residualBits;
+        Time nextTime = m_lastStartTime + Seconds (bits / static_cast<double> (m_cbrRate.GetBitRate ()));
+        // The first send of a period is scheduled before its stop and
+        // wins a tie; later sends are scheduled after it and lose it.
+        if (nextTime < m_periodEnd || (m_first && nextTime == m_periodEnd))
+          {
+            m_sendEvent = Simulator::Schedule (nextTime - Simulator::Now (), &BurstOnOffApplication::SendPacket, this);
+            ++m_events;
+            return;
+          }
+        // End of the period: keep the bits accumulated since the last
+        // packet, then draw the off and the next on period
+        Time delta = m_periodEnd - m_lastStartTime;
+        int64x64_t residual = delta.To (Time::S) * m_cbrRate.GetBitRate ();
+        m_residualBits += residual.GetHigh ();
+        Time start = m_periodEnd + Seconds (m_offTime->GetValue ());
+        if (!m_stopTime.IsZero () && start >= m_stopTime)
+          {
+            return;
+          }
+        StartPeriod (start);
+      }
+    m_sendEvent = Simulator::Schedule (m_lastStartTime - Simulator::Now (), &BurstOnOffApplication::ScheduleNextTx, this);
+    ++m_events;
+  }
+
+  void SendPacket (void)
+  {
+    Ptr<Packet> packet = Create<Packet> (m_pktSize);
+    m_txTrace (packet);
+    m_socket->Send (packet);
+    m_totBytes += m_pktSize;
+    ++m_packets;
+    if (m_validate)
+      {
+        m_ownTimes.push_back (Simulator::Now ());
+        Compare ();
+      }
+    if (InetSocketAddress::IsMatchingType (m_peer) || Inet6SocketAddress::IsMatchingType (m_peer))
+      {
+        Address localAddress;
+        m_socket->GetSockName (localAddress);
+        m_txTraceWithAddresses (packet, localAddress, m_peer);
+      }
+    m_residualBits = 0;
+    m_lastStartTime = Simulator::Now ();
+    m_first = false;
+    if (m_maxBytes == 0 || m_totBytes < m_maxBytes)
+      {
+        ScheduleNextTx ();
+      }
+    else
+      {
+        StopApplication ();
+      }
+  }
+
+  void ReferenceTx (Ptr<const Packet> packet)
+  {
+    m_referenceTimes.push_back (Simulator::Now ());
+    Compare ();
+  }
+
+  /// Match the transmit times known on both sides.
+  void Compare (void)
+  {
+    while (!m_ownTimes.empty () && !m_referenceTimes.empty ())
+      {
+        if (m_ownTimes.front () != m_referenceTimes.front ())
+          {
+            ++m_mismatches;
+          }
+        m_ownTimes.pop_front ();
+        m_referenceTimes.pop_front ();
+      }
+  }
+
+  Ptr<Socket> m_socket;                   //!< the socket
+  Address m_peer;                         //!< peer address
+  DataRate m_cbrRate;                     //!< rate in the on state
+  uint32_t m_pktSize;                     //!< packet size (bytes)
+  Ptr<RandomVariableStream> m_onTime;     //!< on period durations
+  Ptr<RandomVariableStream> m_offTime;    //!< off period durations
+  uint64_t m_maxBytes;                    //!< limit of bytes sent, 0 for none
+  TypeId m_tid;                           //!< socket factory type
+  Time m_stopTime;                        //!< StopTime of the application
+  Time m_lastStartTime;                   //!< start of the period or last packet
+  Time m_periodEnd;                       //!< end of the current on period
+  uint32_t m_residualBits;                //!< bits carried from earlier periods
+  bool m_first;                           //!< no packet sent yet in the period
+  uint64_t m_totBytes;                    //!< bytes sent
+  EventId m_sendEvent;                    //!< next packet or wake-up
+  uint64_t m_periods;                     //!< on periods planned
+  uint64_t m_packets;                     //!< packets sent
+  uint64_t m_events;                      //!< events scheduled
+  bool m_validate;                        //!< a reference is set
+  std::deque<Time> m_ownTimes;            //!< own times not yet compared
+  std::deque<Time> m_referenceTimes;      //!< reference times not yet compared
+  uint64_t m_mismatches;                  //!< times that differed
+  TracedCallback<Ptr<const Packet> > m_txTrace; //!< packets sent
+  TracedCallback<Ptr<const Packet>, const Address &, const Address &> m_txTraceWithAddresses; //!< packets sent, with addresses
+};
+
+NS_OBJECT_ENSURE_REGISTERED (BurstOnOffApplication);
+
+} // namespace ns3
+
+#endif /* BURST_ONOFF_APPLICATION_H */
@@ -0,0 +1,194 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Check of BurstOnOffApplication against OnOffApplication (see
+// burst-onoff-application.h).  For every case of a fixed table of
+// OnTime, OffTime, DataRate, PacketSize and MaxBytes values, both
+// applications run with the same attributes and the same stream, each
+// on a node of its own without devices, and the packets of their Tx
+// traces are compared: count, time and size of every one.  The program
+// prints the first difference of every failing case and exits with 1 if
+// there is any, so that a change of the draw order of the burst source
+// cannot go unnoticed:
+//
+// ./waf --run "burst-onoff-check"
+//
+// The benchmark runs it before the scenarios (see benchmark.cc).  stream
+// selects the first stream of the draws and runs repeats the table with
+// the streams that follow:
+//
+// ./waf --run "burst-onoff-check --stream=100 --runs=10"
+//
+
+#include <sstream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+#include "burst-onoff-application.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BurstOnOffCheck");
+
+namespace {
+
+/// One case of the table.
+struct Case
+{
+  const char *onTime;   //!< OnTime random variable
+  const char *offTime;  //!< OffTime random variable
+  const char *dataRate; //!< DataRate
+  uint32_t packetSize;  //!< PacketSize
+  uint64_t maxBytes;    //!< MaxBytes (0: no limit)
+};
+
+/// The cases: the scenario source and the corners of the schedule
+/// (periods shorter than a packet, bits carried over, MaxBytes reached,
+/// sends at the end of a period).
+const Case CASES[] = {
+  {"ns3::ConstantRandomVariable[Constant=0.01]", "ns3::ExponentialRandomVariable[Mean=0.1]", "50Mbps", 1000, 0},
+  {"ns3::ConstantRandomVariable[Constant=0.01]", "ns3::ExponentialRandomVariable[Mean=0.001]", "50Mbps", 1472, 0},
+  {"ns3::ConstantRandomVariable[Constant=0.0001]", "ns3::ExponentialRandomVariable[Mean=0.01]", "1Mbps", 1000, 0},
+  {"ns3::ExponentialRandomVariable[Mean=0.005]", "ns3::ExponentialRandomVariable[Mean=0.02]", "2Mbps", 512, 0},
+  {"ns3::UniformRandomVariable[Min=0|Max=0.002]", "ns3::UniformRandomVariable[Min=0|Max=0.01]", "500kbps", 64, 0},
+  {"ns3::ConstantRandomVariable[Constant=0.008]", "ns3::ConstantRandomVariable[Constant=0.002]", "1Mbps", 1000, 0},
+  {"ns3::ConstantRandomVariable[Constant=1]", "ns3::ConstantRandomVariable[Constant=0]", "8Mbps", 1000, 0},
+  {"ns3::ExponentialRandomVariable[Mean=0.05]", "ns3::ExponentialRandomVariable[Mean=0.05]", "10Mbps", 1000, 100000},
+  {"ns3::ConstantRandomVariable[Constant=0.01]", "ns3::ExponentialRandomVariable[Mean=0.1]", "50Mbps", 1472, 14720},
+};
+
+/// One transmitted packet.
+struct Tx
+{
+  Time time;     //!< transmit time
+  uint32_t size; //!< packet size
+};
+
+/// Tx trace sink.
+void
+RecordTx (std::vector<Tx> *packets, Ptr<const Packet> packet)
+{
+  Tx tx = {Simulator::Now (), packet->GetSize ()};
+  packets->push_back (tx);
+}
+
+/// Install an application of the given type with the attributes of a
+/// case on a new node without devices, and record its packets.
+void
+Install (std::string type, const Case &c, int64_t stream, std::vector<Tx> *packets)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (node);
+  PacketSocketAddress nowhere;
+  nowhere.SetAllDevices ();
+  nowhere.SetProtocol (0);
+  // Attributes set one by one, so that each application gets random
+  // variables of its own
+  ObjectFactory factory;
+  factory.SetTypeId (type);
+  Ptr<Application> app = factory.Create<Application> ();
+  app->SetAttribute ("Protocol", TypeIdValue (PacketSocketFactory::GetTypeId ()));
+  app->SetAttribute ("Remote", AddressValue (nowhere));
+  app->SetAttribute ("OnTime", StringValue (c.onTime));
+  app->SetAttribute ("OffTime", StringValue (c.offTime));
+  app->SetAttribute ("DataRate", StringValue (c.dataRate));
+  app->SetAttribute ("PacketSize", UintegerValue (c.packetSize));
+  app->SetAttribute ("MaxBytes", UintegerValue (c.maxBytes));
+  app->SetStartTime (Seconds (2.0));
+  app->SetStopTime (Seconds (10));
+  node->AddApplication (app);
+  Ptr<BurstOnOffApplication> burst = DynamicCast<BurstOnOffApplication> (app);
+  if (burst != 0)
+    {
+      burst->AssignStreams (stream);
+    }
+  else
+    {
+      DynamicCast<OnOffApplication> (app)->AssignStreams (stream);
+    }
+  app->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&RecordTx, packets));
+}
+
+/// \return true if both sources sent the same packets at the same times
+bool
+Check (const Case &c, int64_t stream)
+{
+  std::vector<Tx> reference;
+  std::vector<Tx> burst;
+  Install ("ns3::OnOffApplication", c, stream, &reference);
+  Install ("ns3::BurstOnOffApplication", c, stream, &burst);
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::ostringstream name;
+  name << "OnTime=" << c.onTime << " OffTime=" << c.offTime << " DataRate=" << c.dataRate
+       << " PacketSize=" << c.packetSize << " MaxBytes=" << c.maxBytes << " stream=" << stream;
+  for (uint32_t i = 0; i < reference.size () && i < burst.size (); ++i)
+    {
+      if (reference[i].time != burst[i].time || reference[i].size != burst[i].size)
+        {
+          NS_LOG_UNCOND ("FAIL " << name.str () << ": packet " << i << " sent at "
+                         << burst[i].time.As (Time::NS) << " with " << burst[i].size << " bytes, "
+                         << "OnOffApplication at " << reference[i].time.As (Time::NS)
+                         << " with " << reference[i].size << " bytes");
+          return false;
+        }
+    }
+  if (reference.size () != burst.size ())
+    {
+      NS_LOG_UNCOND ("FAIL " << name.str () << ": " << burst.size () << " packets, OnOffApplication "
+                     << reference.size ());
+      return false;
+    }
+  NS_LOG_INFO ("ok " << name.str () << ": " << burst.size () << " packets");
+  return true;
+}
+
+} // unnamed namespace
+
+int
+main (int argc, char *argv[])
+{
+  int64_t stream = 1;
+  uint32_t runs = 3;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("stream", "first stream of the draws", stream);
+  cmd.AddValue ("runs", "number of streams every case is run with", runs);
+  cmd.Parse (argc, argv);
+
+  uint32_t cases = 0;
+  uint32_t failures = 0;
+  for (uint32_t r = 0; r < runs; ++r)
+    {
+      for (uint32_t i = 0; i < sizeof (CASES) / sizeof (CASES[0]); ++i)
+        {
+          ++cases;
+          if (!Check (CASES[i], stream + 2 * r))
+            {
+              ++failures;
+            }
+        }
+    }
+  NS_LOG_UNCOND ("BurstOnOffApplication against OnOffApplication: " << cases - failures << "/"
+                 << cases << " cases equal");
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,498 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef CACHED_PROPAGATION_MODEL_H
+#define CACHED_PROPAGATION_MODEL_H
+
+//
+// Per-link caches in front of a propagation loss model and a
+// propagation delay model.
+//
+// With slow mobility the loss and delay of a link barely change between
+// two frames, yet the channel asks for both for every receiver of every
+// transmission.  These wrappers keep the last value computed for each
+// (sender, receiver) pair of mobility models, with the positions of
+// both ends at that time, and reuse it until
+//
+//  - either end has moved more than "MaxMovement", or
+//  - the distance between them has changed enough that the cached value
+//    may be off by more than "MaxErrorDb" (loss, assuming a path loss
+//    exponent of at most 2 as in Friis) or "MaxError" (delay, assuming
+//    a delay proportional to distance).
+//
+// A cache holds at most "MaxLinks" links, about 160 bytes each; the
+// least recently used link is dropped to make room for a new one, so a
+// large mobile network, whose links are seen once and never again,
+// cannot grow it to every pair of nodes.
+//
+// Only deterministic models can be cached: the value of a link must not
+// depend on anything but the positions of its ends.  The loss cache
+// stores the loss (tx power minus rx power), so the wrapped model must
+// also be linear in the tx power, as the ns-3 deterministic models are.
+//
+// With "Validate" set, every cache hit is also computed exactly and the
+// largest difference and the number of differences above the bound are
+// reported by PrintStats.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/mobility-model.h"
+#include "ns3/nstime.h"
+#include "ns3/pointer.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+/**
+ * \brief Values cached per (sender, receiver) pair with the positions
+ * they were computed at, up to a number of pairs, least recently used
+ * first out.
+ */
+class LinkCache
+{
+public:
+  /// A cached value.
+  struct Entry
+  {
+    Vector a;          //!< sender position
+    Vector b;          //!< receiver position
+    double distance2;  //!< squared distance between them
+    double value;      //!< the cached value
+  };
+
+  LinkCache ()
+    : m_maxMovement2 (0),
+      m_maxLinks (1 << 18),
+      m_hits (0),
+      m_misses (0),
+      m_evictions (0),
+      m_invalidations (0),
+      m_violations (0),
+      m_maxError (0)
+  {
+  }
+
+  /// \param maxMovement movement (m) of either end that invalidates an entry
+  void SetMaxMovement (double maxMovement)
+  {
+    m_maxMovement2 = maxMovement * maxMovement;
+  }
+
+  /// \param maxLinks number of links kept
+  void SetMaxLinks (uint32_t maxLinks)
+  {
+    m_maxLinks = maxLinks;
+    while (m_entries.size () > m_maxLinks)
+      {
+        Evict ();
+      }
+  }
+
+  /**
+   * \brief Look up the entry of a link.
+   * \param a sender mobility
+   * \param b receiver mobility
+   * \param pa current sender position
+   * \param pb current receiver position
+   * \param[out] entry the entry of the link, created if needed; valid
+   *             until the next Find
+   * \return true if the entry exists and neither end moved too far
+   */
+  bool Find (Ptr<MobilityModel> a, Ptr<MobilityModel> b, const Vector &pa, const Vector &pb, Entry *&entry)
+  {
+    Key key (PeekPointer (a), PeekPointer (b));
+    Map::iterator i = m_entries.find (key);
+    if (i == m_entries.end ())
+      {
+        if (m_entries.size () >= m_maxLinks)
+          {
+            Evict ();
+          }
+        m_order.push_front (std::make_pair (key, Entry ()));
+        m_entries[key] = m_order.begin ();
+        entry = &m_order.front ().second;
+        ++m_misses;
+        return false;
+      }
+    // Most recently used first
+    m_order.splice (m_order.begin (), m_order, i->second);
+    entry = &i->second->second;
+    if (Distance2 (entry->a, pa) > m_maxMovement2 || Distance2 (entry->b, pb) > m_maxMovement2)
+      {
+        ++m_invalidations;
+        return false;
+      }
+    return true;
+  }
+
+  /// \brief Count a hit.
+  void Hit (void)
+  {
+    ++m_hits;
+  }
+
+  /// \brief Count a value found stale by the precision bound.
+  void Invalidate (void)
+  {
+    ++m_invalidations;
+  }
+
+  /**
+   * \brief Store a computed value in an entry.
+   * \param entry the entry returned by Find
+   * \param pa sender position
+   * \param pb receiver position
+   * \param value the exact value
+   */
+  static void Store (Entry *entry, const Vector &pa, const Vector &pb, double value)
+  {
+    entry->a = pa;
+    entry->b = pb;
+    entry->distance2 = Distance2 (pa, pb);
+    entry->value = value;
+  }
+
+  /**
+   * \brief Record the difference between a cached and an exact value.
+   * \param error absolute difference
+   * \param bound largest difference allowed
+   */
+  void Check (double error, double bound)
+  {
+    m_maxError = std::max (m_maxError, error);
+    if (error > bound)
+      {
+        ++m_violations;
+      }
+  }
+
+  /// \return number of hits further than the bound from the exact value
+  uint64_t GetViolations (void) const
+  {
+    return m_violations;
+  }
+
+  /**
+   * \brief Print the counters.
+   * \param os the output stream
+   * \param name name of the cache
+   * \param unit unit of the cached values
+   * \param validate whether Check was called
+   */
+  void PrintStats (std::ostream &os, std::string name, std::string unit, bool validate) const
+  {
+    uint64_t total = m_hits + m_misses + m_invalidations;
+    os << name << ": " << m_entries.size () << " links (at most " << m_maxLinks << "), "
+       << total << " lookups, "
+       << m_hits << " hits (" << (total > 0 ? 100.0 * m_hits / total : 0) << "%), "
+       << m_misses << " misses, " << m_invalidations << " invalidations, "
+       << m_evictions << " links evicted";
+    if (validate)
+      {
+        os << ", max error " << m_maxError << " " << unit << ", "
+           << m_violations << " above the bound";
+      }
+    os << std::endl;
+  }
+
+  static double Distance2 (const Vector &p, const Vector &q)
+  {
+    double dx = p.x - q.x;
+    double dy = p.y - q.y;
+    double dz = p.z - q.z;
+    return dx * dx + dy * dy + dz * dz;
+  }
+
+private:
+  typedef std::pair<const MobilityModel *, const MobilityModel *> Key;
+
+  /// Hash of a pair of mobility model pointers.
+  struct KeyHash
+  {
+    std::size_t operator() (const Key &k) const
+    {
+      std::size_t h = reinterpret_cast<std::size_t> (k.first);
+      return h ^ (reinterpret_cast<std::size_t> (k.second) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    }
+  };
+  typedef std::list<std::pair<Key, Entry> > Order;
+  typedef std::unordered_map<Key, Order::iterator, KeyHash> Map;
+
+  /// Drop the least recently used link.
+  void Evict (void)
+  {
+    m_entries.erase (m_order.back ().first);
+    m_order.pop_back ();
+    ++m_evictions;
+  }
+
+  Order m_order;            //!< entries, most recently used first
+  Map m_entries;            //!< entries by link
+  double m_maxMovement2;    //!< squared movement that invalidates an entry
+  uint32_t m_maxLinks;      //!< links kept
+  uint64_t m_hits;          //!< values served from the cache
+  uint64_t m_misses;        //!< links seen for the first time
+  uint64_t m_invalidations; //!< entries recomputed after movement
+  uint64_t m_evictions;     //!< links dropped to make room
+  uint64_t m_violations;    //!< hits further than the bound from the exact value
+  double m_maxError;        //!< largest difference seen by Check
+};
+
+/**
+ * \brief Propagation loss model caching the loss of each link of another
+ * model.
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CachedPropagationLossModel")
+      .SetParent<PropagationLossModel> ()
+      .SetGroupName ("Propagation")
+      .AddConstructor<CachedPropagationLossModel> ()
+      .AddAttribute ("Model",
+                     "The cached loss model.",
+                     PointerValue (),
+                     MakePointerAccessor (&CachedPropagationLossModel::m_model),
+                     MakePointerChecker<PropagationLossModel> ())
+      .AddAttribute ("MaxMovement",
+                     "Movement (m) of either end that invalidates the loss of a link.",
+                     DoubleValue (1.0),
+                     MakeDoubleAccessor (&CachedPropagationLossModel::SetMaxMovement),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("MaxLinks",
+                     "Links whose loss is kept; the least recently used is dropped first.",
+                     UintegerValue (1 << 18),
+                     MakeUintegerAccessor (&CachedPropagationLossModel::SetMaxLinks),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("MaxErrorDb",
+                     "Largest error (dB) of a cached loss, for a path loss exponent of 2.",
+                     DoubleValue (0.1),
+                     MakeDoubleAccessor (&CachedPropagationLossModel::SetMaxErrorDb),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("Validate",
+                     "Compare every cached loss with the exact one.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&CachedPropagationLossModel::m_validate),
+                     MakeBooleanChecker ())
+    ;
+    return tid;
+  }
+
+  CachedPropagationLossModel ()
+    : m_maxErrorDb (0),
+      m_minRatio2 (1),
+      m_maxRatio2 (1),
+      m_validate (false)
+  {
+  }
+
+  /// \return the number of hits further than MaxErrorDb from the exact loss
+  uint64_t GetViolations (void) const
+  {
+    return m_cache.GetViolations ();
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    m_cache.PrintStats (os, "CachedPropagationLossModel", "dB", m_validate);
+  }
+
+private:
+  void SetMaxMovement (double maxMovement)
+  {
+    m_cache.SetMaxMovement (maxMovement);
+  }
+
+  void SetMaxLinks (uint32_t maxLinks)
+  {
+    m_cache.SetMaxLinks (maxLinks);
+  }
+
+  void SetMaxErrorDb (double maxErrorDb)
+  {
+    // 20 log10 (d / d0) <= MaxErrorDb, on squared distances
+    m_maxErrorDb = maxErrorDb;
+    m_maxRatio2 = std::pow (10, maxErrorDb / 10);
+    m_minRatio2 = 1 / m_maxRatio2;
+  }
+
+  virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+  {
+    Vector pa = a->GetPosition ();
+    Vector pb = b->GetPosition ();
+    LinkCache::Entry *entry;
+    if (m_cache.Find (a, b, pa, pb, entry))
+      {
+        double ratio2 = entry->distance2 > 0 ? LinkCache::Distance2 (pa, pb) / entry->distance2 : 1;
+        if (ratio2 >= m_minRatio2 && ratio2 <= m_maxRatio2)
+          {
+            m_cache.Hit ();
+            if (m_validate)
+              {
+                double exact = txPowerDbm - m_model->CalcRxPower (txPowerDbm, a, b);
+                m_cache.Check (std::fabs (exact - entry->value), m_maxErrorDb);
+              }
+            return txPowerDbm - entry->value;
+          }
+        m_cache.Invalidate ();
+      }
+    double rx = m_model->CalcRxPower (txPowerDbm, a, b);
+    LinkCache::Store (entry, pa, pb, txPowerDbm - rx);
+    return rx;
+  }
+
+  virtual int64_t DoAssignStreams (int64_t stream)
+  {
+    return m_model->AssignStreams (stream);
+  }
+
+  Ptr<PropagationLossModel> m_model;  //!< the cached model
+  mutable LinkCache m_cache;          //!< losses by link
+  double m_maxErrorDb;                //!< largest error of a cached loss
+  double m_minRatio2;                 //!< smallest squared distance ratio kept
+  double m_maxRatio2;                 //!< largest squared distance ratio kept
+  bool m_validate;                    //!< check every hit
+};
+
+/**
+ * \brief Propagation delay model caching the delay of each link of
+ * another model.
+ */
+class CachedPropagationDelayModel : public PropagationDelayModel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CachedPropagationDelayModel")
+      .SetParent<PropagationDelayModel> ()
+      .SetGroupName ("Propagation")
+      .AddConstructor<CachedPropagationDelayModel> ()
+      .AddAttribute ("Model",
+                     "The cached delay model.",
+                     PointerValue (),
+                     MakePointerAccessor (&CachedPropagationDelayModel::m_model),
+                     MakePointerChecker<PropagationDelayModel> ())
+      .AddAttribute ("MaxMovement",
+                     "Movement (m) of either end that invalidates the delay of a link.",
+                     DoubleValue (1.0),
+                     MakeDoubleAccessor (&CachedPropagationDelayModel::SetMaxMovement),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("MaxLinks",
+                     "Links whose delay is kept; the least recently used is dropped first.",
+                     UintegerValue (1 << 18),
+                     MakeUintegerAccessor (&CachedPropagationDelayModel::SetMaxLinks),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("MaxError",
+                     "Largest error of a cached delay, for a delay proportional to distance.",
+                     TimeValue (NanoSeconds (1)),
+                     MakeTimeAccessor (&CachedPropagationDelayModel::m_maxError),
+                     MakeTimeChecker ())
+      .AddAttribute ("Validate",
+                     "Compare every cached delay with the exact one.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&CachedPropagationDelayModel::m_validate),
+                     MakeBooleanChecker ())
+    ;
+    return tid;
+  }
+
+  CachedPropagationDelayModel ()
+    : m_validate (false)
+  {
+  }
+
+  virtual Time GetDelay (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+  {
+    Vector pa = a->GetPosition ();
+    Vector pb = b->GetPosition ();
+    LinkCache::Entry *entry;
+    double maxError = m_maxError.GetNanoSeconds ();
+    if (m_cache.Find (a, b, pa, pb, entry))
+      {
+        // delay0 * |d / d0 - 1| <= MaxError
+        double ratio = entry->distance2 > 0 ? std::sqrt (LinkCache::Distance2 (pa, pb) / entry->distance2) : 1;
+        if (entry->value * std::fabs (ratio - 1) <= maxError)
+          {
+            m_cache.Hit ();
+            if (m_validate)
+              {
+                double error = std::fabs (m_model->GetDelay (a, b).GetNanoSeconds () - entry->value);
+                m_cache.Check (error, maxError);
+              }
+            return NanoSeconds (static_cast<int64_t> (entry->value));
+          }
+        m_cache.Invalidate ();
+      }
+    Time delay = m_model->GetDelay (a, b);
+    LinkCache::Store (entry, pa, pb, delay.GetNanoSeconds ());
+    return delay;
+  }
+
+  /// \return the number of hits further than MaxError from the exact delay
+  uint64_t GetViolations (void) const
+  {
+    return m_cache.GetViolations ();
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    m_cache.PrintStats (os, "CachedPropagationDelayModel", "ns", m_validate);
+  }
+
+private:
+  void SetMaxMovement (double maxMovement)
+  {
+    m_cache.SetMaxMovement (maxMovement);
+  }
+
+  void SetMaxLinks (uint32_t maxLinks)
+  {
+    m_cache.SetMaxLinks (maxLinks);
+  }
+
+  virtual int64_t DoAssignStreams (int64_t stream)
+  {
+    return m_model->AssignStreams (stream);
+  }
+
+  Ptr<PropagationDelayModel> m_model;  //!< the cached model
+  mutable LinkCache m_cache;           //!< delays (ns) by link
+  Time m_maxError;                     //!< largest error of a cached delay
+  bool m_validate;                     //!< check every hit
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationLossModel);
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationDelayModel);
+
+} // namespace ns3
+
+#endif /* CACHED_PROPAGATION_MODEL_H */
@@ -0,0 +1,455 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef EVENT_PROFILER_H
+#define EVENT_PROFILER_H
+
+//
+// Event-loop profiler: wall time and event counts by event source.
+//
+// ProfilingSimulatorImpl is the default simulator with every scheduled
+// event wrapped in a small event that times its execution.  The source
+// of an event is read from the type of its EventImpl, which MakeEvent
+// instantiates for the scheduled function: a member function of
+// olsr::RoutingProtocol (hello and TC timers), of YansWifiPhy (frame
+// reception), of OnOffApplication (send path), and so on.  Its label is
+// the class and the parameter list, e.g. "olsr::RoutingProtocol()";
+// plain functions and trace sinks are labelled "function(...)".
+//
+// Each event also remembers the source of the event that scheduled it,
+// so the folded-stack file written by Report
+//
+//   Simulator::Run;<scheduled by>;<source> <microseconds>
+//
+// shows what triggers the expensive events, e.g. with
+// flamegraph.pl taller1.folded > taller1.svg.
+//
+// Timing one event in "SamplingInterval" keeps the clock reads off most
+// events; counts are exact and times are scaled up.  The wrappers come
+// from a free list rather than the heap, and the source of an EventImpl
+// type is looked up once and then kept in a small direct-mapped cache
+// indexed by its type_info, so an untimed event costs a few loads and
+// stores.  When the profiler is not enabled, the default simulator runs
+// and nothing is paid.  Events must be scheduled from the simulation
+// thread.
+//
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/config.h"
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/global-value.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+/**
+ * \brief Default simulator that profiles its events by source.
+ */
+class ProfilingSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::ProfilingSimulatorImpl")
+      .SetParent<DefaultSimulatorImpl> ()
+      .SetGroupName ("Core")
+      .AddConstructor<ProfilingSimulatorImpl> ()
+      .AddAttribute ("SamplingInterval",
+                     "Time one event in this many.",
+                     UintegerValue (1),
+                     MakeUintegerAccessor (&ProfilingSimulatorImpl::SetSamplingInterval),
+                     MakeUintegerChecker<uint32_t> (1))
+    ;
+    return tid;
+  }
+
+  ProfilingSimulatorImpl ()
+    : m_current (0),
+      m_sampling (1),
+      m_countdown (1),
+      m_runSeconds (0)
+  {
+    // Events scheduled outside of Run
+    m_sites.push_back (Site ("setup"));
+    for (uint32_t i = 0; i < TYPE_CACHE; ++i)
+      {
+        m_typeCache[i].type = 0;
+        m_typeCache[i].site = 0;
+      }
+  }
+
+  /**
+   * \brief Make the simulator created next a profiling one.
+   * \param sampling time one event in this many
+   *
+   * Must be called before the first use of the Simulator.
+   */
+  static void Enable (uint32_t sampling)
+  {
+    Config::SetDefault ("ns3::ProfilingSimulatorImpl::SamplingInterval", UintegerValue (sampling));
+    GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::ProfilingSimulatorImpl"));
+  }
+
+  /**
+   * \brief Print the profile of the current simulator and write its
+   * folded stacks, if it is a profiling one.
+   * \param os the output stream of the table
+   * \param foldedFile the folded-stack file
+   * \param rows number of sources in the table
+   */
+  static void Report (std::ostream &os, std::string foldedFile, uint32_t rows = 20)
+  {
+    Ptr<ProfilingSimulatorImpl> impl = DynamicCast<ProfilingSimulatorImpl> (Simulator::GetImplementation ());
+    if (impl != 0)
+      {
+        impl->Print (os, rows);
+        impl->WriteFolded (foldedFile);
+      }
+  }
+
+  virtual EventId Schedule (const Time &delay, EventImpl *event)
+  {
+    return DefaultSimulatorImpl::Schedule (delay, Wrap (event));
+  }
+
+  virtual void ScheduleWithContext (uint32_t context, const Time &delay, EventImpl *event)
+  {
+    DefaultSimulatorImpl::ScheduleWithContext (context, delay, Wrap (event));
+  }
+
+  virtual EventId ScheduleNow (EventImpl *event)
+  {
+    return DefaultSimulatorImpl::ScheduleNow (Wrap (event));
+  }
+
+  virtual void Run (void)
+  {
+    Clock::time_point start = Clock::now ();
+    DefaultSimulatorImpl::Run ();
+    m_runSeconds += std::chrono::duration<double> (Clock::now () - start).count ();
+    m_current = 0;
+  }
+
+  /**
+   * \brief Print the sources ranked by wall time.
+   * \param os the output stream
+   * \param rows number of sources printed
+   */
+  void Print (std::ostream &os, uint32_t rows) const
+  {
+    std::vector<uint32_t> order;
+    uint64_t events = 0;
+    double seconds = 0;
+    for (uint32_t i = 0; i < m_sites.size (); ++i)
+      {
+        if (m_sites[i].events > 0)
+          {
+            order.push_back (i);
+            events += m_sites[i].events;
+            seconds += GetSeconds (m_sites[i]);
+          }
+      }
+    std::sort (order.begin (), order.end (), BySeconds (this));
+    os << "Event profile: " << events << " events, " << m_runSeconds << " s in Run, "
+       << seconds << " s in events (1 in " << m_sampling << " timed)" << std::endl;
+    os << std::setw (12) << "events" << std::setw (12) << "seconds" << std::setw (8) << "share"
+       << std::setw (10) << "mean_us" << "  source" << std::endl;
+    for (uint32_t r = 0; r < order.size () && r < rows; ++r)
+      {
+        const Site &site = m_sites[order[r]];
+        double s = GetSeconds (site);
+        os << std::setw (12) << site.events
+           << std::setw (12) << std::fixed << std::setprecision (4) << s
+           << std::setw (7) << std::setprecision (1) << (m_runSeconds > 0 ? 100 * s / m_runSeconds : 0) << "%"
+           << std::setw (10) << std::setprecision (2) << 1e6 * s / site.events
+           << "  " << site.label << std::endl;
+        os.unsetf (std::ios::floatfield);
+        os << std::setprecision (6);
+      }
+  }
+
+  /**
+   * \brief Write the flamegraph folded stacks, weighted in microseconds.
+   * \param filename the file
+   */
+  void WriteFolded (std::string filename) const
+  {
+    std::ofstream os (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (os.is_open (), "ProfilingSimulatorImpl: cannot open " << filename);
+    for (Edges::const_iterator e = m_edges.begin (); e != m_edges.end (); ++e)
+      {
+        const Site &parent = m_sites[e->first >> 32];
+        const Site &site = m_sites[e->first & 0xffffffff];
+        double scale = site.sampled > 0 ? static_cast<double> (site.events) / site.sampled : 0;
+        uint64_t us = static_cast<uint64_t> (e->second * scale / 1000);
+        if (us > 0)
+          {
+            os << "Simulator::Run;" << Folded (parent.label) << ";" << Folded (site.label) << " " << us << "\n";
+          }
+      }
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  /// Sampled nanoseconds by (scheduling source << 32 | source).
+  typedef std::unordered_map<uint64_t, uint64_t> Edges;
+
+  /// Counters of one event source.
+  struct Site
+  {
+    Site (std::string l)
+      : label (l),
+        events (0),
+        sampled (0),
+        nanoseconds (0)
+    {
+    }
+    std::string label;     //!< class and parameters of the event function
+    uint64_t events;       //!< events executed
+    uint64_t sampled;      //!< events timed
+    uint64_t nanoseconds;  //!< wall time of the timed events
+  };
+
+  /// Event that times the wrapped one.
+  class ProfiledEvent : public EventImpl
+  {
+  public:
+    ProfiledEvent (ProfilingSimulatorImpl *profiler, EventImpl *event, uint32_t site, uint32_t parent)
+      : m_profiler (profiler),
+        m_event (event, false),
+        m_site (site),
+        m_parent (parent)
+    {
+    }
+
+    /// From the free list of recycled events, or the heap.
+    static void *operator new (std::size_t size)
+    {
+      void *&head = FreeList ();
+      if (head == 0)
+        {
+          return ::operator new (size);
+        }
+      void *p = head;
+      head = *static_cast<void **> (p);
+      return p;
+    }
+
+    /// Back to the free list; the events live as long as the program.
+    static void operator delete (void *p)
+    {
+      void *&head = FreeList ();
+      *static_cast<void **> (p) = head;
+      head = p;
+    }
+
+  protected:
+    virtual void Notify (void)
+    {
+      ProfilingSimulatorImpl *p = m_profiler;
+      p->m_current = m_site;
+      ++p->m_sites[m_site].events;
+      if (--p->m_countdown > 0)
+        {
+          m_event->Invoke ();
+          return;
+        }
+      p->m_countdown = p->m_sampling;
+      Clock::time_point start = Clock::now ();
+      m_event->Invoke ();
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds> (Clock::now () - start).count ();
+      // The event may have added sites: index again
+      Site &site = p->m_sites[m_site];
+      ++site.sampled;
+      site.nanoseconds += ns;
+      p->m_edges[(static_cast<uint64_t> (m_parent) << 32) | m_site] += ns;
+    }
+
+  private:
+    static void *&FreeList (void)
+    {
+      static void *head = 0;
+      return head;
+    }
+
+    ProfilingSimulatorImpl *m_profiler;  //!< the simulator
+    Ptr<EventImpl> m_event;              //!< the wrapped event
+    uint32_t m_site;                     //!< its source
+    uint32_t m_parent;                   //!< source of the scheduling event
+  };
+
+  /// Order of the sites in the table.
+  struct BySeconds
+  {
+    BySeconds (const ProfilingSimulatorImpl *p)
+      : profiler (p)
+    {
+    }
+    bool operator() (uint32_t a, uint32_t b) const
+    {
+      return profiler->GetSeconds (profiler->m_sites[a]) > profiler->GetSeconds (profiler->m_sites[b]);
+    }
+    const ProfilingSimulatorImpl *profiler;
+  };
+
+  void SetSamplingInterval (uint32_t sampling)
+  {
+    m_sampling = sampling;
+    m_countdown = sampling;
+  }
+
+  EventImpl *Wrap (EventImpl *event)
+  {
+    const std::type_info *type = &typeid (*event);
+    TypeSlot &slot = m_typeCache[(reinterpret_cast<uintptr_t> (type) >> 4) & (TYPE_CACHE - 1)];
+    if (slot.type != type)
+      {
+        slot.type = type;
+        slot.site = GetSite (*type);
+      }
+    return new ProfiledEvent (this, event, slot.site, m_current);
+  }
+
+  uint32_t GetSite (const std::type_info &type)
+  {
+    std::unordered_map<const std::type_info *, uint32_t>::const_iterator i = m_siteByType.find (&type);
+    if (i != m_siteByType.end ())
+      {
+        return i->second;
+      }
+    // The same type may have several type_info objects across libraries
+    std::string label = MakeLabel (type.name ());
+    std::unordered_map<std::string, uint32_t>::const_iterator j = m_siteByLabel.find (label);
+    uint32_t site;
+    if (j != m_siteByLabel.end ())
+      {
+        site = j->second;
+      }
+    else
+      {
+        site = m_sites.size ();
+        m_sites.push_back (Site (label));
+        m_siteByLabel[label] = site;
+      }
+    m_siteByType[&type] = site;
+    return site;
+  }
+
+  double GetSeconds (const Site &site) const
+  {
+    if (site.sampled == 0)
+      {
+        return 0;
+      }
+    return 1e-9 * site.nanoseconds * site.events / site.sampled;
+  }
+
+  /**
+   * \param mangled name of an EventImpl type
+   * \return the class and parameter list of the function it calls
+   */
+  static std::string MakeLabel (const char *mangled)
+  {
+    int status;
+    char *demangled = abi::__cxa_demangle (mangled, 0, 0, &status);
+    std::string name = status == 0 ? demangled : mangled;
+    std::free (demangled);
+    for (std::string::size_type pos = name.find ("ns3::"); pos != std::string::npos; pos = name.find ("ns3::", pos))
+      {
+        name.erase (pos, 5);
+      }
+    std::string::size_type member = name.find ("::*)");
+    std::string::size_type function = name.find ("(*)");
+    std::string owner;
+    std::string::size_type args;
+    if (member != std::string::npos && (function == std::string::npos || member < function))
+      {
+        std::string::size_type open = name.rfind ('(', member);
+        owner = name.substr (open + 1, member - open - 1);
+        args = member + 4;
+      }
+    else if (function != std::string::npos)
+      {
+        owner = "function";
+        args = function + 3;
+      }
+    else
+      {
+        return name;
+      }
+    // The parameter list, up to the matching parenthesis
+    int depth = 0;
+    std::string::size_type end = args;
+    for (; end < name.size (); ++end)
+      {
+        depth += name[end] == '(' ? 1 : name[end] == ')' ? -1 : 0;
+        if (depth == 0)
+          {
+            break;
+          }
+      }
+    return owner + name.substr (args, end - args + 1);
+  }
+
+  /// \return the label without the folded-stack separators
+  static std::string Folded (std::string label)
+  {
+    std::replace (label.begin (), label.end (), ';', ',');
+    std::replace (label.begin (), label.end (), ' ', '_');
+    return label;
+  }
+
+  /// Source of a recently seen EventImpl type.
+  struct TypeSlot
+  {
+    const std::type_info *type;  //!< the type, or 0
+    uint32_t site;               //!< its source
+  };
+  static const uint32_t TYPE_CACHE = 256;  //!< slots of the type cache, a power of two
+
+  std::vector<Site> m_sites;  //!< event sources, 0 for the setup
+  TypeSlot m_typeCache[TYPE_CACHE];  //!< direct-mapped cache in front of m_siteByType
+  std::unordered_map<const std::type_info *, uint32_t> m_siteByType;  //!< site of each EventImpl type
+  std::unordered_map<std::string, uint32_t> m_siteByLabel;            //!< site of each label
+  Edges m_edges;              //!< sampled time by scheduling and executed source
+  uint32_t m_current;         //!< source of the executing event
+  uint32_t m_sampling;        //!< time one event in this many
+  uint32_t m_countdown;       //!< events before the next timed one
+  double m_runSeconds;        //!< wall time spent in Run
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingSimulatorImpl);
+
+} // namespace ns3
+
+#endif /* EVENT_PROFILER_H */
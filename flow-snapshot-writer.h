@@ -0,0 +1,360 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FLOW_SNAPSHOT_WRITER_H
+#define FLOW_SNAPSHOT_WRITER_H
+
+//
+// Periodic FlowMonitor snapshots written while the simulation runs.
+//
+// Every interval, each flow that saw traffic since the previous snapshot
+// gets one CSV row with the increments of its counters over that
+// interval, and the number of packets received in each of a fixed set
+// of delay buckets:
+//
+//   time,flowId,txPackets,rxPackets,txBytes,rxBytes,lostPackets,
+//   delaySumNs,jitterSumNs,d0,...,d12
+//
+// where bucket dK counts received packets whose delay is below the K-th
+// bound of DELAY_BUCKETS_MS (d12: above the last one).  Summing the
+// rows of a flow gives its totals, so the file can be followed with
+// "tail -f" to watch throughput and delay converge and stop a bad run
+// early.
+//
+// The buckets are filled from per-packet IPv4 traces of the monitored
+// nodes, not from the FlowMonitor delay histogram, whose bins are
+// coarser than the first bounds and grow with the largest delay.  The
+// writer keeps the previous totals and the bucket counters of each
+// flow, and the send time of the packets in flight, forgotten after the
+// MaxPerHopDelay of the monitor.  A sent packet is matched to its flow
+// by its 5-tuple, looked up in the flows the classifier already holds
+// (FindFlow): classifying it a second time would advance the packet ids
+// and DSCP counts of the classifier, which the XML output reports.
+// Every flow of the monitor is assumed to be an IPv4 one, as in these
+// scenarios.  The FlowMonitor histograms are then
+// only needed for its XML output; CoarsenHistograms makes them a single
+// bin when that is not written.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/event-id.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+/// Upper bounds (ms) of the delay buckets of FlowSnapshotWriter.
+static const double DELAY_BUCKETS_MS[] = {0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500};
+
+/**
+ * \brief Write FlowMonitor statistics as per-interval deltas.
+ */
+class FlowSnapshotWriter
+{
+public:
+  /// Number of delay buckets, including the overflow one.
+  static const uint32_t N_BUCKETS = sizeof (DELAY_BUCKETS_MS) / sizeof (DELAY_BUCKETS_MS[0]) + 1;
+
+  FlowSnapshotWriter ()
+    : m_lastFlow (0)
+  {
+  }
+
+  ~FlowSnapshotWriter ()
+  {
+    Stop ();
+  }
+
+  /**
+   * \brief Make the histograms of the monitors of a helper a single bin,
+   * before they are installed.
+   * \param helper the FlowMonitor helper
+   */
+  static void CoarsenHistograms (FlowMonitorHelper &helper)
+  {
+    helper.SetMonitorAttribute ("DelayBinWidth", DoubleValue (1e9));
+    helper.SetMonitorAttribute ("JitterBinWidth", DoubleValue (1e9));
+    helper.SetMonitorAttribute ("PacketSizeBinWidth", DoubleValue (1e9));
+    helper.SetMonitorAttribute ("FlowInterruptionsBinWidth", DoubleValue (1e9));
+  }
+
+  /**
+   * \brief Start writing snapshots.
+   * \param monitor the flow monitor
+   * \param classifier the classifier of its helper
+   * \param nodes the nodes it is installed on
+   * \param filename the CSV file
+   * \param interval time between two snapshots
+   */
+  void Start (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier, NodeContainer nodes,
+              std::string filename, Time interval)
+  {
+    NS_ABORT_MSG_UNLESS (interval.IsStrictlyPositive (), "FlowSnapshotWriter: interval must be positive");
+    m_monitor = monitor;
+    m_classifier = classifier;
+    m_interval = interval;
+    TimeValue maxDelay;
+    monitor->GetAttribute ("MaxPerHopDelay", maxDelay);
+    m_maxDelay = maxDelay.Get ();
+    for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*n)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 != 0)
+          {
+            ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&FlowSnapshotWriter::Sent, this));
+            ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeCallback (&FlowSnapshotWriter::Delivered, this));
+          }
+      }
+    m_file.open (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (m_file.is_open (), "FlowSnapshotWriter: cannot open " << filename);
+    m_file << "time,flowId,txPackets,rxPackets,txBytes,rxBytes,lostPackets,delaySumNs,jitterSumNs";
+    for (uint32_t k = 0; k < N_BUCKETS; ++k)
+      {
+        m_file << ",d" << k;
+      }
+    m_file << std::endl;
+    m_event = Simulator::Schedule (m_interval, &FlowSnapshotWriter::Snapshot, this);
+  }
+
+  /// \brief Write a last snapshot and close the file.
+  void Stop (void)
+  {
+    if (!m_file.is_open ())
+      {
+        return;
+      }
+    Simulator::Cancel (m_event);
+    Write ();
+    m_file.close ();
+    m_monitor = 0;
+    m_classifier = 0;
+    m_inFlight.clear ();
+    m_flows.clear ();
+  }
+
+private:
+  /// Packets received by a flow in each delay bucket.
+  struct Buckets
+  {
+    Buckets ()
+    {
+      std::fill (counts, counts + N_BUCKETS, 0);
+    }
+
+    uint64_t counts[N_BUCKETS];  //!< packets of each bucket
+  };
+
+  /// Totals of a flow at the previous snapshot.
+  struct Totals
+  {
+    uint64_t txPackets;
+    uint64_t rxPackets;
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    uint64_t lostPackets;
+    int64_t delaySumNs;
+    int64_t jitterSumNs;
+    uint64_t buckets[N_BUCKETS];
+  };
+
+  /// A packet in flight.
+  struct InFlight
+  {
+    FlowId flow;      //!< its flow
+    int64_t sentNs;   //!< when it was sent
+  };
+
+  void Sent (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    Ipv4Address destination = header.GetDestination ();
+    if (!m_file.is_open () || destination.IsBroadcast () || destination.IsMulticast ())
+      {
+        return;
+      }
+    FlowId flow;
+    if (FindFlow (header, packet, &flow))
+      {
+        InFlight &f = m_inFlight[packet->GetUid ()];
+        f.flow = flow;
+        f.sentNs = Simulator::Now ().GetNanoSeconds ();
+      }
+  }
+
+  /**
+   * \brief Look up the flow of a packet as Ipv4FlowClassifier::Classify
+   * would, without changing the state of the classifier.
+   * \return false if the packet belongs to no flow
+   */
+  bool FindFlow (const Ipv4Header &header, Ptr<const Packet> packet, FlowId *flow)
+  {
+    static const uint8_t TCP_PROT_NUMBER = 6;
+    static const uint8_t UDP_PROT_NUMBER = 17;
+    if (header.GetFragmentOffset () > 0 || packet->GetSize () < 4
+        || (header.GetProtocol () != TCP_PROT_NUMBER && header.GetProtocol () != UDP_PROT_NUMBER))
+      {
+        return false;
+      }
+    uint8_t ports[4];
+    packet->CopyData (ports, 4);
+    Ipv4FlowClassifier::FiveTuple tuple;
+    tuple.sourceAddress = header.GetSource ();
+    tuple.destinationAddress = header.GetDestination ();
+    tuple.protocol = header.GetProtocol ();
+    tuple.sourcePort = (ports[0] << 8) | ports[1];
+    tuple.destinationPort = (ports[2] << 8) | ports[3];
+    std::map<Ipv4FlowClassifier::FiveTuple, FlowId>::const_iterator f = m_flows.find (tuple);
+    if (f == m_flows.end ())
+      {
+        // A new flow: the probe classified the packet before this trace
+        // fired, so the monitor has its id
+        const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+        for (FlowMonitor::FlowStatsContainerCI i = stats.upper_bound (m_lastFlow); i != stats.end (); ++i)
+          {
+            m_flows[m_classifier->FindFlow (i->first)] = i->first;
+            m_lastFlow = i->first;
+          }
+        f = m_flows.find (tuple);
+        if (f == m_flows.end ())
+          {
+            return false;
+          }
+      }
+    *flow = f->second;
+    return true;
+  }
+
+  void Delivered (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    std::unordered_map<uint64_t, InFlight>::iterator f = m_inFlight.find (packet->GetUid ());
+    if (f == m_inFlight.end ())
+      {
+        return;
+      }
+    double delayMs = (Simulator::Now ().GetNanoSeconds () - f->second.sentNs) / 1e6;
+    ++m_buckets[f->second.flow].counts[GetBucket (delayMs)];
+    m_inFlight.erase (f);
+  }
+
+  /// Forget the packets in flight for longer than the monitor waits for them.
+  void ForgetLost (void)
+  {
+    int64_t oldest = (Simulator::Now () - m_maxDelay).GetNanoSeconds ();
+    for (std::unordered_map<uint64_t, InFlight>::iterator f = m_inFlight.begin (); f != m_inFlight.end ();)
+      {
+        if (f->second.sentNs < oldest)
+          {
+            f = m_inFlight.erase (f);
+          }
+        else
+          {
+            ++f;
+          }
+      }
+  }
+
+  static uint32_t GetBucket (double delayMs)
+  {
+    uint32_t k = 0;
+    while (k < N_BUCKETS - 1 && delayMs >= DELAY_BUCKETS_MS[k])
+      {
+        ++k;
+      }
+    return k;
+  }
+
+  void Snapshot (void)
+  {
+    Write ();
+    m_event = Simulator::Schedule (m_interval, &FlowSnapshotWriter::Snapshot, this);
+  }
+
+  void Write (void)
+  {
+    m_monitor->CheckForLostPackets ();
+    ForgetLost ();
+    const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+    double now = Simulator::Now ().GetSeconds ();
+    for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+      {
+        const FlowMonitor::FlowStats &s = i->second;
+        Totals cur;
+        cur.txPackets = s.txPackets;
+        cur.rxPackets = s.rxPackets;
+        cur.txBytes = s.txBytes;
+        cur.rxBytes = s.rxBytes;
+        cur.lostPackets = s.lostPackets;
+        cur.delaySumNs = s.delaySum.GetNanoSeconds ();
+        cur.jitterSumNs = s.jitterSum.GetNanoSeconds ();
+        const Buckets &buckets = m_buckets[i->first];
+        std::copy (buckets.counts, buckets.counts + N_BUCKETS, cur.buckets);
+
+        std::map<FlowId, Totals>::iterator prev = m_previous.find (i->first);
+        if (prev == m_previous.end ())
+          {
+            Totals zero = Totals ();
+            prev = m_previous.insert (std::make_pair (i->first, zero)).first;
+          }
+        Totals &p = prev->second;
+        if (cur.txPackets == p.txPackets && cur.rxPackets == p.rxPackets
+            && cur.lostPackets == p.lostPackets)
+          {
+            continue;
+          }
+        m_file << now << "," << i->first << ","
+               << cur.txPackets - p.txPackets << "," << cur.rxPackets - p.rxPackets << ","
+               << cur.txBytes - p.txBytes << "," << cur.rxBytes - p.rxBytes << ","
+               << cur.lostPackets - p.lostPackets << ","
+               << cur.delaySumNs - p.delaySumNs << "," << cur.jitterSumNs - p.jitterSumNs;
+        for (uint32_t k = 0; k < N_BUCKETS; ++k)
+          {
+            m_file << "," << cur.buckets[k] - p.buckets[k];
+          }
+        m_file << "\n";
+        p = cur;
+      }
+    m_file.flush ();
+  }
+
+  Ptr<FlowMonitor> m_monitor;          //!< the flow monitor
+  Ptr<Ipv4FlowClassifier> m_classifier; //!< its classifier
+  Time m_maxDelay;                     //!< how long a packet may be in flight
+  Time m_interval;                     //!< time between two snapshots
+  std::ofstream m_file;                //!< the CSV file
+  std::map<FlowId, Totals> m_previous; //!< totals at the previous snapshot
+  std::map<FlowId, Buckets> m_buckets; //!< delay buckets of each flow
+  std::unordered_map<uint64_t, InFlight> m_inFlight; //!< packets in flight by uid
+  std::map<Ipv4FlowClassifier::FiveTuple, FlowId> m_flows; //!< flows known to the classifier
+  FlowId m_lastFlow;                   //!< largest id in m_flows
+  EventId m_event;                     //!< next snapshot
+};
+
+} // namespace ns3
+
+#endif /* FLOW_SNAPSHOT_WRITER_H */
@@ -0,0 +1,109 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FLOW_SUMMARY_H
+#define FLOW_SUMMARY_H
+
+//
+// One CSV row per FlowMonitor flow, used to merge the results of
+// several runs into a single table, or one row with the totals of all
+// the flows of a run.
+//
+
+#include <map>
+#include <ostream>
+
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+
+namespace ns3 {
+
+/// Column names of the rows written by WriteFlowSummary.
+static const char FLOW_SUMMARY_COLUMNS[] =
+  "flowId,source,destination,txPackets,rxPackets,lostPackets,"
+  "throughputKbps,meanDelayMs,meanJitterMs";
+
+/**
+ * \brief Write one CSV row per monitored flow.
+ * \param monitor the flow monitor, after Simulator::Run
+ * \param classifier the classifier of the FlowMonitorHelper
+ * \param os the output stream
+ */
+static inline void
+WriteFlowSummary (Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier, std::ostream &os)
+{
+  monitor->CheckForLostPackets ();
+  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      const FlowMonitor::FlowStats &s = i->second;
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+      double duration = (s.timeLastRxPacket - s.timeFirstTxPacket).GetSeconds ();
+      double throughput = duration > 0 ? s.rxBytes * 8.0 / duration / 1000.0 : 0;
+      double delay = s.rxPackets > 0 ? s.delaySum.GetSeconds () * 1000.0 / s.rxPackets : 0;
+      double jitter = s.rxPackets > 1 ? s.jitterSum.GetSeconds () * 1000.0 / (s.rxPackets - 1) : 0;
+      os << i->first << ","
+         << t.sourceAddress << ":" << t.sourcePort << ","
+         << t.destinationAddress << ":" << t.destinationPort << ","
+         << s.txPackets << "," << s.rxPackets << "," << s.lostPackets << ","
+         << throughput << "," << delay << "," << jitter << std::endl;
+    }
+}
+
+/// Column names of the row written by WriteFlowTotals.
+static const char FLOW_TOTALS_COLUMNS[] =
+  "flows,txPackets,rxPackets,lostPackets,throughputKbps,meanDelayMs,meanJitterMs";
+
+/**
+ * \brief Write one CSV row with the totals of all the monitored flows:
+ * the sums of their packets and throughputs, and the delay and jitter
+ * averaged over all their packets.
+ * \param monitor the flow monitor, after Simulator::Run
+ * \param os the output stream
+ */
+static inline void
+WriteFlowTotals (Ptr<FlowMonitor> monitor, std::ostream &os)
+{
+  monitor->CheckForLostPackets ();
+  std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  uint64_t lostPackets = 0;
+  uint64_t jitterPackets = 0;
+  double throughput = 0;
+  double delaySum = 0;
+  double jitterSum = 0;
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      const FlowMonitor::FlowStats &s = i->second;
+      double duration = (s.timeLastRxPacket - s.timeFirstTxPacket).GetSeconds ();
+      throughput += duration > 0 ? s.rxBytes * 8.0 / duration / 1000.0 : 0;
+      txPackets += s.txPackets;
+      rxPackets += s.rxPackets;
+      lostPackets += s.lostPackets;
+      jitterPackets += s.rxPackets > 1 ? s.rxPackets - 1 : 0;
+      delaySum += s.delaySum.GetSeconds ();
+      jitterSum += s.jitterSum.GetSeconds ();
+    }
+  os << stats.size () << "," << txPackets << "," << rxPackets << "," << lostPackets << ","
+     << throughput << "," << (rxPackets > 0 ? delaySum * 1000.0 / rxPackets : 0) << ","
+     << (jitterPackets > 0 ? jitterSum * 1000.0 / jitterPackets : 0) << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* FLOW_SUMMARY_H */
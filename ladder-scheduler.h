@@ -0,0 +1,315 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+//
+// Ladder queue event scheduler (Tang, Goh and Thng, ACM TOMACS 2005).
+//
+// The wireless scenarios schedule mostly near-future events (OLSR
+// hellos of every node, OnOff packets, one PHY event per receiver of
+// every frame), for which the O(log n) insertion of the map and heap
+// schedulers dominates.  The ladder queue keeps events in three tiers:
+//
+//  - Top: an unsorted list of the events beyond the ladder;
+//  - the ladder: up to MAX_RUNGS rungs of unsorted buckets, each rung
+//    splitting one bucket of the rung above into finer ones;
+//  - Bottom: a short sorted list of the earliest events.
+//
+// Insertion appends to the list or bucket that covers the timestamp,
+// and only events landing in Bottom are inserted in order.  When Bottom
+// runs out, the first non-empty bucket of the lowest rung moves to it,
+// or is split into a new rung if it holds more than THRESHOLD events;
+// when the ladder runs out, Top is spread into a first rung whose bucket
+// width adapts to the spread of its events.  Both moves are amortized
+// O(1) per event.
+//
+// The scheduler is selected with the "SchedulerType" global value;
+// GetSchedulerTypeName maps the short names of the command line to the
+// ns-3 schedulers and this one.
+//
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+#include "ns3/scheduler.h"
+
+namespace ns3 {
+
+/**
+ * \brief Event scheduler implemented with a ladder queue.
+ */
+class LadderScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LadderScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<LadderScheduler> ()
+    ;
+    return tid;
+  }
+
+  LadderScheduler ()
+    : m_rungs (MAX_RUNGS),
+      m_nRungs (0),
+      m_topStart (0),
+      m_topMin (std::numeric_limits<uint64_t>::max ()),
+      m_topMax (0),
+      m_size (0)
+  {
+  }
+
+  virtual void Insert (const Event &ev)
+  {
+    ++m_size;
+    uint64_t ts = ev.key.m_ts;
+    if (ts >= m_topStart)
+      {
+        m_top.push_back (ev);
+        m_topMin = std::min (m_topMin, ts);
+        m_topMax = std::max (m_topMax, ts);
+        return;
+      }
+    Bucket *bucket = FindBucket (ts);
+    if (bucket != 0)
+      {
+        bucket->push_back (ev);
+        return;
+      }
+    m_bottom.insert (std::lower_bound (m_bottom.begin (), m_bottom.end (), ev, Later), ev);
+    if (m_bottom.size () > THRESHOLD && m_nRungs < MAX_RUNGS)
+      {
+        // Too many events inserted in order: spread Bottom into a rung
+        uint64_t start = m_bottom.back ().key.m_ts;
+        uint64_t end = m_nRungs > 0 ? m_rungs[m_nRungs - 1].GetCurrentStart () : m_topStart;
+        if (end - start > 1)
+          {
+            SpawnRung (m_bottom, start, end);
+          }
+      }
+  }
+
+  virtual bool IsEmpty (void) const
+  {
+    return m_size == 0;
+  }
+
+  virtual Event PeekNext (void) const
+  {
+    const_cast<LadderScheduler *> (this)->Refill ();
+    return m_bottom.back ();
+  }
+
+  virtual Event RemoveNext (void)
+  {
+    Refill ();
+    Event ev = m_bottom.back ();
+    m_bottom.pop_back ();
+    --m_size;
+    return ev;
+  }
+
+  virtual void Remove (const Event &ev)
+  {
+    uint64_t ts = ev.key.m_ts;
+    Bucket *list = ts >= m_topStart ? &m_top : FindBucket (ts);
+    if (list == 0)
+      {
+        list = &m_bottom;
+      }
+    for (Bucket::iterator i = list->begin (); i != list->end (); ++i)
+      {
+        if (i->key.m_uid == ev.key.m_uid)
+          {
+            if (list == &m_bottom)
+              {
+                m_bottom.erase (i);
+              }
+            else
+              {
+                *i = list->back ();
+                list->pop_back ();
+              }
+            --m_size;
+            return;
+          }
+      }
+    NS_ABORT_MSG ("LadderScheduler: removed event not found");
+  }
+
+private:
+  /// Events of a bucket, in no order.
+  typedef std::vector<Event> Bucket;
+
+  /// Buckets of equal width covering [start, start + width * buckets).
+  struct Rung
+  {
+    uint64_t start;                //!< timestamp of the first bucket
+    uint64_t width;                //!< timestamps per bucket
+    uint32_t current;              //!< first bucket not yet moved down
+    std::vector<Bucket> buckets;   //!< the buckets
+
+    uint64_t GetCurrentStart (void) const
+    {
+      return start + width * current;
+    }
+  };
+
+  static const uint32_t THRESHOLD = 50;  //!< largest bucket moved to Bottom
+  static const uint32_t MAX_RUNGS = 8;   //!< deepest ladder
+
+  static bool Later (const Event &a, const Event &b)
+  {
+    return b < a;
+  }
+
+  /**
+   * \param ts a timestamp below m_topStart
+   * \return the bucket of the ladder covering it, or 0 for Bottom
+   */
+  Bucket *FindBucket (uint64_t ts)
+  {
+    // Every rung ends where the current bucket of the rung above starts
+    for (uint32_t i = 0; i < m_nRungs; ++i)
+      {
+        Rung &rung = m_rungs[i];
+        if (ts >= rung.GetCurrentStart ())
+          {
+            uint64_t index = std::min<uint64_t> ((ts - rung.start) / rung.width, rung.buckets.size () - 1);
+            return &rung.buckets[index];
+          }
+      }
+    return 0;
+  }
+
+  /**
+   * \brief Spread events over a new lowest rung covering [start, end).
+   * \param events the events, emptied
+   * \param start the first timestamp of the rung
+   * \param end the end of the rung
+   */
+  void SpawnRung (Bucket &events, uint64_t start, uint64_t end)
+  {
+    NS_ASSERT (m_nRungs < MAX_RUNGS && end > start);
+    uint64_t span = end - start;
+    uint64_t n = std::max<uint64_t> (events.size (), 1);
+    Rung &rung = m_rungs[m_nRungs++];
+    rung.start = start;
+    rung.width = std::max<uint64_t> ((span + n - 1) / n, 1);
+    rung.current = 0;
+    rung.buckets.resize ((span + rung.width - 1) / rung.width);
+    for (Bucket::const_iterator i = events.begin (); i != events.end (); ++i)
+      {
+        rung.buckets[(i->key.m_ts - start) / rung.width].push_back (*i);
+      }
+    events.clear ();
+  }
+
+  /// Make sure Bottom holds the earliest events, if any.
+  void Refill (void)
+  {
+    NS_ASSERT_MSG (m_size > 0, "LadderScheduler: empty");
+    while (m_bottom.empty ())
+      {
+        if (m_nRungs == 0)
+          {
+            SpawnRung (m_top, m_topMin, m_topMax + 1);
+            const Rung &rung = m_rungs[0];
+            m_topStart = rung.start + rung.width * rung.buckets.size ();
+            m_topMin = std::numeric_limits<uint64_t>::max ();
+            m_topMax = 0;
+            continue;
+          }
+        Rung &rung = m_rungs[m_nRungs - 1];
+        while (rung.current < rung.buckets.size () && rung.buckets[rung.current].empty ())
+          {
+            ++rung.current;
+          }
+        if (rung.current == rung.buckets.size ())
+          {
+            --m_nRungs;
+            continue;
+          }
+        Bucket &bucket = rung.buckets[rung.current];
+        uint64_t start = rung.GetCurrentStart ();
+        ++rung.current;
+        if (bucket.size () > THRESHOLD && rung.width > 1 && m_nRungs < MAX_RUNGS)
+          {
+            SpawnRung (bucket, start, start + rung.width);
+          }
+        else
+          {
+            m_bottom.swap (bucket);
+            std::sort (m_bottom.begin (), m_bottom.end (), Later);
+          }
+      }
+  }
+
+  Bucket m_top;                 //!< events at or after m_topStart
+  std::vector<Rung> m_rungs;    //!< the ladder, finest rung last
+  uint32_t m_nRungs;            //!< rungs in use
+  uint64_t m_topStart;          //!< first timestamp of Top
+  uint64_t m_topMin;            //!< earliest timestamp in Top
+  uint64_t m_topMax;            //!< latest timestamp in Top
+  Bucket m_bottom;              //!< earliest events, latest first
+  uint32_t m_size;              //!< events in the scheduler
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LadderScheduler);
+
+/**
+ * \param name map, heap, list, calendar, priority or ladder
+ * \return the TypeId name of that scheduler
+ */
+inline std::string
+GetSchedulerTypeName (std::string name)
+{
+  if (name == "map")
+    {
+      return "ns3::MapScheduler";
+    }
+  if (name == "heap")
+    {
+      return "ns3::HeapScheduler";
+    }
+  if (name == "list")
+    {
+      return "ns3::ListScheduler";
+    }
+  if (name == "calendar")
+    {
+      return "ns3::CalendarScheduler";
+    }
+  if (name == "priority")
+    {
+      return "ns3::PriorityQueueScheduler";
+    }
+  NS_ABORT_MSG_UNLESS (name == "ladder", "unknown scheduler " << name);
+  return "ns3::LadderScheduler";
+}
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
@@ -68,6 +68,174 @@
 //
 // tcpdump -r taller1-0-0.pcap -nn -tt
 //
+// With many nodes, traceFormat=pcapng captures every device into a single
+// taller1.pcapng instead; pcapSnapLen=64 keeps only the radiotap, 802.11,
+// LLC, IP and UDP headers of each frame:
+//
+// ./waf --run "taller1 --numNodes=1000 --traceFormat=pcapng --pcapSnapLen=64"
+//
+// Formatting and writing those traces inside the event loop is slow; with
+// traceFormat=binary the frames are stored as compact records written by
+// a background thread, optionally compressed, and converted afterwards:
+//
+// ./waf --run "taller1 --traceFormat=binary --traceCompression=zstd"
+// ./waf --run "trace-convert --input=taller1.trb.zst --ascii=taller1.tr --pcap=taller1"
+//
+// With tracing on, the OLSR routing tables are logged as they change, one
+// line per added, changed or removed route, in taller1.routelog;
+// route-replay prints the table of a node at a given time from it.
+// routeTrace=full restores the periodic dumps of every table and
+// neighbor cache:
+//
+// ./waf --run "route-replay --input=taller1.routelog --node=3 --time=12.5"
+// ./waf --run "taller1 --routeTrace=full"
+//
+// FlowMonitor statistics can be followed while the simulation runs: every
+// flowmonInterval seconds the per-flow increments, with the packets
+// received in fixed delay buckets, are appended to taller1-flows.csv.
+// The XML dump at the end of the run can then be skipped, which also
+// keeps the FlowMonitor histograms to a single bin:
+//
+// ./waf --run "taller1 --flowmonInterval=0.5 --flowmonXml=0"
+//
+// On long runs the NetAnim file can be written with bounded memory, with
+// positions sampled periodically and packet records rate limited, or
+// turned off altogether:
+//
+// ./waf --run "taller1 --animation=stream --animPositionPeriod=0.5 --animPacketSampling=10"
+// ./waf --run "taller1 --animation=none"
+//
+// Large fields can use a spatially indexed channel that only delivers a
+// frame to the nodes within reception range of the sender; the
+// validation mode checks every delivery against an unfiltered scan of
+// every node.  The spatial channel is a spectrum channel, so it runs
+// with SpectrumWifiPhy instead of YansWifiPhy, which changes the
+// results by itself; compare it with the stock spectrum channel, which
+// uses the same PHY and delivers every frame to every node:
+//
+// ./waf --run "taller1 --numNodes=500 --channel=spatial"
+// ./waf --run "taller1 --numNodes=500 --channel=spectrum"
+// ./waf --run "taller1 --channel=spatial --channelValidation=1"
+//
+// At high packet rates the allocations made for every packet (the
+// packets, their buffers and tags) can be served from a size-class pool
+// instead of malloc; the pool hit rate is printed at the end of the run,
+// and the benchmark program compares run times with and without it.
+// The pool, and memoryReport below, need the global allocator of
+// pooled-allocator.h, which only a build with POOLED_ALLOCATOR has:
+//
+// CXXFLAGS="-DPOOLED_ALLOCATOR=1" ./waf configure
+// ./waf --run "taller1 --meanPacketsPerSecond=10000 --packetPool=1"
+//
+// benchmarkOutput appends the time spent building the topology, running
+// the simulation and writing the results, the event rate and the peak
+// RSS of the run to a CSV file; the benchmark program runs both
+// scenarios at increasing scales this way:
+//
+// ./waf --run "taller1 --numNodes=1000 --benchmarkOutput=bench.csv"
+//
+// The Friis loss and propagation delay of each link can be cached until
+// either end moves more than linkCacheMovement metres or the cached loss
+// could be 0.1 dB off; hit rates (and, with validation, the largest
+// error of a cached value) are printed at the end of the run.  Each
+// cache keeps the linkCacheLinks most recently used links:
+//
+// ./waf --run "taller1 --linkCache=1 --linkCacheMovement=0.5 --linkCacheValidation=1"
+//
+// Several runs can be swept in parallel over a grid of parameters.  Each
+// axis takes a comma separated list of values or an integer range; every
+// combination runs in its own process, with its own RNG run number and
+// its own output prefix (e.g. taller1-distance250-run3.tr), and the
+// FlowMonitor results of all runs are merged into one table:
+//
+// ./waf --run "taller1 --sweepDistance=125,250,500 --sweepRuns=1:10 --jobs=8"
+//
+// Instead of a fixed number of runs, replications runs every point of
+// the grid with RNG runs 1, 2, ... until the confidence interval of the
+// chosen FlowMonitor totals (see flow-summary.h) is narrower than
+// ciTarget times their mean, or replications runs were made (see
+// replication-controller.h).  Each point is reported with its means,
+// half-widths and number of runs in taller1-replications.csv:
+//
+// ./waf --run "taller1 --sweepDistance=125,250,500 --replications=50 --ciTarget=0.05 --ciMetrics=throughputKbps,meanDelayMs"
+//
+// memoryReport charges every heap block to the component being built
+// (nodes, wifi, mobility, internet, ...) or to the run, and prints the
+// live bytes of each component after the build and at the end, also
+// written to <outputPrefix>-memory.csv (see memory-accounting.h).  It
+// also counts the objects of every node by TypeId and the bytes each
+// node owns, written to <outputPrefix>-census.csv (see
+// memory-census.h).  compact cuts the per-node footprint of large
+// runs: no IPv6 stack, OLSR without list and static routing, no queue
+// discs under the wifi devices, FlowMonitor probes only on the flow
+// endpoints and constant variables shared by all the nodes:
+//
+// ./waf --run "taller1 --numNodes=10000 --compact=1 --memoryReport=1 --tracing=0 --animation=none"
+//
+// Replications that only differ in their traffic can share the topology
+// build and the OLSR convergence: with warmStart, the simulation runs
+// once up to that time, which must be before the OnOff source starts at
+// 2 s, and then forks one process per traffic rate and RNG run, each
+// reseeding the OnOff OffTime stream and running to the end.  Their
+// FlowMonitor results are merged into taller1-warmstart.csv:
+//
+// ./waf --run "taller1 --tracing=0 --animation=none --warmStart=1.9 --warmStartRates=10,50 --warmStartRuns=1:10"
+//
+// To see where the wall time of a run goes, profile attributes it to the
+// source of each event (OLSR timers, PHY reception, OnOff send, trace
+// sinks...), prints the sources ranked by time and writes the folded
+// stacks to taller1.folded for flamegraph.pl; profileSampling times one
+// event in that many:
+//
+// ./waf --run "taller1 --profile=1 --profileSampling=8"
+//
+// The event scheduler can be chosen among the ns-3 ones (map, heap,
+// list, calendar, priority) and a ladder queue suited to the many
+// near-future events of wireless scenarios:
+//
+// ./waf --run "taller1 --numNodes=1000 --scheduler=ladder"
+//
+// The OnOff source logs every packet it sends.  With logMode=async the
+// log lines are recorded in binary form and formatted by a background
+// thread into taller1.log, with their time and node; logMode=none drops
+// them.  Log calls of this program below a level chosen at build time
+// compile away (see async-log.h):
+//
+// ./waf --run "taller1 --logMode=async"
+// CXXFLAGS="-DFAST_LOG_LEVEL=0x2" ./waf configure
+//
+// The mobility trace (taller1.mob) can also be written as binary
+// position records, at every course change or sampled every
+// mobilitySampling seconds, and read back with mobility-reader:
+//
+// ./waf --run "taller1 --mobilityTrace=binary --mobilitySampling=0.5"
+// ./waf --run "mobility-reader --input=taller1.mobr --node=3"
+//
+// With mobilityEngine=soa the positions of all the nodes are kept in one
+// structure-of-arrays table (see soa-mobility.h); the spatial channel
+// then computes the distances to the candidate receivers of a frame in
+// one batch:
+//
+// ./waf --run "taller1 --numNodes=1000 --channel=spatial --mobilityEngine=soa"
+//
+// traffic=burst replaces the OnOff source by one that plans its packet
+// trains and schedules one event per packet instead of several per
+// on/off period, with the same packet times (see
+// burst-onoff-application.h).  trafficValidation runs an OnOff source
+// with the same draws on a node of its own, without devices, and checks
+// that both send at the same times:
+//
+// ./waf --run "taller1 --traffic=burst --onTime=0.01 --trafficValidation=1"
+//
+// trafficMatrix adds many UDP flows to the OnOff one, at the Poisson
+// rate meanPacketsPerSecond (see traffic-matrix.h): "gateway" sends from
+// every node to sinkNode, "random" between matrixFlows random pairs, and
+// any other value is a CSV file of "source,destination[,rate[,size]]"
+// lines.  The packets of every flow are written to
+// <outputPrefix>-matrix.csv:
+//
+// ./waf --run "taller1 --numNodes=400 --trafficMatrix=random --matrixFlows=10000"
+//
 
 #include "ns3/command-line.h"
 #include "ns3/config.h"
@@ -79,11 +247,15 @@
 #include "ns3/mobility-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/yans-wifi-channel.h"
+#include "ns3/spectrum-wifi-helper.h"
+#include "ns3/multi-model-spectrum-channel.h"
+#include "ns3/boolean.h"
 #include "ns3/mobility-model.h"
 #include "ns3/olsr-helper.h"
 #include "ns3/ipv4-static-routing-helper.h"
 #include "ns3/ipv4-list-routing-helper.h"
 #include "ns3/internet-stack-helper.h"
+#include "ns3/traffic-control-helper.h"
 #include "ns3/netanim-module.h"
 #include "ns3/applications-module.h" // On-Off model
 #include "ns3/core-module.h"
@@ -92,6 +264,31 @@
 #include "ns3/random-variable-stream.h"
 #include "ns3/flow-monitor.h"
 #include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/rng-seed-manager.h"
+
+#include "parameter-sweep.h"
+#include "flow-summary.h"
+#include "spatial-index-spectrum-channel.h"
+#include "binary-trace-helper.h"
+#include "pcapng-trace-helper.h"
+#include "streaming-anim-recorder.h"
+#include "flow-snapshot-writer.h"
+#define POOLED_ALLOCATOR_DEFINE_GLOBAL_NEW
+#include "pooled-allocator.h"
+#include "benchmark-report.h"
+#include "route-change-log.h"
+#include "cached-propagation-model.h"
+#include "event-profiler.h"
+#include "ladder-scheduler.h"
+#include "async-log.h"
+#include "mobility-recorder.h"
+#include "soa-mobility.h"
+#include "burst-onoff-application.h"
+#include "traffic-matrix.h"
+#include "replication-controller.h"
+#include "memory-accounting.h"
+#include "memory-census.h"
 
 
 using namespace ns3;
@@ -102,7 +299,28 @@ void ReceivePacket(Ptr<Socket> socket)
 {
   while (socket->Recv())
   {
-    NS_LOG_UNCOND("Received one packet!");
+    if (AsyncLog::Get().IsRunning())
+    {
+      FAST_LOG_INFO("WifiSimpleAdhocGrid", "Received one packet!");
+    }
+    else
+    {
+      NS_LOG_UNCOND("Received one packet!");
+    }
+  }
+}
+
+// Log an OnOff packet as OnOffApplication::SendPacket does, through the
+// asynchronous logger
+static void LogOnOffTx(uint64_t *totalBytes, Ptr<const Packet> packet,
+                       const Address &from, const Address &to)
+{
+  *totalBytes += packet->GetSize();
+  if (InetSocketAddress::IsMatchingType(to))
+  {
+    InetSocketAddress peer = InetSocketAddress::ConvertFrom(to);
+    FAST_LOG_INFO("OnOffApplication", "At time {} on-off application sent {} bytes to {} port {} total Tx {} bytes",
+                  Simulator::Now(), packet->GetSize(), peer.GetIpv4(), peer.GetPort(), *totalBytes);
   }
 }
 
@@ -121,75 +339,226 @@ static void GenerateTraffic(Ptr<Socket> socket, uint32_t pktSize,
   }
 }
 
-int main(int argc, char *argv[])
+// Parameters of one taller1 run; filled from the command line and, in
+// sweep mode, overridden for every point of the parameter grid.
+struct ScenarioConfig
 {
-  LogComponentEnable ( "OnOffApplication" , LOG_LEVEL_INFO) ;
-  // LogComponentEnable ( "UdpApplication" , LOG_LEVEL_INFO) ;
-  std::string phyMode("DsssRate1Mbps");
-  double distance = 125;      // m
-  uint32_t packetSize = 1000; // bytes
-  uint32_t numPackets = 1;
-  uint32_t numNodes = 25; // by default, 5x5
-  uint32_t sinkNode = 0;
-  uint32_t sourceNode = 24;
-  double interval = 1.0; // seconds
-  bool verbose = false;
-  bool tracing = true;
-  double meanPacketsPerSecond = 10; // Poisson arrival rate
-  
+  std::string phyMode;
+  double distance;       // m
+  uint32_t packetSize;   // bytes
+  uint32_t numPackets;
+  uint32_t numNodes;
+  uint32_t sinkNode;
+  uint32_t sourceNode;
+  double interval;       // seconds
+  bool verbose;
+  bool tracing;
+  double meanPacketsPerSecond; // Poisson arrival rate
+  std::string outputPrefix;    // prefix of trace and animation files
+  std::string flowmonFile;     // FlowMonitor XML output
+  std::string channel;         // "yans", "spectrum", or "spatial" for the indexed channel
+  bool channelValidation;      // check the indexed channel against an unfiltered scan
+  bool linkCache;              // cache loss and delay per link
+  double linkCacheMovement;    // m moved by either end that invalidates a link
+  uint32_t linkCacheLinks;     // links kept by each cache
+  bool linkCacheValidation;    // check cached values against exact ones
+  std::string traceFormat;     // "text" (ascii and pcap), "pcapng" or "binary"
+  std::string traceCompression; // binary traces: "none", "gzip" or "zstd"
+  uint32_t pcapSnapLen;        // pcapng: bytes of each 802.11 frame, 0 = all
+  double flowmonInterval;      // seconds between FlowMonitor snapshots, 0 = off
+  bool flowmonXml;             // write the FlowMonitor XML at the end
+  std::string animation;       // "netanim", "stream" or "none"
+  double animPositionPeriod;   // stream: seconds between position samples
+  uint32_t animMaxPacketsPerSecond; // stream: packet records per second
+  uint32_t animPacketSampling; // stream: record one packet in this many
+  bool packetPool;             // serve packet allocations from PooledAllocator
+  std::string benchmarkOutput; // CSV file for the phase timings, "" = none
+  std::string routeTrace;      // "changes" (route log), "full" (table dumps) or "none"
+  double warmStart;            // seconds simulated once before forking, 0 = off
+  std::string warmStartRates;  // warm start: meanPacketsPerSecond of the children
+  std::string warmStartRuns;   // warm start: RNG run numbers of the children
+  std::string warmStartSummary; // warm start: merged FlowMonitor summary file
+  uint32_t jobs;               // concurrent child processes, 0 = one per core
+  bool profile;                // profile the event loop by event source
+  uint32_t profileSampling;    // profile: time one event in this many
+  std::string scheduler;       // event scheduler: map, heap, list, calendar, priority or ladder
+  std::string logMode;         // OnOff packet log: "text" (ns-3 log), "async" or "none"
+  std::string mobilityTrace;   // "ascii" (.mob), "binary" (.mobr) or "none"
+  double mobilitySampling;     // binary mobility trace: seconds between samples, 0 = course changes
+  std::string mobilityEngine;  // "model" (one model per node) or "soa" (shared position table)
+  std::string traffic;         // source: "onoff" (OnOffApplication) or "burst" (BurstOnOffApplication)
+  double onTime;               // seconds of every on period
+  bool trafficValidation;      // check the burst source against an OnOff source
+  std::string trafficMatrix;   // "none", "gateway", "random" or a flow file
+  uint32_t matrixFlows;        // traffic matrix: flows between random pairs
+  bool flowTotals;             // flow summary: one row of totals instead of one per flow
+  bool memoryReport;           // live heap bytes by component
+  bool compact;                // smaller per-node footprint for large runs
+};
 
-  CommandLine cmd(__FILE__);
-  cmd.AddValue("phyMode", "Wifi Phy mode", phyMode);
-  cmd.AddValue("distance", "distance (m)", distance);
-  cmd.AddValue("packetSize", "size of application packet sent", packetSize);
-  cmd.AddValue("numPackets", "number of packets generated", numPackets);
-  cmd.AddValue("interval", "interval (seconds) between packets", interval);
-  cmd.AddValue("verbose", "turn on all WifiNetDevice log components", verbose);
-  cmd.AddValue("tracing", "turn on ascii and pcap tracing", tracing);
-  cmd.AddValue("numNodes", "number of nodes", numNodes);
-  cmd.AddValue("sinkNode", "Receiver node number", sinkNode);
-  cmd.AddValue("sourceNode", "Sender node number", sourceNode);
-  cmd.Parse(argc, argv);
+static const double STOP_TIME = 33.0; // seconds
+// Stream of the OnOff OffTime variable in warm-started children
+static const int64_t TRAFFIC_STREAM = 1;
+
+// What the children of a warm start need from the warmed-up simulation
+struct WarmStartState : public SimpleRefCount<WarmStartState>
+{
+  ScenarioConfig cfg;
+  ParameterSweep sweep;
+  Ptr<RandomVariableStream> offTime;
+  Ptr<FlowMonitor> flowMonitor;
+  Ptr<Ipv4FlowClassifier> classifier;
+};
+
+// Continue a warm-started simulation in a child process, with its own
+// traffic rate and RNG run number for the traffic.
+static void ContinueWarmStart(Ptr<WarmStartState> state, const ParameterSweep::Point &point,
+                              std::ostream &os)
+{
+  ParameterSweep::Point::const_iterator it;
+  if ((it = point.find("meanPacketsPerSecond")) != point.end())
+  {
+    state->offTime->SetAttribute("Mean", DoubleValue(1.0 / std::atof(it->second.c_str())));
+  }
+  if ((it = point.find("run")) != point.end())
+  {
+    RngSeedManager::SetRun(std::atoi(it->second.c_str()));
+  }
+  // A new generator from the current seed and run
+  state->offTime->SetStream(TRAFFIC_STREAM);
+  Simulator::Stop(Seconds(STOP_TIME) - Simulator::Now());
+  Simulator::Run();
+  std::string prefix = state->cfg.outputPrefix + "-" + state->sweep.GetLabel(point);
+  if (state->cfg.flowmonXml)
+  {
+    state->flowMonitor->SerializeToXmlFile(prefix + "-flowmon.xml", true, true);
+  }
+  if (state->cfg.profile)
+  {
+    ProfilingSimulatorImpl::Report(std::cout, prefix + ".folded");
+  }
+  WriteFlowSummary(state->flowMonitor, state->classifier, os);
+}
+
+// Build the topology, run the simulation and write the results.  If
+// flowSummary is not null, one CSV row per flow, or one with the totals
+// of all the flows, is written to it.
+static void RunScenario(const ScenarioConfig &cfg, std::ostream *flowSummary)
+{
+  NS_ABORT_MSG_IF(cfg.sourceNode >= cfg.numNodes || cfg.sinkNode >= cfg.numNodes,
+                  "sourceNode and sinkNode must be lower than numNodes");
+  if (cfg.profile)
+  {
+    // Before anything creates the simulator
+    ProfilingSimulatorImpl::Enable(cfg.profileSampling);
+  }
+  GlobalValue::Bind("SchedulerType", StringValue(GetSchedulerTypeName(cfg.scheduler)));
+  BenchmarkReport benchmark;
   // Convert to time object
-  Time interPacketInterval = Seconds(interval);
+  Time interPacketInterval = Seconds(cfg.interval);
+
+  NS_ABORT_MSG_IF((cfg.packetPool || cfg.memoryReport) && !PooledAllocator::IsInstalled(),
+                  "--packetPool and --memoryReport need a build with CXXFLAGS=\"-DPOOLED_ALLOCATOR=1\"");
+  if (cfg.packetPool)
+  {
+    PooledAllocator::LearnPacketSizes(cfg.packetSize);
+  }
+  PooledAllocator::Enable(cfg.packetPool);
+  MemoryAccounting::Enable(cfg.memoryReport);
+  NS_ABORT_MSG_IF(cfg.compact && cfg.animation == "netanim", "compact needs --animation=stream or none");
 
 
 
   // Fix non-unicast data rate to be the same as that of unicast
   Config::SetDefault("ns3::WifiRemoteStationManager::NonUnicastMode",
-                     StringValue(phyMode));
+                     StringValue(cfg.phyMode));
 
+  MemoryAccounting::Scope memoryScope("nodes");
   NodeContainer c;
-  c.Create(numNodes);
+  c.Create(cfg.numNodes);
 
   // The below set of helpers will help us to put together the wifi NICs we want
+  MemoryAccounting::Charge("wifi");
   WifiHelper wifi;
-  if (verbose)
+  if (cfg.verbose)
   {
     wifi.EnableLogComponents(); // Turn on all Wifi logging
   }
 
-  YansWifiPhyHelper wifiPhy;
+  YansWifiPhyHelper yansPhy;
+  SpectrumWifiPhyHelper spectrumPhy;
+  Ptr<SpatialIndexSpectrumChannel> spatialChannel;
+  NS_ABORT_MSG_UNLESS(cfg.channel == "yans" || cfg.channel == "spectrum" || cfg.channel == "spatial",
+                      "unknown channel " << cfg.channel);
+  WifiPhyHelper &wifiPhy = cfg.channel != "yans" ? static_cast<WifiPhyHelper &>(spectrumPhy)
+                                                 : static_cast<WifiPhyHelper &>(yansPhy);
   // set it to zero; otherwise, gain will be added
   wifiPhy.Set("RxGain", DoubleValue(-10));
   // ns-3 supports RadioTap and Prism tracing extensions for 802.11b
   wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
 
-  YansWifiChannelHelper wifiChannel;
-  wifiChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
-  wifiChannel.AddPropagationLoss("ns3::FriisPropagationLossModel");
-  wifiPhy.SetChannel(wifiChannel.Create());
+  // Friis loss and constant-speed delay, optionally behind per-link caches
+  Ptr<PropagationLossModel> lossModel = CreateObject<FriisPropagationLossModel>();
+  Ptr<PropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel>();
+  Ptr<CachedPropagationLossModel> lossCache;
+  Ptr<CachedPropagationDelayModel> delayCache;
+  if (cfg.linkCache)
+  {
+    lossCache = CreateObject<CachedPropagationLossModel>();
+    lossCache->SetAttribute("Model", PointerValue(lossModel));
+    lossCache->SetAttribute("MaxMovement", DoubleValue(cfg.linkCacheMovement));
+    lossCache->SetAttribute("MaxLinks", UintegerValue(cfg.linkCacheLinks));
+    lossCache->SetAttribute("Validate", BooleanValue(cfg.linkCacheValidation));
+    lossModel = lossCache;
+    delayCache = CreateObject<CachedPropagationDelayModel>();
+    delayCache->SetAttribute("Model", PointerValue(delayModel));
+    delayCache->SetAttribute("MaxMovement", DoubleValue(cfg.linkCacheMovement));
+    delayCache->SetAttribute("MaxLinks", UintegerValue(cfg.linkCacheLinks));
+    delayCache->SetAttribute("Validate", BooleanValue(cfg.linkCacheValidation));
+    delayModel = delayCache;
+  }
+
+  if (cfg.channel == "spatial")
+  {
+    // Only deliver a frame where it can still be received: the PHY sends
+    // at most 16.0206 dBm and drops anything below its -101 dBm RX
+    // sensitivity once the -10 dB RxGain above is applied.
+    spatialChannel = CreateObject<SpatialIndexSpectrumChannel>();
+    spatialChannel->SetAttribute("MaxLossDb", DoubleValue(16.0206 - 10 + 101));
+    spatialChannel->SetAttribute("Validate", BooleanValue(cfg.channelValidation));
+    // Frames the PHY can still receive after its RxGain
+    spatialChannel->SetAttribute("ValidationSensitivityDbm", DoubleValue(-101 + 10));
+    spatialChannel->AddPropagationLossModel(lossModel);
+    spatialChannel->SetPropagationDelayModel(delayModel);
+    spectrumPhy.SetChannel(spatialChannel);
+  }
+  else if (cfg.channel == "spectrum")
+  {
+    // The baseline of the spatial channel: same PHY, every frame to every node
+    Ptr<MultiModelSpectrumChannel> spectrumChannel = CreateObject<MultiModelSpectrumChannel>();
+    spectrumChannel->AddPropagationLossModel(lossModel);
+    spectrumChannel->SetPropagationDelayModel(delayModel);
+    spectrumPhy.SetChannel(spectrumChannel);
+  }
+  else
+  {
+    Ptr<YansWifiChannel> wifiChannel = CreateObject<YansWifiChannel>();
+    wifiChannel->SetPropagationDelayModel(delayModel);
+    wifiChannel->SetPropagationLossModel(lossModel);
+    yansPhy.SetChannel(wifiChannel);
+  }
 
   // Add an upper mac and disable rate control
   WifiMacHelper wifiMac;
   wifi.SetStandard(WIFI_STANDARD_80211b);
   wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                               "DataMode", StringValue(phyMode),
-                               "ControlMode", StringValue(phyMode));
+                               "DataMode", StringValue(cfg.phyMode),
+                               "ControlMode", StringValue(cfg.phyMode));
   // Set it to adhoc mode
   wifiMac.SetType("ns3::AdhocWifiMac");
   NetDeviceContainer devices = wifi.Install(wifiPhy, wifiMac, c);
 
+  MemoryAccounting::Charge("mobility");
   ObjectFactory pos;
   pos.SetTypeId("ns3::RandomRectanglePositionAllocator");
   pos.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=500.0]"));
@@ -197,13 +566,38 @@ int main(int argc, char *argv[])
   Ptr<PositionAllocator> posAlloc = pos.Create()->GetObject<PositionAllocator>();
   MobilityHelper mobility;
   mobility.SetPositionAllocator(posAlloc);
-  mobility.SetMobilityModel("ns3::RandomWaypointMobilityModel", 
-                            "Speed", StringValue ("ns3::UniformRandomVariable[Min=0|Max=1]"),
-                            "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"),
-                            "PositionAllocator", PointerValue(posAlloc));
+  StringValue speed("ns3::UniformRandomVariable[Min=0|Max=1]");
+  StringValue pause("ns3::ConstantRandomVariable[Constant=0.0]");
+  // In compact mode one constant serves every model instead of one each
+  PointerValue sharedPause(CreateObject<ConstantRandomVariable>());
+  const AttributeValue &pauseValue = cfg.compact ? static_cast<const AttributeValue &>(sharedPause)
+                                                 : static_cast<const AttributeValue &>(pause);
+  Ptr<PositionTable> positions;
+  if (cfg.mobilityEngine == "soa")
+  {
+    // The waypoint models drive the views of one position table
+    ObjectFactory waypoint;
+    waypoint.SetTypeId("ns3::RandomWaypointMobilityModel");
+    waypoint.Set("Speed", speed);
+    waypoint.Set("Pause", pauseValue);
+    waypoint.Set("PositionAllocator", PointerValue(posAlloc));
+    positions = CreateObject<PositionTable>();
+    mobility.SetMobilityModel("ns3::SoaMobilityModel",
+                              "Table", PointerValue(positions),
+                              "Driver", ObjectFactoryValue(waypoint));
+  }
+  else
+  {
+    NS_ABORT_MSG_UNLESS(cfg.mobilityEngine == "model", "unknown mobilityEngine " << cfg.mobilityEngine);
+    mobility.SetMobilityModel("ns3::RandomWaypointMobilityModel", 
+                              "Speed", speed,
+                              "Pause", pauseValue,
+                              "PositionAllocator", PointerValue(posAlloc));
+  }
   mobility.Install(c);
 
   // Enable OLSR
+  MemoryAccounting::Charge("internet");
   OlsrHelper olsr;
   Ipv4StaticRoutingHelper staticRouting;
 
@@ -212,25 +606,48 @@ int main(int argc, char *argv[])
   list.Add(olsr, 10);
 
   InternetStackHelper internet;
-  internet.SetRoutingHelper(list); // has effect on the next Install ()
+  if (cfg.compact)
+  {
+    // OLSR delivers local packets itself; nothing here uses IPv6
+    internet.SetRoutingHelper(olsr);
+    internet.SetIpv6StackInstall(false);
+  }
+  else
+  {
+    internet.SetRoutingHelper(list); // has effect on the next Install ()
+  }
   internet.Install(c);
 
+  MemoryAccounting::Charge("addresses");
   Ipv4AddressHelper ipv4;
   NS_LOG_INFO("Assign IP Addresses.");
   ipv4.SetBase("10.1.1.0", "255.255.255.0");
   Ipv4InterfaceContainer i = ipv4.Assign(devices);
+  if (cfg.compact)
+  {
+    // The wifi MAC queues suffice; drop the queue discs Assign installed
+    TrafficControlHelper trafficControl;
+    trafficControl.Uninstall(devices);
+  }
+
+  MemoryAccounting::Charge("applications");
 
   std::string socketType = "ns3::UdpSocketFactory";
   TypeId tid = TypeId::LookupByName(socketType);
   
   Ptr<RandomVariableStream> interPacketIntervalStream = CreateObject<ExponentialRandomVariable>();
-  interPacketIntervalStream->SetAttribute("Mean", DoubleValue(1.0 / meanPacketsPerSecond));
+  interPacketIntervalStream->SetAttribute("Mean", DoubleValue(1.0 / cfg.meanPacketsPerSecond));
   // Ptr<Socket> recvSink = Socket::CreateSocket(c.Get(sinkNode), tid);
-  OnOffHelper onoff (socketType, Ipv4Address::GetAny ());
-  onoff.SetAttribute("OnTime", PointerValue(CreateObject<ConstantRandomVariable>()));
-  onoff.SetAttribute("OffTime", PointerValue(interPacketIntervalStream));
-  onoff.SetAttribute ("PacketSize", UintegerValue (packetSize));
-  onoff.SetAttribute ("DataRate", StringValue ("50Mbps")); //bit/s
+  Ptr<ConstantRandomVariable> onTime = CreateObject<ConstantRandomVariable>();
+  onTime->SetAttribute("Constant", DoubleValue(cfg.onTime));
+  NS_ABORT_MSG_UNLESS(cfg.traffic == "onoff" || cfg.traffic == "burst", "unknown traffic " << cfg.traffic);
+  ObjectFactory onoff;
+  onoff.SetTypeId(cfg.traffic == "burst" ? "ns3::BurstOnOffApplication" : "ns3::OnOffApplication");
+  onoff.Set("Protocol", TypeIdValue(tid));
+  onoff.Set("OnTime", PointerValue(onTime));
+  onoff.Set("OffTime", PointerValue(interPacketIntervalStream));
+  onoff.Set ("PacketSize", UintegerValue (cfg.packetSize));
+  onoff.Set ("DataRate", StringValue ("50Mbps")); //bit/s
 
   InetSocketAddress rmt (InetSocketAddress(Ipv4Address::GetAny(), 80));
   AddressValue remoteAddress (rmt);
@@ -242,47 +659,557 @@ int main(int argc, char *argv[])
 
 
   ApplicationContainer apps;
-  onoff.SetAttribute ("Remote", remoteAddress);
-  apps.Add(onoff.Install(c.Get(sourceNode)));
+  onoff.Set ("Remote", remoteAddress);
+  Ptr<Application> source = onoff.Create<Application>();
+  c.Get(cfg.sourceNode)->AddApplication(source);
+  apps.Add(source);
   apps.Start (Seconds (2.0));
   apps.Stop (Seconds (10));
+  Ptr<BurstOnOffApplication> burstSource = DynamicCast<BurstOnOffApplication>(source);
+  if (cfg.trafficValidation)
+  {
+    // The reference draws the same off times from its own variable and
+    // sends into a packet socket of a node without devices
+    NS_ABORT_MSG_UNLESS(burstSource != 0 && cfg.warmStart == 0,
+                        "trafficValidation needs --traffic=burst and no warm start");
+    Ptr<RandomVariableStream> referenceOffTime = CreateObject<ExponentialRandomVariable>();
+    referenceOffTime->SetAttribute("Mean", DoubleValue(1.0 / cfg.meanPacketsPerSecond));
+    referenceOffTime->SetStream(TRAFFIC_STREAM);
+    interPacketIntervalStream->SetStream(TRAFFIC_STREAM);
+    Ptr<Node> referenceNode = CreateObject<Node>();
+    PacketSocketHelper packetSocket;
+    packetSocket.Install(referenceNode);
+    PacketSocketAddress nowhere;
+    nowhere.SetAllDevices();
+    nowhere.SetProtocol(0);
+    onoff.SetTypeId("ns3::OnOffApplication");
+    onoff.Set("Protocol", TypeIdValue(PacketSocketFactory::GetTypeId()));
+    onoff.Set("OffTime", PointerValue(referenceOffTime));
+    onoff.Set("Remote", AddressValue(nowhere));
+    Ptr<Application> reference = onoff.Create<Application>();
+    referenceNode->AddApplication(reference);
+    reference->SetStartTime(Seconds(2.0));
+    reference->SetStopTime(Seconds(10));
+    burstSource->SetReference(reference);
+  }
+  TrafficMatrixHelper matrixHelper;
+  if (cfg.trafficMatrix != "none")
+  {
+    TrafficMatrix matrix;
+    if (cfg.trafficMatrix == "gateway")
+    {
+      matrix.AddAllToOne(cfg.numNodes, cfg.sinkNode, cfg.meanPacketsPerSecond, cfg.packetSize);
+    }
+    else if (cfg.trafficMatrix == "random")
+    {
+      matrix.AddRandomPairs(cfg.numNodes, cfg.matrixFlows, cfg.meanPacketsPerSecond, cfg.packetSize,
+                            CreateObject<UniformRandomVariable>());
+    }
+    else
+    {
+      matrix.Load(cfg.trafficMatrix, cfg.meanPacketsPerSecond, cfg.packetSize);
+    }
+    matrixHelper.Install(matrix, c, Seconds(2.0), Seconds(10));
+  }
+  uint64_t onoffTxBytes = 0;
+  if (cfg.logMode == "async" || (cfg.logMode == "text" && burstSource != 0))
+  {
+    // The burst source has no ns-3 log; in text mode its lines are
+    // formatted at once by the logger, which is not started
+    if (cfg.logMode == "async")
+    {
+      AsyncLog::Get().Start(cfg.outputPrefix + ".log");
+    }
+    for (ApplicationContainer::Iterator a = apps.Begin(); a != apps.End(); ++a)
+    {
+      (*a)->TraceConnectWithoutContext("TxWithAddresses", MakeBoundCallback(&LogOnOffTx, &onoffTxBytes));
+    }
+  }
 
-  if (tracing == true)
+  MemoryAccounting::Charge("traces");
+  BinaryTraceHelper binaryTrace;
+  MobilityRecorder mobilityRecorder;
+  RouteChangeLog routeLog;
+  PcapngTraceHelper pcapng;
+  if (cfg.tracing == true)
   {
     AsciiTraceHelper ascii;
-    wifiPhy.EnableAsciiAll(ascii.CreateFileStream("taller1.tr"));
-    wifiPhy.EnablePcap("taller1", devices);
+    if (cfg.traceFormat == "binary")
+    {
+      // Frames go to one record file written off-thread; trace-convert
+      // turns it back into the .tr and .pcap files below.
+      binaryTrace.SetCompression(cfg.traceCompression);
+      binaryTrace.EnableAll(cfg.outputPrefix, devices);
+    }
+    else if (cfg.traceFormat == "pcapng")
+    {
+      // One capture file for every device instead of one pcap each
+      wifiPhy.EnableAsciiAll(ascii.CreateFileStream(cfg.outputPrefix + ".tr"));
+      pcapng.SetSnapLen(cfg.pcapSnapLen);
+      pcapng.EnableAll(cfg.outputPrefix + ".pcapng", devices);
+    }
+    else
+    {
+      wifiPhy.EnableAsciiAll(ascii.CreateFileStream(cfg.outputPrefix + ".tr"));
+      wifiPhy.EnablePcap(cfg.outputPrefix, devices);
+    }
     // Trace routing tables
-    Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper>("taller1.routes", std::ios::out);
-    olsr.PrintRoutingTableAllEvery(Seconds(2), routingStream);
-    Ptr<OutputStreamWrapper> neighborStream = Create<OutputStreamWrapper>("taller1.neighbors", std::ios::out);
-    olsr.PrintNeighborCacheAllEvery(Seconds(2), neighborStream);
+    if (cfg.routeTrace == "full")
+    {
+      Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper>(cfg.outputPrefix + ".routes", std::ios::out);
+      olsr.PrintRoutingTableAllEvery(Seconds(2), routingStream);
+      Ptr<OutputStreamWrapper> neighborStream = Create<OutputStreamWrapper>(cfg.outputPrefix + ".neighbors", std::ios::out);
+      olsr.PrintNeighborCacheAllEvery(Seconds(2), neighborStream);
+    }
+    else if (cfg.routeTrace == "changes")
+    {
+      routeLog.Install(cfg.outputPrefix + ".routelog", c);
+    }
 
-    MobilityHelper::EnableAsciiAll (ascii.CreateFileStream ("taller1.mob"));
+    if (cfg.mobilityTrace == "ascii")
+    {
+      MobilityHelper::EnableAsciiAll (ascii.CreateFileStream (cfg.outputPrefix + ".mob"));
+    }
+    else if (cfg.mobilityTrace == "binary")
+    {
+      std::string filename = cfg.outputPrefix + ".mobr";
+      if (cfg.traceCompression != "none")
+      {
+        filename += cfg.traceCompression == "gzip" ? ".gz" : ".zst";
+      }
+      mobilityRecorder.SetCompression(cfg.traceCompression);
+      mobilityRecorder.SetSamplingPeriod(Seconds(cfg.mobilitySampling));
+      mobilityRecorder.Install(filename, c);
+    }
 
     // To do-- enable an IP-level trace that shows forwarding events only
   }
+  MemoryAccounting::Charge("flowmon");
   Ptr<FlowMonitor> flowMonitor;
   FlowMonitorHelper flowHelper;
-  flowMonitor = flowHelper.InstallAll();
+  NodeContainer monitored;
+  if (cfg.flowmonInterval > 0 && !cfg.flowmonXml)
+  {
+    FlowSnapshotWriter::CoarsenHistograms(flowHelper);
+  }
+  if (cfg.compact && cfg.trafficMatrix == "none")
+  {
+    // The end-to-end statistics only need probes where flows start and end
+    NodeContainer endpoints(c.Get(cfg.sourceNode));
+    if (cfg.sinkNode != cfg.sourceNode)
+    {
+      endpoints.Add(c.Get(cfg.sinkNode));
+    }
+    if (cfg.sourceNode != 1 && cfg.sinkNode != 1)
+    {
+      endpoints.Add(c.Get(1)); // the TCP packet sink
+    }
+    monitored = endpoints;
+  }
+  else
+  {
+    monitored = NodeContainer::GetGlobal();
+  }
+  flowMonitor = flowHelper.Install(monitored);
+  FlowSnapshotWriter flowSnapshots;
+  if (cfg.flowmonInterval > 0)
+  {
+    flowSnapshots.Start(flowMonitor, DynamicCast<Ipv4FlowClassifier>(flowHelper.GetClassifier()), monitored,
+                        cfg.outputPrefix + "-flows.csv", Seconds(cfg.flowmonInterval));
+  }
 
   // Output what we are doing
-  NS_LOG_UNCOND("Testing from node " << sourceNode << " to " << sinkNode << " with grid distance " << distance);
+  NS_LOG_UNCOND("Testing from node " << cfg.sourceNode << " to " << cfg.sinkNode << " with grid distance " << cfg.distance);
 
   // Netamin
-  AnimationInterface anim("taller1.xml");
-
-  for (size_t i = 0; i < c.GetN(); i++)
+  MemoryAccounting::Charge("animation");
+  AnimationInterface *anim = 0;
+  StreamingAnimRecorder animRecorder;
+  if (cfg.animation == "netanim")
+  {
+    anim = new AnimationInterface(cfg.outputPrefix + ".xml");
+    for (size_t i = 0; i < c.GetN(); i++)
+    {
+      int col = i % 5, row = i / 5;
+      anim->SetConstantPosition(c.Get(i), cfg.distance * col, cfg.distance * row);
+    }
+  }
+  else if (cfg.animation == "stream")
   {
-    int col = i % 5, row = i / 5;
-    anim.SetConstantPosition(c.Get(i), distance * col, distance * row);
+    // Sampled positions of the actual RandomWaypoint mobility
+    animRecorder.SetPositionPeriod(Seconds(cfg.animPositionPeriod));
+    animRecorder.SetMaxPacketsPerSecond(cfg.animMaxPacketsPerSecond);
+    animRecorder.SetPacketSampling(cfg.animPacketSampling);
+    animRecorder.Install(cfg.outputPrefix + ".xml", c);
   }
 
 
-  Simulator::Stop(Seconds(33.0));
+  if (cfg.warmStart > 0)
+  {
+    // Simulate the OLSR convergence once, then fork one child per
+    // traffic rate and run from this state
+    NS_ABORT_MSG_IF(cfg.tracing || cfg.animation != "none" || cfg.flowmonInterval > 0 || cfg.logMode == "async",
+                    "warm start needs --tracing=0 --animation=none --flowmonInterval=0 and no async log");
+    // The children only reseed the traffic, which must not have started
+    NS_ABORT_MSG_IF(cfg.warmStart >= 2.0, "warm start must end before the OnOff source starts at 2 s");
+    Simulator::Stop(Seconds(cfg.warmStart));
+    Simulator::Run();
+    Ptr<WarmStartState> state = Create<WarmStartState>();
+    state->cfg = cfg;
+    state->offTime = interPacketIntervalStream;
+    state->flowMonitor = flowMonitor;
+    state->classifier = DynamicCast<Ipv4FlowClassifier>(flowHelper.GetClassifier());
+    state->sweep.AddAxis("meanPacketsPerSecond", cfg.warmStartRates);
+    state->sweep.AddAxis("run", cfg.warmStartRuns);
+    NS_ABORT_MSG_UNLESS(state->sweep.IsEnabled(), "warm start needs --warmStartRates or --warmStartRuns");
+    state->sweep.SetJobs(cfg.jobs);
+    state->sweep.SetSummaryFile(cfg.warmStartSummary);
+    state->sweep.SetColumns(FLOW_SUMMARY_COLUMNS);
+    uint32_t failed = state->sweep.Run(MakeBoundCallback(&ContinueWarmStart, state));
+    Simulator::Destroy();
+    NS_ABORT_MSG_IF(failed > 0, failed << " warm-started runs failed");
+    return;
+  }
+
+  std::ofstream memoryReport;
+  std::ofstream censusReport;
+  MemoryCensus census;
+  if (cfg.memoryReport)
+  {
+    MemoryAccounting::PrintReport(std::cout, "after build");
+    memoryReport.open((cfg.outputPrefix + "-memory.csv").c_str());
+    memoryReport << MEMORY_REPORT_COLUMNS << std::endl;
+    MemoryAccounting::WriteReport(memoryReport, "build");
+    census.Take(c);
+    census.Print(std::cout, "after build");
+    censusReport.open((cfg.outputPrefix + "-census.csv").c_str());
+    censusReport << MEMORY_CENSUS_COLUMNS << std::endl;
+    census.Write(censusReport, "build");
+  }
+  MemoryAccounting::Charge("run");
+  Simulator::Stop(Seconds(STOP_TIME));
+  benchmark.Begin(BenchmarkReport::RUN);
   Simulator::Run();
-  flowMonitor->SerializeToXmlFile("third.xml", true, true);
+  benchmark.Begin(BenchmarkReport::OUTPUT);
+  if (cfg.memoryReport)
+  {
+    MemoryAccounting::PrintReport(std::cout, "end of run");
+    MemoryAccounting::WriteReport(memoryReport, "run");
+    census.Take(c);
+    census.Print(std::cout, "end of run");
+    census.Write(censusReport, "run");
+  }
+  MemoryAccounting::Charge("output");
+  binaryTrace.Close();
+  mobilityRecorder.Close();
+  pcapng.Close();
+  animRecorder.Close();
+  routeLog.Close();
+  flowSnapshots.Stop();
+  if (AsyncLog::Get().IsRunning())
+  {
+    AsyncLog::Get().Stop();
+    AsyncLog::Get().PrintStats(std::cout);
+  }
+  if (cfg.flowmonXml)
+  {
+    flowMonitor->SerializeToXmlFile(cfg.flowmonFile, true, true);
+  }
+  if (spatialChannel != 0)
+  {
+    spatialChannel->PrintStats(std::cout);
+    NS_ABORT_MSG_IF(spatialChannel->GetMismatches() > 0,
+                    "spatial channel missed receivers of the unfiltered scan");
+  }
+  if (lossCache != 0)
+  {
+    lossCache->PrintStats(std::cout);
+    delayCache->PrintStats(std::cout);
+  }
+  if (positions != 0)
+  {
+    positions->PrintStats(std::cout);
+  }
+  if (burstSource != 0)
+  {
+    burstSource->PrintStats(std::cout);
+    NS_ABORT_MSG_IF(burstSource->GetMismatches() > 0,
+                    "burst source sent at different times than the OnOff reference");
+  }
+  if (cfg.trafficMatrix != "none")
+  {
+    matrixHelper.PrintStats(std::cout);
+    std::ofstream matrixSummary((cfg.outputPrefix + "-matrix.csv").c_str());
+    matrixHelper.WriteSummary(matrixSummary);
+  }
+  if (flowSummary != 0)
+  {
+    if (cfg.flowTotals)
+    {
+      WriteFlowTotals(flowMonitor, *flowSummary);
+    }
+    else
+    {
+      WriteFlowSummary(flowMonitor, DynamicCast<Ipv4FlowClassifier>(flowHelper.GetClassifier()), *flowSummary);
+    }
+  }
+  if (cfg.packetPool)
+  {
+    PooledAllocator::PrintStats(std::cout);
+  }
+  if (cfg.profile)
+  {
+    ProfilingSimulatorImpl::Report(std::cout, cfg.outputPrefix + ".folded");
+  }
   Simulator::Destroy();
+  delete anim;
+  std::ostringstream parameters;
+  parameters << "numNodes=" << cfg.numNodes;
+  if (cfg.scheduler != "map")
+  {
+    parameters << ";scheduler=" << cfg.scheduler;
+  }
+  if (cfg.channel != "yans")
+  {
+    parameters << ";channel=" << cfg.channel;
+  }
+  if (cfg.mobilityEngine != "model")
+  {
+    parameters << ";mobility=" << cfg.mobilityEngine;
+  }
+  if (cfg.traffic != "onoff")
+  {
+    parameters << ";traffic=" << cfg.traffic;
+  }
+  if (cfg.trafficMatrix != "none")
+  {
+    parameters << ";matrix=" << cfg.trafficMatrix << ";flows=" << cfg.matrixFlows;
+  }
+  if (cfg.compact)
+  {
+    parameters << ";compact=1";
+  }
+  if (cfg.packetPool)
+  {
+    parameters << ";packetPool=1";
+  }
+  if (cfg.profile)
+  {
+    parameters << ";profile=" << cfg.profileSampling;
+  }
+  benchmark.Write(cfg.benchmarkOutput, "taller1", parameters.str());
+}
+
+// Set the swept parameters and the RNG run number of a point, and the
+// output file prefix from its label.
+static void ApplySweepPoint(ScenarioConfig &cfg, const ParameterSweep::Point &point, std::string label)
+{
+  ParameterSweep::Point::const_iterator it;
+  if ((it = point.find("distance")) != point.end())
+  {
+    cfg.distance = std::atof(it->second.c_str());
+  }
+  if ((it = point.find("numNodes")) != point.end())
+  {
+    cfg.numNodes = std::atoi(it->second.c_str());
+  }
+  if ((it = point.find("packetSize")) != point.end())
+  {
+    cfg.packetSize = std::atoi(it->second.c_str());
+  }
+  if ((it = point.find("run")) != point.end())
+  {
+    RngSeedManager::SetRun(std::atoi(it->second.c_str()));
+  }
+  cfg.outputPrefix = cfg.outputPrefix + "-" + label;
+  cfg.flowmonFile = cfg.outputPrefix + "-flowmon.xml";
+}
+
+// Run one point of a parameter sweep in a worker process.  Every run
+// gets its own RNG run number and its own output file prefix.
+static void RunSweepPoint(ScenarioConfig cfg, ParameterSweep *sweep,
+                          const ParameterSweep::Point &point, std::ostream &os)
+{
+  ApplySweepPoint(cfg, point, sweep->GetLabel(point));
+  RunScenario(cfg, &os);
+}
+
+// Run one replication of a point in a worker process, writing the
+// totals of its flows.
+static void RunReplication(ScenarioConfig cfg, ReplicationController *controller,
+                           const ParameterSweep::Point &point, std::ostream &os)
+{
+  ApplySweepPoint(cfg, point, controller->GetLabel(point));
+  cfg.flowTotals = true;
+  RunScenario(cfg, &os);
+}
+
+int main(int argc, char *argv[])
+{
+  // LogComponentEnable ( "UdpApplication" , LOG_LEVEL_INFO) ;
+  ScenarioConfig cfg;
+  cfg.phyMode = "DsssRate1Mbps";
+  cfg.distance = 125;      // m
+  cfg.packetSize = 1000; // bytes
+  cfg.numPackets = 1;
+  cfg.numNodes = 25; // by default, 5x5
+  cfg.sinkNode = 0;
+  cfg.sourceNode = 24;
+  cfg.interval = 1.0; // seconds
+  cfg.verbose = false;
+  cfg.tracing = true;
+  cfg.meanPacketsPerSecond = 10; // Poisson arrival rate
+  cfg.outputPrefix = "taller1";
+  cfg.flowmonFile = "third.xml";
+  cfg.channel = "yans";
+  cfg.channelValidation = false;
+  cfg.linkCache = false;
+  cfg.linkCacheMovement = 1.0;
+  cfg.linkCacheLinks = 1 << 18;
+  cfg.linkCacheValidation = false;
+  cfg.traceFormat = "text";
+  cfg.traceCompression = "none";
+  cfg.pcapSnapLen = 0;
+  cfg.flowmonInterval = 0;
+  cfg.flowmonXml = true;
+  cfg.animation = "netanim";
+  cfg.animPositionPeriod = 1.0;
+  cfg.animMaxPacketsPerSecond = 1000;
+  cfg.animPacketSampling = 1;
+  cfg.packetPool = false;
+  cfg.benchmarkOutput = "";
+  cfg.routeTrace = "changes";
+  cfg.warmStart = 0;
+  cfg.warmStartRates = "";
+  cfg.warmStartRuns = "";
+  cfg.warmStartSummary = "taller1-warmstart.csv";
+  cfg.jobs = 0;
+  cfg.profile = false;
+  cfg.profileSampling = 1;
+  cfg.scheduler = "map";
+  cfg.logMode = "text";
+  cfg.mobilityTrace = "ascii";
+  cfg.mobilitySampling = 0;
+  cfg.mobilityEngine = "model";
+  cfg.traffic = "onoff";
+  cfg.onTime = 0;
+  cfg.trafficValidation = false;
+  cfg.trafficMatrix = "none";
+  cfg.matrixFlows = 100;
+  cfg.flowTotals = false;
+  cfg.memoryReport = false;
+  cfg.compact = false;
+
+  // Sweep mode: comma separated values (or lo:hi ranges) for each axis
+  std::string sweepDistance;
+  std::string sweepNumNodes;
+  std::string sweepPacketSize;
+  std::string sweepRuns;
+  std::string sweepSummary = "taller1-sweep.csv";
+
+  // Replication mode: runs of every point until the intervals are narrow
+  uint32_t replications = 0;
+  uint32_t minReplications = 3;
+  double ciLevel = 0.95;
+  double ciTarget = 0.05;
+  std::string ciMetrics = "throughputKbps,meanDelayMs";
+  std::string replicationSummary = "taller1-replications.csv";
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("phyMode", "Wifi Phy mode", cfg.phyMode);
+  cmd.AddValue("distance", "distance (m)", cfg.distance);
+  cmd.AddValue("packetSize", "size of application packet sent", cfg.packetSize);
+  cmd.AddValue("numPackets", "number of packets generated", cfg.numPackets);
+  cmd.AddValue("interval", "interval (seconds) between packets", cfg.interval);
+  cmd.AddValue("verbose", "turn on all WifiNetDevice log components", cfg.verbose);
+  cmd.AddValue("tracing", "turn on ascii and pcap tracing", cfg.tracing);
+  cmd.AddValue("numNodes", "number of nodes", cfg.numNodes);
+  cmd.AddValue("sinkNode", "Receiver node number", cfg.sinkNode);
+  cmd.AddValue("sourceNode", "Sender node number", cfg.sourceNode);
+  cmd.AddValue("channel", "wifi channel: yans, spectrum (SpectrumWifiPhy, baseline of spatial), or spatial "
+               "(spatially indexed; also switches to SpectrumWifiPhy, which changes results versus yans)", cfg.channel);
+  cmd.AddValue("channelValidation", "check that the spatial channel delivers every frame an unfiltered scan would",
+               cfg.channelValidation);
+  cmd.AddValue("linkCache", "cache the propagation loss and delay of every link", cfg.linkCache);
+  cmd.AddValue("linkCacheMovement", "link cache: movement (m) of either end that invalidates a link", cfg.linkCacheMovement);
+  cmd.AddValue("linkCacheLinks", "link cache: links kept by each cache, least recently used dropped first", cfg.linkCacheLinks);
+  cmd.AddValue("linkCacheValidation", "link cache: check every cached value against the exact one", cfg.linkCacheValidation);
+  cmd.AddValue("traceFormat", "text (ascii and pcap), pcapng (one capture file) or binary records", cfg.traceFormat);
+  cmd.AddValue("pcapSnapLen", "pcapng: bytes kept of each 802.11 frame (0 = all, 64 = headers)", cfg.pcapSnapLen);
+  cmd.AddValue("traceCompression", "binary traces: none, gzip or zstd", cfg.traceCompression);
+  cmd.AddValue("routeTrace", "routing traces: changes (event log), full (dumps every 2 s) or none", cfg.routeTrace);
+  cmd.AddValue("flowmonInterval", "seconds between FlowMonitor snapshots (0 = none)", cfg.flowmonInterval);
+  cmd.AddValue("flowmonXml", "write the FlowMonitor XML file at the end of the run", cfg.flowmonXml);
+  cmd.AddValue("animation", "NetAnim output: netanim, stream (bounded memory) or none", cfg.animation);
+  cmd.AddValue("animPositionPeriod", "stream animation: seconds between position samples", cfg.animPositionPeriod);
+  cmd.AddValue("animMaxPacketsPerSecond", "stream animation: packet records per simulated second", cfg.animMaxPacketsPerSecond);
+  cmd.AddValue("animPacketSampling", "stream animation: record one packet in this many", cfg.animPacketSampling);
+  cmd.AddValue("meanPacketsPerSecond", "mean OnOff packet rate (Poisson arrivals)", cfg.meanPacketsPerSecond);
+  cmd.AddValue("packetPool", "serve the packet-sized allocations from a size-class pool", cfg.packetPool);
+  cmd.AddValue("benchmarkOutput", "CSV file to append phase timings and peak RSS to", cfg.benchmarkOutput);
+  cmd.AddValue("outputPrefix", "prefix of the trace and animation files", cfg.outputPrefix);
+  cmd.AddValue("sweepDistance", "sweep: distance values, e.g. 125,250,500", sweepDistance);
+  cmd.AddValue("sweepNumNodes", "sweep: numNodes values", sweepNumNodes);
+  cmd.AddValue("sweepPacketSize", "sweep: packetSize values", sweepPacketSize);
+  cmd.AddValue("sweepRuns", "sweep: RNG run numbers, e.g. 1:10", sweepRuns);
+  cmd.AddValue("sweepSummary", "sweep: merged FlowMonitor summary file", sweepSummary);
+  cmd.AddValue("replications", "maximum runs of every sweep point, stopping early on ciTarget (0 = off)", replications);
+  cmd.AddValue("minReplications", "replications: runs of every point before it may stop", minReplications);
+  cmd.AddValue("ciLevel", "replications: confidence level of the intervals", ciLevel);
+  cmd.AddValue("ciTarget", "replications: interval half-width, as a fraction of the mean, to stop at", ciTarget);
+  cmd.AddValue("ciMetrics", "replications: FlowMonitor totals whose intervals are tracked", ciMetrics);
+  cmd.AddValue("replicationSummary", "replications: one row per sweep point", replicationSummary);
+  cmd.AddValue("warmStart", "seconds simulated once before forking the warm-started runs (0 = off)", cfg.warmStart);
+  cmd.AddValue("warmStartRates", "warm start: meanPacketsPerSecond values, e.g. 10,50,100", cfg.warmStartRates);
+  cmd.AddValue("warmStartRuns", "warm start: RNG run numbers of the traffic, e.g. 1:10", cfg.warmStartRuns);
+  cmd.AddValue("warmStartSummary", "warm start: merged FlowMonitor summary file", cfg.warmStartSummary);
+  cmd.AddValue("jobs", "sweep, replications and warm start: concurrent runs (0 = one per core)", cfg.jobs);
+  cmd.AddValue("profile", "print the wall time by event source and write <outputPrefix>.folded", cfg.profile);
+  cmd.AddValue("profileSampling", "profile: time one event in this many", cfg.profileSampling);
+  cmd.AddValue("scheduler", "event scheduler: map, heap, list, calendar, priority or ladder", cfg.scheduler);
+  cmd.AddValue("logMode", "OnOff packet log: text (ns-3 log), async (background thread) or none", cfg.logMode);
+  cmd.AddValue("mobilityTrace", "mobility trace: ascii, binary (position records) or none", cfg.mobilityTrace);
+  cmd.AddValue("mobilitySampling", "binary mobility trace: seconds between samples (0 = every course change)", cfg.mobilitySampling);
+  cmd.AddValue("mobilityEngine", "positions: model (per node) or soa (shared structure-of-arrays table)", cfg.mobilityEngine);
+  cmd.AddValue("traffic", "traffic source: onoff, or burst (one event per packet)", cfg.traffic);
+  cmd.AddValue("onTime", "seconds of every on period of the traffic source", cfg.onTime);
+  cmd.AddValue("trafficValidation", "check the burst source against an OnOff source with the same draws", cfg.trafficValidation);
+  cmd.AddValue("trafficMatrix", "extra UDP flows: none, gateway (all to sinkNode), random, or a flow file", cfg.trafficMatrix);
+  cmd.AddValue("matrixFlows", "random traffic matrix: number of flows", cfg.matrixFlows);
+  cmd.AddValue("memoryReport", "print the live heap bytes by component and by object type, written to <outputPrefix>-memory.csv and -census.csv", cfg.memoryReport);
+  cmd.AddValue("compact", "smaller per-node footprint: no IPv6, OLSR alone, no queue discs, FlowMonitor on endpoints", cfg.compact);
+  cmd.Parse(argc, argv);
+  if (cfg.logMode == "text")
+  {
+    LogComponentEnable("OnOffApplication", LOG_LEVEL_INFO);
+  }
+
+  ParameterSweep sweep;
+  sweep.AddAxis("distance", sweepDistance);
+  sweep.AddAxis("numNodes", sweepNumNodes);
+  sweep.AddAxis("packetSize", sweepPacketSize);
+  if (replications > 0)
+  {
+    NS_ABORT_MSG_UNLESS(sweepRuns.empty() && cfg.warmStart == 0,
+                        "replications choose the RNG runs: no --sweepRuns nor --warmStart");
+    ReplicationController controller(sweep);
+    controller.SetJobs(cfg.jobs);
+    controller.SetRuns(minReplications, replications);
+    controller.SetTarget(ciLevel, ciTarget, true);
+    controller.SetColumns(FLOW_TOTALS_COLUMNS);
+    controller.SetMetrics(ciMetrics);
+    controller.SetSummaryFile(replicationSummary);
+    return controller.Run(MakeBoundCallback(&RunReplication, cfg, &controller)) == 0 ? 0 : 1;
+  }
+  sweep.AddAxis("run", sweepRuns);
+  if (!sweep.IsEnabled())
+  {
+    RunScenario(cfg, 0);
+    return 0;
+  }
 
-  return 0;
+  sweep.SetJobs(cfg.jobs);
+  sweep.SetSummaryFile(sweepSummary);
+  sweep.SetColumns(FLOW_SUMMARY_COLUMNS);
+  return sweep.Run(MakeBoundCallback(&RunSweepPoint, cfg, &sweep)) == 0 ? 0 : 1;
 }
@@ -8,10 +8,29 @@
 #include "ns3/on-off-helper.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/qos-txop.h"
+#include "ns3/packet-sink.h"
 #include "ns3/packet-sink-helper.h"
 #include "ns3/olsr-helper.h"
 #include "ns3/csma-helper.h"
 #include "ns3/animation-interface.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/global-value.h"
+#include "ns3/flow-monitor-helper.h"
+
+#include "streaming-anim-recorder.h"
+#define POOLED_ALLOCATOR_DEFINE_GLOBAL_NEW
+#include "pooled-allocator.h"
+#include "benchmark-report.h"
+#include "parameter-sweep.h"
+#include "topology-builder.h"
+#include "event-profiler.h"
+#include "ladder-scheduler.h"
+#include "mobility-recorder.h"
+#include "replication-controller.h"
+#include "memory-accounting.h"
+#include "memory-census.h"
+#include "abstract-lan-channel.h"
+#include "flow-summary.h"
 
 using namespace ns3;
 
@@ -31,218 +50,250 @@ CourseChangeCallback (std::string path, Ptr<const MobilityModel> model)
   std::cout << "CourseChange " << path << " x=" << position.x << ", y=" << position.y << ", z=" << position.z << std::endl;
 }
 
-int
-main (int argc, char *argv[])
+//
+// Count the frames received by the wifi devices of a partition, or
+// delivered by its abstract LAN channel
+//
+static void
+RxFrameCallback (uint64_t *counter, Ptr<const Packet> packet)
 {
-  //
-  // First, we declare and initialize a few local variables that control some
-  // simulation parameters.
-  //
-  uint32_t backboneNodes = 6;
-  uint32_t infraNodes = 6;
-  uint32_t stopTime = 20;
-  bool useCourseChangeCallback = false;
-  double meanPacketsPerSecond = 10;
-  uint32_t packetSize = 1000; // bytes
-
-  //
-  // For convenience, we add the local variables to the command line argument
-  // system so that they can be overridden with flags such as
-  // "--backboneNodes=20"
-  //
-  CommandLine cmd (__FILE__);
-  cmd.AddValue ("backboneNodes", "number of backbone nodes", backboneNodes);
-  cmd.AddValue ("infraNodes", "number of leaf nodes", infraNodes);
-  cmd.AddValue ("stopTime", "simulation stop time (seconds)", stopTime);
-  cmd.AddValue ("useCourseChangeCallback", "whether to enable course change tracing", useCourseChangeCallback);
-
-  //
-  // The system global variables and the local values added to the argument
-  // system can be overridden by command line arguments by using this call.
-  //
-  cmd.Parse (argc, argv);
+  ++*counter;
+}
 
-  if (stopTime < 10)
+static void
+CountRxFrames (NetDeviceContainer devices, uint64_t *counter)
+{
+  for (NetDeviceContainer::Iterator d = devices.Begin (); d != devices.End (); ++d)
     {
-      std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
-      exit (1);
+      DynamicCast<WifiNetDevice> (*d)->GetPhy ()->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&RxFrameCallback, counter));
     }
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Construct the backbone                                                //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
+}
 
-  //
-  // Create a container to manage the nodes of the adhoc (backbone) network.
-  // Later we'll create the rest of the nodes we'll need.
-  //
-  NodeContainer backbone;
-  backbone.Create (backboneNodes);
-  //
-  // Create the backbone wifi net devices and install them into the nodes in
-  // our container
-  //
-  WifiHelper wifi;
-  WifiMacHelper mac;
-  mac.SetType ("ns3::AdhocWifiMac");
-  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                "DataMode", StringValue ("OfdmRate54Mbps"));
-  YansWifiPhyHelper wifiPhy;
-  wifiPhy.SetPcapDataLinkType (WifiPhyHelper::DLT_IEEE802_11_RADIO);
-  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
-  wifiPhy.SetChannel (wifiChannel.Create ());
-  NetDeviceContainer backboneDevices = wifi.Install (wifiPhy, mac, backbone);
-
-  // We enable OLSR (which will be consulted at a higher priority than
-  // the global routing) on the backbone ad hoc nodes
-  NS_LOG_INFO ("Enabling OLSR routing on all backbone nodes");
-  OlsrHelper olsr;
-  //
-  // Add the IPv4 protocol stack to the nodes in our container
-  //
-  InternetStackHelper internet;
-  internet.SetRoutingHelper (olsr); // has effect on the next Install ()
-  internet.Install (backbone);
+//
+// Parameters of the scenario, filled from the command line
+//
+struct MixedConfig
+{
+  uint32_t backboneNodes;
+  uint32_t infraNodes;
+  uint32_t stopTime;
+  bool useCourseChangeCallback;
+  double meanPacketsPerSecond;
+  uint32_t packetSize; // bytes
+  std::string animation;
+  double animPositionPeriod;
+  uint32_t animMaxPacketsPerSecond;
+  uint32_t animPacketSampling;
+  bool packetPool;
+  std::string benchmarkOutput;
+  double warmStart;
+  std::string warmStartRates;
+  std::string warmStartRuns;
+  std::string warmStartSummary;
+  uint32_t jobs;
+  bool profile;
+  uint32_t profileSampling;
+  std::string scheduler;
+  std::string mobilityTrace;
+  double mobilitySampling;
+  std::string mobilityEngine;
+  std::string traffic;
+  bool memoryReport;
+  bool compact;
+  bool partitionStreams; // random streams from the partition and node
+  bool phaseTimes;      // print the time of every construction phase
+  std::string trafficMatrix;
+  uint32_t matrixFlows;
+  std::string lanPhy;
+  bool calibrateLanPhy; // measure the PerTable of the wifi LANs, added to the table file if it exists
+  bool flowTotals;      // write the FlowMonitor totals instead of the partition rows
+  bool replicationTotals; // write the frame and FlowMonitor totals instead of the partition rows
+  TopologySpec topology; // from the values above and the topology file
+};
 
-  //
-  // Assign IPv4 addresses to the device drivers (actually to the associated
-  // IPv4 interfaces) we just created.
-  //
-  Ipv4AddressHelper ipAddrs;
-  ipAddrs.SetBase ("192.168.0.0", "255.255.255.0");
-  ipAddrs.Assign (backboneDevices);
+//
+// The scenario splits into partitions: partition 0 is the adhoc backbone
+// and partition i + 1 is the LAN of backbone node i.  As in the original
+// scenario, the gateways have no LAN device, so the LAN stations only
+// share a channel with each other and no frame ever crosses from one
+// partition to another.  The parallel mode relies on that: it runs every
+// partition as a separate simulation, side by side, with no
+// synchronization between them.  It is not a parallel discrete event
+// simulation, and would give wrong results for a topology whose
+// partitions exchanged frames.  A partition can be simulated on its own
+// as long as
+//
+//  - every process creates all the nodes, in the same order, so that node
+//    ids are the same everywhere;
+//  - every random variable gets a stream number that only depends on the
+//    node or partition it belongs to, not on what else the process built
+//    (stack.streams "partition", see topology-builder.h);
+//  - the LAN stations, whose mobility is relative to their backbone node,
+//    see the same backbone trajectory: the backbone mobility is installed
+//    in every process, from the same streams.
+//
+// The sequential run keeps the streams of the original scenario, in
+// creation order, unless partitionStreams is set; with it, its rows are
+// the same as those of the parallel mode.
+//
+// Column names of the per-partition results.
+//
+static const char PARTITION_COLUMNS[] = "nodes,rxFrames,sinkRxBytes";
 
-  //
-  // The ad-hoc network nodes need a mobility model so we aggregate one to
-  // each of the nodes we just finished building.
-  //
-  MobilityHelper mobility;
-  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                 "MinX", DoubleValue (20.0),
-                                 "MinY", DoubleValue (20.0),
-                                 "DeltaX", DoubleValue (20.0),
-                                 "DeltaY", DoubleValue (20.0),
-                                 "GridWidth", UintegerValue (5),
-                                 "LayoutType", StringValue ("RowFirst"));
-  mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-500, 500, -500, 500)),
-                             "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=2]"),
-                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.2]"));
-  mobility.Install (backbone);
+//
+// Column names of the one row of a replication: the frames received in
+// all the partitions and the FlowMonitor totals (see flow-summary.h).
+// The OnOff flow crosses LANs that share no device, so only the flows of
+// a traffic matrix deliver packets.
+//
+static const char REPLICATION_COLUMNS[] =
+  "rxFrames,flowFlows,flowTxPackets,flowRxPackets,flowLostPackets,flowThroughputKbps,flowMeanDelayMs,flowMeanJitterMs";
 
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Construct the LANs                                                    //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
+//
+// Counters of the simulated partitions
+//
+struct PartitionResults : public SimpleRefCount<PartitionResults>
+{
+  int32_t partition;              // simulated partition, -1 for all
+  uint32_t backboneNodes;
+  uint32_t infraNodes;
+  std::vector<bool> simulated;    // by partition
+  std::vector<uint64_t> rxFrames; // by partition
+  Ptr<PacketSink> sinkApp;
+};
 
-  // Reset the address base-- all of the CSMA networks will be in
-  // the "172.16 address space
-  ipAddrs.SetBase ("172.16.0.0", "255.255.255.0");
+//
+// Write one CSV row per simulated partition, prefixed by the partition
+// number when they all are
+//
+static void
+WritePartitionRows (Ptr<PartitionResults> results, std::ostream &os)
+{
+  for (uint32_t p = 0; p < results->simulated.size (); ++p)
+    {
+      if (!results->simulated[p])
+        {
+          continue;
+        }
+      if (results->partition < 0)
+        {
+          os << p << ",";
+        }
+      os << (p == 0 ? results->backboneNodes : results->infraNodes - 1) << "," << results->rxFrames[p] << ","
+         << (p == results->backboneNodes ? results->sinkApp->GetTotalRx () : 0) << std::endl;
+    }
+}
 
+//
+// What the children of a warm start need from the warmed-up simulation
+//
+struct MixedWarmStart : public SimpleRefCount<MixedWarmStart>
+{
+  Ptr<PartitionResults> results;
+  Ptr<RandomVariableStream> offTime;
+  uint32_t stopTime;
+  bool profile;
+  ParameterSweep *sweep;
+};
 
-  for (uint32_t i = 0; i < backboneNodes; ++i)
+//
+// Continue a warm-started simulation in a child process, with its own
+// traffic rate and RNG run number for the traffic
+//
+static void
+ContinueWarmStart (Ptr<MixedWarmStart> state, const ParameterSweep::Point &point, std::ostream &os)
+{
+  ParameterSweep::Point::const_iterator it;
+  if ((it = point.find ("meanPacketsPerSecond")) != point.end ())
     {
-      NS_LOG_INFO ("Configuring local area network for backbone node " << i);
-      //
-      // Create a container to manage the nodes of the LAN.  We need
-      // two containers here; one with all of the new nodes, and one
-      // with all of the nodes including new and existing nodes
-      //
-      NodeContainer stas;
-      stas.Create (infraNodes - 1);
-      // Now, create the container with all nodes on this link
-      NodeContainer infra (backbone.Get (i), stas);
-      //
-      // Create an infrastructure network
-      //
-      WifiHelper wifiInfra;
-      WifiMacHelper macInfra;
-      macInfra.SetType ("ns3::AdhocWifiMac");
-      wifiInfra.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
-                                    "DataMode", StringValue ("OfdmRate54Mbps"));
-      YansWifiPhyHelper wifiPhyInfra;
-      wifiPhyInfra.SetPcapDataLinkType (WifiPhyHelper::DLT_IEEE802_11_RADIO);
-      YansWifiChannelHelper wifiChannelInfra = YansWifiChannelHelper::Default ();
-      wifiPhyInfra.SetChannel (wifiChannelInfra.Create ());
-      NetDeviceContainer lanDevices = wifiInfra.Install (wifiPhyInfra, macInfra, stas);
-  
-      //
-      // Add the IPv4 protocol stack to the new LAN nodes
-      //
-      internet.Install (stas);
-      //
-      // Assign IPv4 addresses to the device drivers (actually to the
-      // associated IPv4 interfaces) we just created.
-      //
-      ipAddrs.Assign (lanDevices);
-      //
-      // Assign a new network prefix for the next LAN, according to the
-      // network mask initialized above
-      //
-      ipAddrs.NewNetwork ();
-      //
-      // The new LAN nodes need a mobility model so we aggregate one
-      // to each of the nodes we just finished building.
-      //
-      
-      mobility.PushReferenceMobilityModel (backbone.Get (i));
-      mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                 "MinX", DoubleValue (20.0),
-                                 "MinY", DoubleValue (20.0),
-                                 "DeltaX", DoubleValue (20.0),
-                                 "DeltaY", DoubleValue (20.0),
-                                 "GridWidth", UintegerValue (5),
-                                 "LayoutType", StringValue ("RowFirst"));
-      mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-500, 500, -500, 500)),
-                             "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=2]"),
-                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.2]"));
-      mobility.Install (stas);
+      state->offTime->SetAttribute ("Mean", DoubleValue (1.0 / std::atof (it->second.c_str ())));
+    }
+  if ((it = point.find ("run")) != point.end ())
+    {
+      RngSeedManager::SetRun (std::atoi (it->second.c_str ()));
+    }
+  // A new generator from the current seed and run
+  state->offTime->SetStream (TopologyBuilder::APPLICATION_STREAM);
+  Simulator::Stop (Seconds (state->stopTime) - Simulator::Now ());
+  Simulator::Run ();
+  WritePartitionRows (state->results, os);
+  if (state->profile)
+    {
+      ProfilingSimulatorImpl::Report (std::cout, "mixed-wireless-" + state->sweep->GetLabel (point) + ".folded");
     }
+}
 
-  ///////////////////////////////////////////////////////////////////////////
-  //                                                                       //
-  // Application configuration                                             //
-  //                                                                       //
-  ///////////////////////////////////////////////////////////////////////////
+//
+// Build and run the scenario.  If partition is negative, every partition
+// is simulated; otherwise only that one.  One CSV row of results per
+// simulated partition is written to os.
+//
+static void
+RunMixedWireless (const MixedConfig &cfg, int32_t partition, std::ostream &os)
+{
+  if (cfg.profile)
+    {
+      // Before anything creates the simulator
+      ProfilingSimulatorImpl::Enable (cfg.profileSampling);
+    }
+  GlobalValue::Bind ("SchedulerType", StringValue (GetSchedulerTypeName (cfg.scheduler)));
+  NS_ABORT_MSG_IF ((cfg.packetPool || cfg.memoryReport) && !PooledAllocator::IsInstalled (),
+                   "--packetPool and --memoryReport need a build with CXXFLAGS=\"-DPOOLED_ALLOCATOR=1\"");
+  if (cfg.packetPool)
+    {
+      PooledAllocator::LearnPacketSizes (cfg.topology.GetUinteger ("traffic.packetSize"));
+    }
+  PooledAllocator::Enable (cfg.packetPool);
+  MemoryAccounting::Enable (cfg.memoryReport);
+  BenchmarkReport benchmark;
+  uint32_t backboneNodes = cfg.backboneNodes;
+  uint32_t infraNodes = cfg.infraNodes;
+  uint32_t nPartitions = backboneNodes + 1;
+  Ptr<PartitionResults> results = Create<PartitionResults> ();
+  results->partition = partition;
+  results->backboneNodes = backboneNodes;
+  results->infraNodes = infraNodes;
+  results->simulated.assign (nPartitions, partition < 0);
+  if (partition >= 0)
+    {
+      results->simulated[partition] = true;
+    }
+  results->rxFrames.assign (nPartitions, 0);
+  const std::vector<bool> &simulated = results->simulated;
 
-  // Create the OnOff application to send UDP datagrams of size
-  // 210 bytes at a rate of 10 Kb/s, between two nodes
-
-  NS_LOG_INFO ("Create Applications.");
-  uint16_t port = 9;   // Discard port (RFC 863)
-
-  // We want the source to be the first node created outside of the backbone
-  // Conveniently, the variable "backboneNodes" holds this node index value
-  Ptr<Node> appSource = NodeList::GetNode (backboneNodes);
-  // We want the sink to be the last node created in the topology.
-  uint32_t lastNodeIndex = backboneNodes + /*backboneNodes * (lanNodes - 1) +*/ backboneNodes * (infraNodes - 1) - 1;
-  Ptr<Node> appSink = NodeList::GetNode (lastNodeIndex);
-  // Let's fetch the IP address of the last node, which is on Ipv4Interface 1
-  Ipv4Address remoteAddr = appSink->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
-
-  Ptr<RandomVariableStream> interPacketIntervalStream = CreateObject<ExponentialRandomVariable>();
-  interPacketIntervalStream->SetAttribute("Mean", DoubleValue(1.0 / meanPacketsPerSecond));
-
-  OnOffHelper onoff ("ns3::UdpSocketFactory",
-                     Address (InetSocketAddress (remoteAddr, port)));
-  onoff.SetAttribute("OnTime", PointerValue(CreateObject<ConstantRandomVariable>()));
-  onoff.SetAttribute("OffTime", PointerValue(interPacketIntervalStream));
-  onoff.SetAttribute ("PacketSize", UintegerValue (packetSize));
-  onoff.SetAttribute ("DataRate", StringValue ("50Mbps")); //bit/s
-
-
-  ApplicationContainer apps = onoff.Install (appSource);
-  apps.Start (Seconds (3));
-  apps.Stop (Seconds (stopTime - 1));
-
-  // Create a packet sink to receive these packets
-  PacketSinkHelper sink ("ns3::UdpSocketFactory",
-                         InetSocketAddress (Ipv4Address::GetAny (), port));
-  apps = sink.Install (appSink);
-  apps.Start (Seconds (3));
+  //
+  // Build the backbone, the LANs and the applications from the topology
+  // spec, phase by phase
+  //
+  NS_LOG_INFO ("Build Topology.");
+  TopologyBuilder builder (cfg.topology, partition);
+  builder.Build (cfg.stopTime);
+  if (cfg.phaseTimes)
+    {
+      builder.PrintPhaseTimes (std::cout);
+    }
+  NodeContainer backbone = builder.GetBackbone ();
+  if (simulated[0])
+    {
+      CountRxFrames (builder.GetBackboneDevices (), &results->rxFrames[0]);
+    }
+  for (uint32_t i = 0; i < backboneNodes; ++i)
+    {
+      if (!simulated[i + 1])
+        {
+          continue;
+        }
+      if (builder.GetLanChannel (i) != 0)
+        {
+          builder.GetLanChannel (i)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&RxFrameCallback, &results->rxFrames[i + 1]));
+        }
+      else
+        {
+          CountRxFrames (builder.GetLanDevices (i), &results->rxFrames[i + 1]);
+        }
+    }
+  Ptr<RandomVariableStream> interPacketIntervalStream = builder.GetOffTime ();
+  results->sinkApp = builder.GetSink ();
 /*
   ///////////////////////////////////////////////////////////////////////////
   //                                                                       //
@@ -269,12 +320,80 @@ main (int argc, char *argv[])
   // pcap trace on the application data sink
   wifiPhy.EnablePcap ("mixed-wireless", appSink->GetId (), 0);
 */
-  if (useCourseChangeCallback == true)
+  //
+  // Course changes of the simulated nodes, printed or recorded as binary
+  // positions (see mobility-recorder.h)
+  //
+  NodeContainer traced;
+  for (uint32_t p = 0; p < nPartitions; ++p)
+    {
+      if (simulated[p])
+        {
+          traced.Add (p == 0 ? backbone : builder.GetLan (p - 1));
+        }
+    }
+  MobilityRecorder mobilityRecorder;
+  if (cfg.mobilityTrace == "binary")
     {
-      Config::Connect ("/NodeList/*/$ns3::MobilityModel/CourseChange", MakeCallback (&CourseChangeCallback));
+      std::ostringstream filename;
+      filename << "mixed-wireless";
+      if (partition >= 0)
+        {
+          filename << "-partition" << partition;
+        }
+      filename << ".mobr";
+      mobilityRecorder.SetSamplingPeriod (Seconds (cfg.mobilitySampling));
+      mobilityRecorder.Install (filename.str (), traced);
+    }
+  else if (cfg.useCourseChangeCallback == true)
+    {
+      for (NodeContainer::Iterator n = traced.Begin (); n != traced.End (); ++n)
+        {
+          std::ostringstream path;
+          path << "/NodeList/" << (*n)->GetId () << "/$ns3::MobilityModel/CourseChange";
+          Config::Connect (path.str (), MakeCallback (&CourseChangeCallback));
+        }
     }
 
-  AnimationInterface anim ("uno.xml");
+  //
+  // NetAnim output: the full AnimationInterface, a recorder with bounded
+  // memory that samples positions and rate-limits packet records, or none
+  //
+  AnimationInterface *anim = 0;
+  StreamingAnimRecorder animRecorder;
+  if (cfg.animation == "netanim")
+    {
+      anim = new AnimationInterface ("uno.xml");
+    }
+  else if (cfg.animation == "stream")
+    {
+      animRecorder.SetPositionPeriod (Seconds (cfg.animPositionPeriod));
+      animRecorder.SetMaxPacketsPerSecond (cfg.animMaxPacketsPerSecond);
+      animRecorder.SetPacketSampling (cfg.animPacketSampling);
+      animRecorder.Install ("uno.xml", NodeContainer::GetGlobal ());
+    }
+
+  //
+  // PER table of the LANs, measured on their wifi PHYs, and end-to-end
+  // flow totals, to compare the full and abstract LAN models
+  //
+  LanPhyCalibrator calibrator;
+  if (cfg.calibrateLanPhy)
+    {
+      for (uint32_t i = 0; i < backboneNodes; ++i)
+        {
+          if (simulated[i + 1])
+            {
+              calibrator.Install (builder.GetLanDevices (i));
+            }
+        }
+    }
+  FlowMonitorHelper flowHelper;
+  Ptr<FlowMonitor> flowMonitor;
+  if (cfg.flowTotals || cfg.replicationTotals)
+    {
+      flowMonitor = flowHelper.InstallAll ();
+    }
 
   ///////////////////////////////////////////////////////////////////////////
   //                                                                       //
@@ -282,8 +401,498 @@ main (int argc, char *argv[])
   //                                                                       //
   ///////////////////////////////////////////////////////////////////////////
 
+  if (cfg.warmStart > 0)
+    {
+      //
+      // Simulate the OLSR convergence once, then fork one child per
+      // traffic rate and run from this state
+      //
+      NS_ABORT_MSG_UNLESS (partition < 0 && cfg.animation == "none" && cfg.mobilityTrace != "binary",
+                           "warm start needs --parallel=0 --animation=none and no binary mobility trace");
+      // The children only reseed the traffic, which must not have started
+      NS_ABORT_MSG_IF (cfg.warmStart >= cfg.topology.GetDouble ("traffic.start"),
+                       "warm start must end before the OnOff source starts at "
+                       << cfg.topology.GetDouble ("traffic.start") << " s");
+      NS_LOG_INFO ("Run Warm-up.");
+      Simulator::Stop (Seconds (cfg.warmStart));
+      Simulator::Run ();
+      Ptr<MixedWarmStart> state = Create<MixedWarmStart> ();
+      state->results = results;
+      state->offTime = interPacketIntervalStream;
+      state->stopTime = cfg.stopTime;
+      state->profile = cfg.profile;
+      ParameterSweep sweep;
+      state->sweep = &sweep;
+      sweep.AddAxis ("meanPacketsPerSecond", cfg.warmStartRates);
+      sweep.AddAxis ("run", cfg.warmStartRuns);
+      NS_ABORT_MSG_UNLESS (sweep.IsEnabled (), "warm start needs --warmStartRates or --warmStartRuns");
+      sweep.SetJobs (cfg.jobs);
+      sweep.SetSummaryFile (cfg.warmStartSummary);
+      sweep.SetColumns (std::string ("partition,") + PARTITION_COLUMNS);
+      uint32_t failed = sweep.Run (MakeBoundCallback (&ContinueWarmStart, state));
+      Simulator::Destroy ();
+      NS_ABORT_MSG_IF (failed > 0, failed << " warm-started runs failed");
+      return;
+    }
+
+  //
+  // Live heap bytes by construction phase, and the objects of the
+  // simulated nodes by TypeId, after the build and at the end of the run
+  //
+  std::ofstream memoryReport;
+  std::ofstream censusReport;
+  MemoryCensus census;
+  if (cfg.memoryReport)
+    {
+      std::ostringstream filename;
+      filename << "mixed-wireless";
+      if (partition >= 0)
+        {
+          filename << "-partition" << partition;
+        }
+      MemoryAccounting::PrintReport (std::cout, "after build");
+      memoryReport.open ((filename.str () + "-memory.csv").c_str ());
+      memoryReport << MEMORY_REPORT_COLUMNS << std::endl;
+      MemoryAccounting::WriteReport (memoryReport, "build");
+      census.Take (traced);
+      census.Print (std::cout, "after build");
+      censusReport.open ((filename.str () + "-census.csv").c_str ());
+      censusReport << MEMORY_CENSUS_COLUMNS << std::endl;
+      census.Write (censusReport, "build");
+    }
+  MemoryAccounting::Charge ("run");
+
   NS_LOG_INFO ("Run Simulation.");
-  Simulator::Stop (Seconds (stopTime));
+  Simulator::Stop (Seconds (cfg.stopTime));
+  benchmark.Begin (BenchmarkReport::RUN);
   Simulator::Run ();
+  benchmark.Begin (BenchmarkReport::OUTPUT);
+  if (cfg.memoryReport)
+    {
+      MemoryAccounting::PrintReport (std::cout, "end of run");
+      MemoryAccounting::WriteReport (memoryReport, "run");
+      census.Take (traced);
+      census.Print (std::cout, "end of run");
+      census.Write (censusReport, "run");
+    }
+  MemoryAccounting::Charge ("output");
+  animRecorder.Close ();
+  mobilityRecorder.Close ();
+  if (cfg.flowTotals)
+    {
+      os << benchmark.GetSeconds (BenchmarkReport::RUN) << ",";
+      WriteFlowTotals (flowMonitor, os);
+    }
+  else if (cfg.replicationTotals)
+    {
+      uint64_t rxFrames = 0;
+      for (uint32_t p = 0; p < nPartitions; ++p)
+        {
+          rxFrames += results->rxFrames[p];
+        }
+      os << rxFrames << ",";
+      WriteFlowTotals (flowMonitor, os);
+    }
+  else
+    {
+      WritePartitionRows (results, os);
+    }
+  if (cfg.calibrateLanPhy)
+    {
+      std::ifstream previous (cfg.topology.Get ("lans.phyTable").c_str ());
+      if (previous.is_open ())
+        {
+          previous.close ();
+          calibrator.GetTable ()->Load (cfg.topology.Get ("lans.phyTable"));
+        }
+      std::ofstream table (cfg.topology.Get ("lans.phyTable").c_str ());
+      calibrator.GetTable ()->Write (table);
+      std::cout << "LanPhyCalibrator: " << calibrator.GetTable ()->GetAttempts () << " attempts written to "
+                << cfg.topology.Get ("lans.phyTable") << std::endl;
+    }
+  for (uint32_t i = 0; i < backboneNodes; ++i)
+    {
+      if (simulated[i + 1] && builder.GetLanChannel (i) != 0)
+        {
+          std::cout << "LAN " << i << " ";
+          builder.GetLanChannel (i)->PrintStats (std::cout);
+        }
+    }
+  if (cfg.packetPool)
+    {
+      PooledAllocator::PrintStats (std::cout);
+    }
+  if (builder.GetPositions () != 0)
+    {
+      builder.GetPositions ()->PrintStats (std::cout);
+    }
+  if (builder.GetMatrix () != 0)
+    {
+      builder.GetMatrix ()->PrintStats (std::cout);
+      std::ofstream matrixSummary ("mixed-wireless-matrix.csv");
+      builder.GetMatrix ()->WriteSummary (matrixSummary);
+    }
+  if (cfg.profile)
+    {
+      std::ostringstream folded;
+      folded << "mixed-wireless";
+      if (partition >= 0)
+        {
+          folded << "-partition" << partition;
+        }
+      ProfilingSimulatorImpl::Report (std::cout, folded.str () + ".folded");
+    }
   Simulator::Destroy ();
+  delete anim;
+  std::ostringstream parameters;
+  parameters << "backboneNodes=" << backboneNodes << ";infraNodes=" << infraNodes;
+  if (partition >= 0)
+    {
+      parameters << ";partition=" << partition;
+    }
+  if (cfg.scheduler != "map")
+    {
+      parameters << ";scheduler=" << cfg.scheduler;
+    }
+  if (cfg.topology.Get ("mobility.engine") != "model")
+    {
+      parameters << ";mobility=" << cfg.topology.Get ("mobility.engine");
+    }
+  if (cfg.topology.Get ("traffic.generator") != "onoff")
+    {
+      parameters << ";traffic=" << cfg.topology.Get ("traffic.generator");
+    }
+  if (cfg.topology.Get ("traffic.matrix") != "none")
+    {
+      parameters << ";matrix=" << cfg.topology.Get ("traffic.matrix")
+                 << ";flows=" << cfg.topology.Get ("traffic.matrixFlows");
+    }
+  if (cfg.topology.GetUinteger ("stack.ipv6") == 0 || cfg.topology.GetUinteger ("stack.queueDiscs") == 0)
+    {
+      parameters << ";compact=1";
+    }
+  if (cfg.topology.Get ("lans.phy") != "yans")
+    {
+      parameters << ";lanPhy=" << cfg.topology.Get ("lans.phy");
+    }
+  if (cfg.packetPool)
+    {
+      parameters << ";packetPool=1";
+    }
+  if (cfg.profile)
+    {
+      parameters << ";profile=" << cfg.profileSampling;
+    }
+  benchmark.Write (cfg.benchmarkOutput, "mixed-wireless", parameters.str ());
+}
+
+//
+// Run one partition in a worker process of the parallel mode
+//
+static void
+RunPartition (MixedConfig cfg, const ParameterSweep::Point &point, std::ostream &os)
+{
+  RunMixedWireless (cfg, std::atoi (point.find ("partition")->second.c_str ()), os);
+}
+
+//
+// Run the whole scenario with one RNG run in a worker process of the
+// replication mode
+//
+static void
+RunReplication (MixedConfig cfg, const ParameterSweep::Point &point, std::ostream &os)
+{
+  RngSeedManager::SetRun (std::atoi (point.find ("run")->second.c_str ()));
+  cfg.replicationTotals = true;
+  RunMixedWireless (cfg, -1, os);
+}
+
+//
+// Run the whole scenario with one RNG run and the full LAN PHY, adding
+// its frames to the PER table, or with the abstract LAN channel using
+// the table, in a worker process of the calibration mode
+//
+static void
+RunCalibration (MixedConfig cfg, const ParameterSweep::Point &point, std::ostream &os)
+{
+  RngSeedManager::SetRun (std::atoi (point.find ("run")->second.c_str ()));
+  std::string lanPhy = point.find ("lanPhy")->second;
+  cfg.topology.Set ("lans.phy", lanPhy);
+  cfg.calibrateLanPhy = lanPhy == "yans";
+  cfg.flowTotals = true;
+  RunMixedWireless (cfg, -1, os);
+}
+
+//
+// Print the error of the abstract LAN model in throughput and delay,
+// relative to the full model, from the means over the runs of the
+// calibration summary
+//
+static int
+ReportCalibration (std::string filename)
+{
+  std::ifstream is (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (is.is_open (), "cannot open " << filename);
+  // Sums of runSeconds, flows, txPackets, rxPackets, lostPackets,
+  // throughputKbps, meanDelayMs, meanJitterMs and the number of runs
+  std::map<std::string, std::vector<double> > sums;
+  std::string line;
+  std::getline (is, line);
+  while (std::getline (is, line))
+    {
+      std::replace (line.begin (), line.end (), ',', ' ');
+      std::istringstream fields (line);
+      std::string lanPhy;
+      uint32_t run;
+      fields >> lanPhy >> run;
+      std::vector<double> values;
+      double value;
+      while (fields >> value)
+        {
+          values.push_back (value);
+        }
+      NS_ABORT_MSG_UNLESS (values.size () == 8, filename << ": bad row " << line);
+      std::vector<double> &sum = sums[lanPhy];
+      sum.resize (9, 0);
+      for (uint32_t i = 0; i < 8; ++i)
+        {
+          sum[i] += values[i];
+        }
+      ++sum[8];
+    }
+  NS_ABORT_MSG_UNLESS (sums["yans"].size () == 9 && sums["abstract"].size () == 9
+                       && sums["yans"][8] == sums["abstract"][8], filename << ": missing runs");
+  const char *names[] = {"runSeconds", "throughputKbps", "meanDelayMs"};
+  const uint32_t columns[] = {0, 5, 6};
+  std::cout << "LAN PHY calibration (abstract vs yans, mean of " << sums["yans"][8] << " runs):" << std::endl;
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      double full = sums["yans"][columns[i]] / sums["yans"][8];
+      double abstract = sums["abstract"][columns[i]] / sums["abstract"][8];
+      std::cout << "  " << names[i] << " " << full << " -> " << abstract;
+      if (full != 0)
+        {
+          std::cout << " (" << 100.0 * (abstract - full) / full << "%)";
+        }
+      std::cout << std::endl;
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  //
+  // First, we declare and initialize a few local variables that control some
+  // simulation parameters.
+  //
+  MixedConfig cfg;
+  cfg.backboneNodes = 6;
+  cfg.infraNodes = 6;
+  cfg.stopTime = 20;
+  cfg.useCourseChangeCallback = false;
+  cfg.meanPacketsPerSecond = 10;
+  cfg.packetSize = 1000; // bytes
+  cfg.animation = "netanim";
+  cfg.animPositionPeriod = 1.0;
+  cfg.animMaxPacketsPerSecond = 1000;
+  cfg.animPacketSampling = 1;
+  cfg.packetPool = false;
+  cfg.benchmarkOutput = "";
+  cfg.warmStart = 0;
+  cfg.warmStartRates = "";
+  cfg.warmStartRuns = "";
+  cfg.warmStartSummary = "mixed-wireless-warmstart.csv";
+  cfg.jobs = 0;
+  cfg.profile = false;
+  cfg.profileSampling = 1;
+  cfg.scheduler = "map";
+  cfg.mobilityTrace = "text";
+  cfg.mobilitySampling = 0;
+  cfg.mobilityEngine = "model";
+  cfg.traffic = "onoff";
+  cfg.memoryReport = false;
+  cfg.compact = false;
+  cfg.partitionStreams = false;
+  cfg.phaseTimes = false;
+  cfg.trafficMatrix = "none";
+  cfg.matrixFlows = 100;
+  cfg.lanPhy = "yans";
+  cfg.calibrateLanPhy = false;
+  cfg.flowTotals = false;
+  cfg.replicationTotals = false;
+  std::string lanPhyTable = "mixed-wireless-lanphy.csv";
+  std::string calibrationSummary = "mixed-wireless-calibration.csv";
+  std::string calibrationRuns = "1:3";
+  uint32_t parallel = 0;
+  std::string topologyFile = "";
+  std::string partitionSummary = "mixed-wireless-partitions.csv";
+  uint32_t replications = 0;
+  uint32_t minReplications = 3;
+  double ciLevel = 0.95;
+  double ciTarget = 0.05;
+  std::string ciMetrics = "";
+  std::string replicationSummary = "mixed-wireless-replications.csv";
+
+  //
+  // For convenience, we add the local variables to the command line argument
+  // system so that they can be overridden with flags such as
+  // "--backboneNodes=20"
+  //
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("backboneNodes", "number of backbone nodes", cfg.backboneNodes);
+  cmd.AddValue ("infraNodes", "number of leaf nodes", cfg.infraNodes);
+  cmd.AddValue ("stopTime", "simulation stop time (seconds)", cfg.stopTime);
+  cmd.AddValue ("useCourseChangeCallback", "whether to enable course change tracing", cfg.useCourseChangeCallback);
+  cmd.AddValue ("animation", "NetAnim output: netanim, stream (bounded memory) or none", cfg.animation);
+  cmd.AddValue ("animPositionPeriod", "stream animation: seconds between position samples", cfg.animPositionPeriod);
+  cmd.AddValue ("animMaxPacketsPerSecond", "stream animation: packet records per simulated second", cfg.animMaxPacketsPerSecond);
+  cmd.AddValue ("animPacketSampling", "stream animation: record one packet in this many", cfg.animPacketSampling);
+  cmd.AddValue ("meanPacketsPerSecond", "mean OnOff packet rate (Poisson arrivals)", cfg.meanPacketsPerSecond);
+  cmd.AddValue ("packetPool", "serve the packet-sized allocations from a size-class pool", cfg.packetPool);
+  cmd.AddValue ("benchmarkOutput", "CSV file to append phase timings and peak RSS to", cfg.benchmarkOutput);
+  cmd.AddValue ("topology", "JSON topology spec; its keys override the options above", topologyFile);
+  cmd.AddValue ("phaseTimes", "print the wall time of every topology construction phase", cfg.phaseTimes);
+  cmd.AddValue ("parallel", "worker processes for the backbone and LAN partitions (0 = sequential)", parallel);
+  cmd.AddValue ("partitionStreams", "sequential run: random streams from the partition and node, as in the parallel mode", cfg.partitionStreams);
+  cmd.AddValue ("partitionSummary", "per-partition results file", partitionSummary);
+  cmd.AddValue ("warmStart", "seconds simulated once before forking the warm-started runs (0 = off)", cfg.warmStart);
+  cmd.AddValue ("warmStartRates", "warm start: meanPacketsPerSecond values, e.g. 10,50,100", cfg.warmStartRates);
+  cmd.AddValue ("warmStartRuns", "warm start: RNG run numbers of the traffic, e.g. 1:10", cfg.warmStartRuns);
+  cmd.AddValue ("warmStartSummary", "warm start: merged results file", cfg.warmStartSummary);
+  cmd.AddValue ("jobs", "warm start and replications: concurrent runs (0 = one per core)", cfg.jobs);
+  cmd.AddValue ("replications", "maximum RNG runs, stopping early on ciTarget (0 = off)", replications);
+  cmd.AddValue ("minReplications", "replications: runs before stopping", minReplications);
+  cmd.AddValue ("ciLevel", "replications: confidence level of the intervals", ciLevel);
+  cmd.AddValue ("ciTarget", "replications: interval half-width, as a fraction of the mean, to stop at", ciTarget);
+  cmd.AddValue ("ciMetrics", "replications: totals whose intervals are tracked, among rxFrames and the flow* FlowMonitor totals "
+                "(default rxFrames, and flowRxPackets with a traffic matrix)", ciMetrics);
+  cmd.AddValue ("replicationSummary", "replications: means, half-widths and number of runs", replicationSummary);
+  cmd.AddValue ("profile", "print the wall time by event source and write mixed-wireless.folded", cfg.profile);
+  cmd.AddValue ("profileSampling", "profile: time one event in this many", cfg.profileSampling);
+  cmd.AddValue ("scheduler", "event scheduler: map, heap, list, calendar, priority or ladder", cfg.scheduler);
+  cmd.AddValue ("mobilityTrace", "course changes: text (with useCourseChangeCallback) or binary (mixed-wireless.mobr)", cfg.mobilityTrace);
+  cmd.AddValue ("mobilitySampling", "binary mobility trace: seconds between samples (0 = every course change)", cfg.mobilitySampling);
+  cmd.AddValue ("mobilityEngine", "positions: model (per node) or soa (shared structure-of-arrays table)", cfg.mobilityEngine);
+  cmd.AddValue ("traffic", "traffic source: onoff, or burst (one event per packet)", cfg.traffic);
+  cmd.AddValue ("trafficMatrix", "extra UDP flows between the stations: none, gateway, random, or a flow file", cfg.trafficMatrix);
+  cmd.AddValue ("matrixFlows", "random traffic matrix: number of flows", cfg.matrixFlows);
+  cmd.AddValue ("memoryReport", "print the live heap bytes by construction phase and by object type, written to mixed-wireless-memory.csv and -census.csv", cfg.memoryReport);
+  cmd.AddValue ("compact", "smaller per-node footprint: no IPv6 stack and no queue discs", cfg.compact);
+  cmd.AddValue ("lanPhy", "LAN model: yans (full PHY), abstract (PER table) or calibrate (measure the table and compare both)", cfg.lanPhy);
+  cmd.AddValue ("lanPhyTable", "PER table of the abstract LAN model, written by --lanPhy=calibrate", lanPhyTable);
+  cmd.AddValue ("calibrationSummary", "calibration: flow totals of the yans and abstract runs", calibrationSummary);
+  cmd.AddValue ("calibrationRuns", "calibration: RNG run numbers of both models, e.g. 1:3", calibrationRuns);
+
+  //
+  // The system global variables and the local values added to the argument
+  // system can be overridden by command line arguments by using this call.
+  //
+  cmd.Parse (argc, argv);
+
+  if (cfg.stopTime < 10)
+    {
+      std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
+      exit (1);
+    }
+  cfg.topology.Set ("backbone.nodes", cfg.backboneNodes);
+  cfg.topology.Set ("lans.stations", cfg.infraNodes - 1);
+  cfg.topology.Set ("traffic.meanPacketsPerSecond", cfg.meanPacketsPerSecond);
+  cfg.topology.Set ("traffic.packetSize", cfg.packetSize);
+  cfg.topology.Set ("mobility.engine", cfg.mobilityEngine);
+  cfg.topology.Set ("traffic.generator", cfg.traffic);
+  cfg.topology.Set ("traffic.matrix", cfg.trafficMatrix);
+  cfg.topology.Set ("traffic.matrixFlows", cfg.matrixFlows);
+  cfg.topology.Set ("stack.ipv6", cfg.compact ? "0" : "1");
+  cfg.topology.Set ("stack.queueDiscs", cfg.compact ? "0" : "1");
+  cfg.topology.Set ("stack.streams", cfg.partitionStreams || parallel > 0 || cfg.lanPhy == "calibrate" ? "partition" : "auto");
+  cfg.topology.Set ("lans.phy", cfg.lanPhy == "calibrate" ? "yans" : cfg.lanPhy);
+  cfg.topology.Set ("lans.phyTable", lanPhyTable);
+  if (!topologyFile.empty ())
+    {
+      cfg.topology.Load (topologyFile);
+      cfg.backboneNodes = cfg.topology.GetUinteger ("backbone.nodes");
+      cfg.infraNodes = cfg.topology.GetUinteger ("lans.stations") + 1;
+      cfg.meanPacketsPerSecond = cfg.topology.GetDouble ("traffic.meanPacketsPerSecond");
+      cfg.packetSize = cfg.topology.GetUinteger ("traffic.packetSize");
+    }
+  if (cfg.lanPhy == "calibrate")
+    {
+      //
+      // Calibration mode: full-PHY runs measure the PER table, then
+      // abstract runs with the same RNG runs use it; the means of their
+      // flow totals are compared.  The streams come from the partitions,
+      // so that both models draw the same traffic and routing streams.
+      //
+      NS_ABORT_MSG_UNLESS (parallel == 0 && replications == 0 && cfg.warmStart == 0 && cfg.animation == "none"
+                           && cfg.mobilityTrace != "binary",
+                           "calibration needs --parallel=0 --replications=0 --warmStart=0 --animation=none and no binary mobility trace");
+      NS_ABORT_MSG_IF (cfg.topology.Get ("traffic.matrix") == "none",
+                       "calibration needs LAN traffic: set --trafficMatrix");
+      NS_ABORT_MSG_UNLESS (cfg.topology.Get ("stack.streams") == "partition",
+                           "calibration needs stack.streams \"partition\"");
+      ParameterSweep sweep;
+      sweep.AddAxis ("lanPhy", "yans,abstract");
+      NS_ABORT_MSG_IF (calibrationRuns.empty (), "calibration needs --calibrationRuns");
+      sweep.AddAxis ("run", calibrationRuns);
+      // In order: the yans runs add to a fresh table, which the abstract
+      // runs read
+      std::remove (cfg.topology.Get ("lans.phyTable").c_str ());
+      sweep.SetJobs (1);
+      sweep.SetSummaryFile (calibrationSummary);
+      sweep.SetColumns (std::string ("runSeconds,") + FLOW_TOTALS_COLUMNS);
+      if (sweep.Run (MakeBoundCallback (&RunCalibration, cfg)) != 0)
+        {
+          return 1;
+        }
+      return ReportCalibration (calibrationSummary);
+    }
+  if (replications > 0)
+    {
+      //
+      // Replication mode: whole runs with RNG runs 1, 2, ... until the
+      // confidence intervals of the chosen totals are narrow enough
+      //
+      NS_ABORT_MSG_UNLESS (parallel == 0 && cfg.warmStart == 0 && cfg.animation == "none"
+                           && cfg.mobilityTrace != "binary",
+                           "replications need --parallel=0 --warmStart=0 --animation=none and no binary mobility trace");
+      ReplicationController controller ((ParameterSweep ()));
+      controller.SetJobs (cfg.jobs);
+      controller.SetRuns (minReplications, replications);
+      controller.SetTarget (ciLevel, ciTarget, true);
+      if (ciMetrics.empty ())
+        {
+          // Both vary from run to run; the OnOff flow delivers nothing
+          ciMetrics = cfg.topology.Get ("traffic.matrix") != "none" ? "rxFrames,flowRxPackets" : "rxFrames";
+        }
+      controller.SetColumns (REPLICATION_COLUMNS);
+      controller.SetMetrics (ciMetrics);
+      controller.SetSummaryFile (replicationSummary);
+      return controller.Run (MakeBoundCallback (&RunReplication, cfg)) == 0 ? 0 : 1;
+    }
+  if (parallel == 0)
+    {
+      std::ofstream summary (partitionSummary.c_str ());
+      summary << "partition," << PARTITION_COLUMNS << std::endl;
+      RunMixedWireless (cfg, -1, summary);
+      return 0;
+    }
+
+  //
+  // Parallel mode: every partition runs as its own simulation, in its own
+  // process.  This is only valid because the partitions exchange no
+  // frames; the summary is the same as the sequential one with
+  // --partitionStreams=1.
+  //
+  NS_ABORT_MSG_UNLESS (cfg.animation == "none", "parallel mode needs --animation=none");
+  NS_ABORT_MSG_UNLESS (cfg.topology.Get ("stack.streams") == "partition",
+                       "parallel mode needs stack.streams \"partition\"");
+  std::ostringstream partitions;
+  partitions << "0:" << cfg.backboneNodes;
+  ParameterSweep sweep;
+  sweep.AddAxis ("partition", partitions.str ());
+  sweep.SetJobs (parallel);
+  sweep.SetSummaryFile (partitionSummary);
+  sweep.SetColumns (PARTITION_COLUMNS);
+  return sweep.Run (MakeBoundCallback (&RunPartition, cfg)) == 0 ? 0 : 1;
 }
@@ -0,0 +1,218 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+//
+// Live heap bytes by component.
+//
+// The scenario names the component it is building, e.g.
+// MemoryAccounting::Charge ("wifi") before installing the devices, and
+// every block allocated by the calling thread from then on is charged
+// to that component.  The global operator new of pooled-allocator.h,
+// in a build with POOLED_ALLOCATOR, records the component and size in
+// the header of the block, so a block freed later, by any thread, is
+// taken off the right component.  Only blocks allocated while
+// accounting is enabled are counted.
+//
+// A report lists the live blocks and bytes of every component, as a
+// table or as CSV rows:
+//
+//   phase,component,blocks,bytes
+//
+// The components are what the scenario was building, or "run" during
+// the simulation; the objects of every node by TypeId, and the bytes
+// each node owns, come from a MemoryCensus (see memory-census.h).
+//
+
+#include <stdint.h>
+#include <atomic>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+
+namespace ns3 {
+
+/// Column names of the rows written by MemoryAccounting::WriteReport.
+static const char MEMORY_REPORT_COLUMNS[] = "phase,component,blocks,bytes";
+
+/**
+ * \brief Live heap blocks and bytes by component, fed by the global
+ * operator new.
+ */
+class MemoryAccounting
+{
+public:
+  /// Components, including "other" (0).
+  static const uint32_t MAX_COMPONENTS = 64;
+  /// Component of the blocks that are not accounted.
+  static const uint8_t UNTRACKED = 0xff;
+
+  /// \brief Charge the allocations of a scope to a component.
+  class Scope
+  {
+  public:
+    /// \param component the component
+    Scope (std::string component)
+      : m_previous (Current ())
+    {
+      Charge (component);
+    }
+
+    ~Scope ()
+    {
+      Current () = m_previous;
+    }
+
+  private:
+    uint8_t m_previous;  //!< component before the scope
+  };
+
+  /// \param enabled whether new allocations are accounted
+  static void Enable (bool enabled)
+  {
+    Enabled () = enabled;
+  }
+
+  /// \return true if new allocations are accounted
+  static bool IsEnabled (void)
+  {
+    return Enabled ();
+  }
+
+  /// \param component the component the next allocations of the calling thread are charged to
+  static void Charge (std::string component)
+  {
+    std::vector<std::string> &names = Names ();
+    uint32_t id = 0;
+    while (id < names.size () && names[id] != component)
+      {
+        ++id;
+      }
+    if (id == names.size ())
+      {
+        NS_ABORT_MSG_IF (id == MAX_COMPONENTS, "MemoryAccounting: too many components");
+        names.push_back (component);
+      }
+    Current () = static_cast<uint8_t> (id);
+  }
+
+  /// \return the component charged by the calling thread
+  static uint8_t GetCurrent (void)
+  {
+    return Current ();
+  }
+
+  /**
+   * \brief Account a block; called by the allocator.
+   * \param component the component of the block
+   * \param bytes its size, negative when it is freed
+   */
+  static void Add (uint8_t component, int64_t bytes)
+  {
+    Counter &counter = Counters ()[component];
+    counter.bytes.fetch_add (bytes, std::memory_order_relaxed);
+    counter.blocks.fetch_add (bytes < 0 ? -1 : 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Print the live blocks and bytes of every component.
+   * \param os the output stream
+   * \param phase when the report is made, e.g. "after build"
+   */
+  static void PrintReport (std::ostream &os, std::string phase)
+  {
+    const std::vector<std::string> &names = Names ();
+    int64_t total = 0;
+    int64_t blocks = 0;
+    for (uint32_t i = 0; i < names.size (); ++i)
+      {
+        total += Counters ()[i].bytes.load (std::memory_order_relaxed);
+        blocks += Counters ()[i].blocks.load (std::memory_order_relaxed);
+      }
+    os << "MemoryAccounting (" << phase << "): " << total / 1024 << " KiB live in " << blocks
+       << " blocks" << std::endl;
+    for (uint32_t i = 0; i < names.size (); ++i)
+      {
+        int64_t bytes = Counters ()[i].bytes.load (std::memory_order_relaxed);
+        os << "  " << std::left << std::setw (14) << names[i] << std::right
+           << std::setw (10) << Counters ()[i].blocks.load (std::memory_order_relaxed) << " blocks"
+           << std::setw (12) << bytes / 1024 << " KiB"
+           << std::setw (7) << std::fixed << std::setprecision (1) << (total > 0 ? 100.0 * bytes / total : 0)
+           << "%" << std::endl;
+        os.unsetf (std::ios::fixed);
+        os << std::setprecision (6);
+      }
+  }
+
+  /**
+   * \brief Write one CSV row per component.
+   * \param os the output stream
+   * \param phase first column of the rows
+   */
+  static void WriteReport (std::ostream &os, std::string phase)
+  {
+    const std::vector<std::string> &names = Names ();
+    for (uint32_t i = 0; i < names.size (); ++i)
+      {
+        int64_t bytes = Counters ()[i].bytes.load (std::memory_order_relaxed);
+        os << phase << "," << names[i] << "," << Counters ()[i].blocks.load (std::memory_order_relaxed)
+           << "," << bytes << std::endl;
+      }
+  }
+
+private:
+  /// Live blocks and bytes of a component.
+  struct Counter
+  {
+    std::atomic<int64_t> blocks;  //!< live blocks
+    std::atomic<int64_t> bytes;   //!< live bytes
+  };
+
+  static bool &Enabled (void)
+  {
+    static bool enabled = false;
+    return enabled;
+  }
+
+  static uint8_t &Current (void)
+  {
+    static thread_local uint8_t current = 0;
+    return current;
+  }
+
+  static Counter *Counters (void)
+  {
+    // Zero-initialized before any allocation
+    static Counter counters[MAX_COMPONENTS];
+    return counters;
+  }
+
+  static std::vector<std::string> &Names (void)
+  {
+    static std::vector<std::string> names (1, "other");
+    return names;
+  }
+};
+
+} // namespace ns3
+
+#endif /* MEMORY_ACCOUNTING_H */
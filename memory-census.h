@@ -0,0 +1,254 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef MEMORY_CENSUS_H
+#define MEMORY_CENSUS_H
+
+//
+// Heap bytes of the ns-3 objects of every node, by TypeId.
+//
+// MemoryAccounting (see memory-accounting.h) charges blocks to the
+// component being built when they are allocated; it cannot tell a wifi
+// PHY from its MAC, nor which node owns a block.  A census walks the
+// object graph of every node instead, as Config paths do: the node, its
+// aggregated objects, and every object reachable through their Pointer,
+// ObjectVector and ObjectMap attributes.  Each object is counted once,
+// under the TypeId of its instance, with the size of its heap block
+// read from the header written by the global operator new of
+// pooled-allocator.h.  An object reached from a single node is that
+// node's; one reached from several, such as a channel or the backbone
+// mobility model of a LAN, is shared.
+//
+// Only the block of each object is counted, not the blocks of the
+// containers it holds (routing tables, queues, maps of the wifi remote
+// station manager...), which stay in the MemoryAccounting components:
+// the census ranks the object types and measures the spread between
+// nodes, the accounting gives the totals.  The per-node figures are
+// the sums over the objects each node owns:
+//
+//   phase,type,objects,bytes,sharedObjects,sharedBytes
+//
+
+#include <stdint.h>
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/node.h"
+#include "ns3/node-container.h"
+#include "ns3/object.h"
+#include "ns3/object-ptr-container.h"
+#include "ns3/pointer.h"
+
+#include "pooled-allocator.h"
+
+namespace ns3 {
+
+/// Column names of the rows written by MemoryCensus::Write.
+static const char MEMORY_CENSUS_COLUMNS[] = "phase,type,objects,bytes,sharedObjects,sharedBytes";
+
+/**
+ * \brief Count the objects of every node and their heap bytes by TypeId.
+ */
+class MemoryCensus
+{
+public:
+  MemoryCensus ()
+    : m_sharedBytes (0)
+  {
+  }
+
+  /**
+   * \brief Walk the objects of the nodes, replacing the previous census.
+   * \param nodes the nodes
+   */
+  void Take (NodeContainer nodes)
+  {
+    m_types.clear ();
+    m_nodeBytes.assign (nodes.GetN (), 0);
+    m_sharedBytes = 0;
+    std::unordered_map<const Object *, int32_t> owners;
+    for (uint32_t i = 0; i < nodes.GetN (); ++i)
+      {
+        std::vector<Ptr<Object> > stack (1, nodes.Get (i));
+        while (!stack.empty ())
+          {
+            Ptr<Object> object = stack.back ();
+            stack.pop_back ();
+            std::unordered_map<const Object *, int32_t>::iterator o = owners.find (PeekPointer (object));
+            if (o != owners.end ())
+              {
+                if (o->second != static_cast<int32_t> (i))
+                  {
+                    o->second = -1;
+                  }
+                continue;
+              }
+            owners[PeekPointer (object)] = i;
+            Expand (object, stack);
+          }
+      }
+    for (std::unordered_map<const Object *, int32_t>::const_iterator o = owners.begin (); o != owners.end (); ++o)
+      {
+        uint64_t bytes = PooledAllocator::GetSize (dynamic_cast<const void *> (o->first));
+        Type &type = m_types[o->first->GetInstanceTypeId ().GetName ()];
+        ++type.objects;
+        type.bytes += bytes;
+        if (o->second < 0)
+          {
+            ++type.sharedObjects;
+            type.sharedBytes += bytes;
+            m_sharedBytes += bytes;
+          }
+        else
+          {
+            m_nodeBytes[o->second] += bytes;
+          }
+      }
+  }
+
+  /**
+   * \brief Print the types ranked by bytes and the bytes per node.
+   * \param os the output stream
+   * \param phase when the census was taken, e.g. "after build"
+   * \param rows number of types printed
+   */
+  void Print (std::ostream &os, std::string phase, uint32_t rows = 20) const
+  {
+    std::vector<std::pair<uint64_t, std::string> > order;
+    uint64_t objects = 0;
+    for (std::map<std::string, Type>::const_iterator t = m_types.begin (); t != m_types.end (); ++t)
+      {
+        order.push_back (std::make_pair (t->second.bytes, t->first));
+        objects += t->second.objects;
+      }
+    std::sort (order.rbegin (), order.rend ());
+    uint64_t owned = 0;
+    uint64_t max = 0;
+    for (uint32_t i = 0; i < m_nodeBytes.size (); ++i)
+      {
+        owned += m_nodeBytes[i];
+        max = std::max (max, m_nodeBytes[i]);
+      }
+    os << "MemoryCensus (" << phase << "): " << objects << " objects, "
+       << (owned + m_sharedBytes) / 1024 << " KiB in their own blocks; per node "
+       << (m_nodeBytes.empty () ? 0 : owned / m_nodeBytes.size ()) << " B mean, " << max << " B max, "
+       << m_sharedBytes / 1024 << " KiB shared" << std::endl;
+    for (uint32_t r = 0; r < order.size () && r < rows; ++r)
+      {
+        const Type &type = m_types.find (order[r].second)->second;
+        os << "  " << std::setw (10) << type.objects << " objects" << std::setw (12) << type.bytes / 1024 << " KiB"
+           << std::setw (10) << type.sharedObjects << " shared  " << order[r].second << std::endl;
+      }
+  }
+
+  /**
+   * \brief Write one CSV row per type.
+   * \param os the output stream
+   * \param phase first column of the rows
+   */
+  void Write (std::ostream &os, std::string phase) const
+  {
+    for (std::map<std::string, Type>::const_iterator t = m_types.begin (); t != m_types.end (); ++t)
+      {
+        os << phase << "," << t->first << "," << t->second.objects << "," << t->second.bytes << ","
+           << t->second.sharedObjects << "," << t->second.sharedBytes << std::endl;
+      }
+  }
+
+  /// \param node index of a node in the census \return bytes of the objects it owns
+  uint64_t GetNodeBytes (uint32_t node) const
+  {
+    return m_nodeBytes[node];
+  }
+
+private:
+  /// Objects and bytes of one TypeId.
+  struct Type
+  {
+    Type ()
+      : objects (0),
+        bytes (0),
+        sharedObjects (0),
+        sharedBytes (0)
+    {
+    }
+    uint64_t objects;        //!< objects of the type
+    uint64_t bytes;          //!< bytes of their blocks
+    uint64_t sharedObjects;  //!< those reached from several nodes
+    uint64_t sharedBytes;    //!< bytes of their blocks
+  };
+
+  /// Push the aggregated objects and the objects of the attributes of an object.
+  static void Expand (Ptr<Object> object, std::vector<Ptr<Object> > &stack)
+  {
+    Object::AggregateIterator aggregates = object->GetAggregateIterator ();
+    while (aggregates.HasNext ())
+      {
+        stack.push_back (ConstCast<Object> (aggregates.Next ()));
+      }
+    for (TypeId tid = object->GetInstanceTypeId (); ; tid = tid.GetParent ())
+      {
+        for (uint32_t i = 0; i < tid.GetAttributeN (); ++i)
+          {
+            struct TypeId::AttributeInformation info = tid.GetAttribute (i);
+            if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter ())
+              {
+                continue;
+              }
+            if (dynamic_cast<const PointerChecker *> (PeekPointer (info.checker)) != 0)
+              {
+                PointerValue pointer;
+                info.accessor->Get (PeekPointer (object), pointer);
+                Ptr<Object> target = pointer.Get<Object> ();
+                if (target != 0)
+                  {
+                    stack.push_back (target);
+                  }
+              }
+            else if (dynamic_cast<const ObjectPtrContainerChecker *> (PeekPointer (info.checker)) != 0)
+              {
+                ObjectPtrContainerValue container;
+                info.accessor->Get (PeekPointer (object), container);
+                for (ObjectPtrContainerValue::Iterator c = container.Begin (); c != container.End (); ++c)
+                  {
+                    if (c->second != 0)
+                      {
+                        stack.push_back (c->second);
+                      }
+                  }
+              }
+          }
+        if (tid == tid.GetParent ())
+          {
+            break;
+          }
+      }
+  }
+
+  std::map<std::string, Type> m_types;  //!< objects and bytes by TypeId name
+  std::vector<uint64_t> m_nodeBytes;    //!< bytes of the objects owned by each node
+  uint64_t m_sharedBytes;               //!< bytes of the objects shared by several nodes
+};
+
+} // namespace ns3
+
+#endif /* MEMORY_CENSUS_H */
@@ -0,0 +1,177 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Reader of the position files written by MobilityRecorder (see
+// mobility-recorder.h).  The records of one node, or of all of them,
+// within a time window are printed as CSV (node,time,x,y,z):
+//
+// ./waf --run "mobility-reader --input=taller1.mobr --node=3 --start=10 --stop=20"
+//
+// or as gnuplot data, one data set per node separated by two blank
+// lines, so that every trajectory can be plotted with "index":
+//
+// ./waf --run "mobility-reader --input=taller1.mobr --format=gnuplot --output=tracks.dat"
+// gnuplot> plot for [i=0:24] 'tracks.dat' index i using 3:4 with lines
+//
+// Compressed files (.gz, .zst) are decompressed on the fly.
+//
+
+#include <stdio.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("MobilityReader");
+
+namespace {
+
+/// One position record.
+struct Position
+{
+  int64_t time;  //!< simulation time (ns)
+  double x;      //!< x coordinate
+  double y;      //!< y coordinate
+  double z;      //!< z coordinate
+};
+
+/// \return true if all n bytes were read
+bool
+ReadAll (FILE *in, void *buffer, size_t n)
+{
+  return fread (buffer, 1, n, in) == n;
+}
+
+} // unnamed namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "taller1.mobr";
+  std::string output;
+  std::string format = "csv";
+  int32_t node = -1;
+  double start = 0;
+  double stop = 1e9;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("input", "position file written by MobilityRecorder", input);
+  cmd.AddValue ("output", "output file (default: standard output)", output);
+  cmd.AddValue ("format", "csv, or gnuplot (one data set per node)", format);
+  cmd.AddValue ("node", "node whose positions are printed (-1: all)", node);
+  cmd.AddValue ("start", "first simulation time (seconds) printed", start);
+  cmd.AddValue ("stop", "last simulation time (seconds) printed", stop);
+  cmd.Parse (argc, argv);
+  NS_ABORT_MSG_UNLESS (format == "csv" || format == "gnuplot", "unknown format " << format);
+
+  FILE *in;
+  bool pipe = false;
+  if (input.size () > 3 && input.compare (input.size () - 3, 3, ".gz") == 0)
+    {
+      in = popen (("gzip -dc '" + input + "'").c_str (), "r");
+      pipe = true;
+    }
+  else if (input.size () > 4 && input.compare (input.size () - 4, 4, ".zst") == 0)
+    {
+      in = popen (("zstd -dqc '" + input + "'").c_str (), "r");
+      pipe = true;
+    }
+  else
+    {
+      in = fopen (input.c_str (), "rb");
+    }
+  NS_ABORT_MSG_IF (in == 0, "cannot open " << input);
+  char magic[8];
+  NS_ABORT_MSG_UNLESS (ReadAll (in, magic, 8) && std::memcmp (magic, "MOBREC01", 8) == 0,
+                       input << " is not a MobilityRecorder file");
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      NS_ABORT_MSG_UNLESS (file.is_open (), "cannot open " << output);
+    }
+  std::ostream &os = output.empty () ? std::cout : file;
+  if (format == "csv")
+    {
+      os << "node,time,x,y,z" << std::endl;
+    }
+
+  int64_t first = static_cast<int64_t> (start * 1e9);
+  int64_t last = static_cast<int64_t> (stop * 1e9);
+  std::map<uint32_t, std::vector<Position> > tracks;
+  std::vector<uint32_t> nodes;
+  std::vector<int64_t> times;
+  std::vector<double> xs, ys, zs;
+  uint64_t records = 0;
+  uint32_t n;
+  while (ReadAll (in, &n, 4))
+    {
+      nodes.resize (n);
+      times.resize (n);
+      xs.resize (n);
+      ys.resize (n);
+      zs.resize (n);
+      NS_ABORT_MSG_UNLESS (n > 0
+                           && ReadAll (in, &nodes[0], n * 4) && ReadAll (in, &times[0], n * 8)
+                           && ReadAll (in, &xs[0], n * 8) && ReadAll (in, &ys[0], n * 8)
+                           && ReadAll (in, &zs[0], n * 8),
+                           input << ": truncated block");
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          if ((node >= 0 && nodes[i] != static_cast<uint32_t> (node)) || times[i] < first || times[i] > last)
+            {
+              continue;
+            }
+          ++records;
+          if (format == "csv")
+            {
+              os << nodes[i] << "," << times[i] / 1e9 << "," << xs[i] << "," << ys[i] << "," << zs[i] << "\n";
+            }
+          else
+            {
+              Position p = {times[i], xs[i], ys[i], zs[i]};
+              tracks[nodes[i]].push_back (p);
+            }
+        }
+    }
+  for (std::map<uint32_t, std::vector<Position> >::const_iterator t = tracks.begin (); t != tracks.end (); ++t)
+    {
+      os << "# node " << t->first << "\n";
+      for (std::vector<Position>::const_iterator p = t->second.begin (); p != t->second.end (); ++p)
+        {
+          os << t->first << " " << p->time / 1e9 << " " << p->x << " " << p->y << " " << p->z << "\n";
+        }
+      os << "\n\n";
+    }
+  if (pipe)
+    {
+      pclose (in);
+    }
+  else
+    {
+      fclose (in);
+    }
+  NS_LOG_UNCOND ("Read " << records << " positions from " << input);
+  return 0;
+}
@@ -0,0 +1,223 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef MOBILITY_RECORDER_H
+#define MOBILITY_RECORDER_H
+
+//
+// Binary replacement for the text mobility traces (CourseChange
+// printing and MobilityHelper::EnableAsciiAll).
+//
+// Every position is one fixed-size record of node id, simulation time
+// and x, y, z.  Records are buffered in columns and written as blocks
+// through a BinaryTraceWriter (see binary-trace-helper.h), so the event
+// loop never formats text nor waits on the disk.  The recorder connects
+// to the CourseChange trace of each mobility model directly, without
+// Config path matching; alternatively it samples the position of every
+// node at a fixed period, which bounds the file size whatever the
+// mobility model does.
+//
+// File layout, in host byte order: the 8-byte magic "MOBREC01", then
+// blocks of
+//
+//   uint32  n, number of records in the block
+//   uint32  node id        x n
+//   int64   time (ns)      x n
+//   double  x              x n
+//   double  y              x n
+//   double  z              x n
+//
+// mobility-reader prints the records of a file as CSV or gnuplot data.
+//
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+#include "binary-trace-helper.h"
+
+namespace ns3 {
+
+/**
+ * \brief Record node positions in a columnar binary file.
+ */
+class MobilityRecorder
+{
+public:
+  /// Records per block.
+  static const uint32_t BLOCK_RECORDS = 4096;
+  /// Bytes of one record in a block.
+  static const uint32_t RECORD_SIZE = 4 + 8 + 3 * 8;
+
+  MobilityRecorder ()
+    : m_compression ("none"),
+      m_period (Seconds (0)),
+      m_records (0)
+  {
+  }
+
+  ~MobilityRecorder ()
+  {
+    Close ();
+  }
+
+  /// \param compression "none", "gzip" or "zstd"
+  void SetCompression (std::string compression)
+  {
+    m_compression = compression;
+  }
+
+  /**
+   * \param period time between two samples of every node; zero records
+   *        every course change instead
+   */
+  void SetSamplingPeriod (Time period)
+  {
+    m_period = period;
+  }
+
+  /**
+   * \brief Record the positions of the given nodes.
+   * \param filename the record file
+   * \param nodes nodes with a mobility model
+   */
+  void Install (std::string filename, NodeContainer nodes)
+  {
+    m_writer = Create<BinaryTraceWriter> (filename, m_compression);
+    std::memcpy (m_writer->Reserve (8), "MOBREC01", 8);
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+      {
+        Ptr<MobilityModel> model = (*i)->GetObject<MobilityModel> ();
+        NS_ABORT_MSG_IF (model == 0, "MobilityRecorder: node " << (*i)->GetId () << " has no mobility model");
+        m_nodes.push_back ((*i)->GetId ());
+        m_models.push_back (model);
+        if (m_period.IsZero ())
+          {
+            model->TraceConnectWithoutContext ("CourseChange",
+                                               MakeBoundCallback (&MobilityRecorder::CourseChange, this, (*i)->GetId ()));
+          }
+      }
+    if (!m_period.IsZero ())
+      {
+        m_sample = Simulator::ScheduleNow (&MobilityRecorder::Sample, this);
+      }
+  }
+
+  /// \brief Write the buffered records and close the file.
+  void Close (void)
+  {
+    if (m_writer == 0)
+      {
+        return;
+      }
+    m_sample.Cancel ();
+    Flush ();
+    m_writer->Close ();
+    m_writer = 0;
+  }
+
+  /// \return number of records so far
+  uint64_t GetRecords (void) const
+  {
+    return m_records;
+  }
+
+private:
+  static void CourseChange (MobilityRecorder *recorder, uint32_t node, Ptr<const MobilityModel> model)
+  {
+    recorder->Record (node, model->GetPosition ());
+  }
+
+  void Sample (void)
+  {
+    for (uint32_t i = 0; i < m_models.size (); ++i)
+      {
+        Record (m_nodes[i], m_models[i]->GetPosition ());
+      }
+    m_sample = Simulator::Schedule (m_period, &MobilityRecorder::Sample, this);
+  }
+
+  void Record (uint32_t node, const Vector &position)
+  {
+    if (m_writer == 0)
+      {
+        return;
+      }
+    m_node.push_back (node);
+    m_time.push_back (Simulator::Now ().GetNanoSeconds ());
+    m_x.push_back (position.x);
+    m_y.push_back (position.y);
+    m_z.push_back (position.z);
+    ++m_records;
+    if (m_node.size () == BLOCK_RECORDS)
+      {
+        Flush ();
+      }
+  }
+
+  /// Write the buffered columns as one block.
+  void Flush (void)
+  {
+    uint32_t n = m_node.size ();
+    if (n == 0)
+      {
+        return;
+      }
+    uint8_t *p = m_writer->Reserve (4 + n * RECORD_SIZE);
+    std::memcpy (p, &n, 4);
+    p += 4;
+    std::memcpy (p, &m_node[0], n * 4);
+    p += n * 4;
+    std::memcpy (p, &m_time[0], n * 8);
+    p += n * 8;
+    std::memcpy (p, &m_x[0], n * 8);
+    p += n * 8;
+    std::memcpy (p, &m_y[0], n * 8);
+    p += n * 8;
+    std::memcpy (p, &m_z[0], n * 8);
+    m_node.clear ();
+    m_time.clear ();
+    m_x.clear ();
+    m_y.clear ();
+    m_z.clear ();
+  }
+
+  std::string m_compression;                   //!< compression of the file
+  Time m_period;                               //!< sampling period, zero for course changes
+  Ptr<BinaryTraceWriter> m_writer;             //!< the record file
+  std::vector<uint32_t> m_nodes;               //!< recorded node ids
+  std::vector<Ptr<MobilityModel> > m_models;   //!< their mobility models
+  EventId m_sample;                            //!< next sample
+  std::vector<uint32_t> m_node;                //!< buffered node ids
+  std::vector<int64_t> m_time;                 //!< buffered times (ns)
+  std::vector<double> m_x;                     //!< buffered x
+  std::vector<double> m_y;                     //!< buffered y
+  std::vector<double> m_z;                     //!< buffered z
+  uint64_t m_records;                          //!< records so far
+};
+
+} // namespace ns3
+
+#endif /* MOBILITY_RECORDER_H */
@@ -0,0 +1,293 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+//
+// Helper that expands a grid of parameter values into its cartesian
+// product and runs every point of the grid in its own child process,
+// keeping at most "jobs" children alive at a time.
+//
+// The ns-3 simulator is a process-wide singleton, so independent runs
+// can only overlap as separate processes.  Each child receives the
+// values of its grid point and an output stream; the rows it writes are
+// collected by the parent and merged, in grid order, into one summary
+// table whose leading columns are the values of the swept parameters.
+//
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ns3/callback.h"
+#include "ns3/abort.h"
+
+namespace ns3 {
+
+/**
+ * \brief Run a scenario over a grid of parameter values with a bounded
+ * pool of worker processes.
+ */
+class ParameterSweep
+{
+public:
+  /// Values of the swept parameters for one run, keyed by parameter name.
+  typedef std::map<std::string, std::string> Point;
+  /// Callback run in the child process for every point of the grid.
+  typedef Callback<void, const Point &, std::ostream &> RunCallback;
+
+  ParameterSweep ()
+    : m_jobs (DefaultJobs ()),
+      m_summaryFile ("sweep-summary.csv")
+  {
+  }
+
+  /**
+   * \brief Add a parameter to the grid.
+   * \param name parameter name, used as column name and in run labels
+   * \param values comma separated values; integer ranges may be given
+   *        as "lo:hi", e.g. "1:8" or "125,250,500"
+   *
+   * An empty value list is ignored, so unset command-line options do not
+   * add an axis.
+   */
+  void AddAxis (std::string name, std::string values)
+  {
+    std::vector<std::string> list = ParseValues (values);
+    if (list.empty ())
+      {
+        return;
+      }
+    m_axes.push_back (std::make_pair (name, list));
+  }
+
+  /// \return true if at least one axis was added
+  bool IsEnabled (void) const
+  {
+    return !m_axes.empty ();
+  }
+
+  /// \param jobs maximum number of runs in flight; 0 means one per core
+  void SetJobs (uint32_t jobs)
+  {
+    m_jobs = jobs == 0 ? DefaultJobs () : jobs;
+  }
+
+  /// \param filename file receiving the merged summary table
+  void SetSummaryFile (std::string filename)
+  {
+    m_summaryFile = filename;
+  }
+
+  /// \param columns comma separated names of the columns written by a run
+  void SetColumns (std::string columns)
+  {
+    m_columns = columns;
+  }
+
+  /// \return the cartesian product of all axes, in row-major order
+  std::vector<Point> GetPoints (void) const
+  {
+    std::vector<Point> points (1);
+    for (std::vector<Axis>::const_iterator a = m_axes.begin (); a != m_axes.end (); ++a)
+      {
+        std::vector<Point> next;
+        for (std::vector<Point>::const_iterator p = points.begin (); p != points.end (); ++p)
+          {
+            for (std::vector<std::string>::const_iterator v = a->second.begin (); v != a->second.end (); ++v)
+              {
+                Point point = *p;
+                point[a->first] = *v;
+                next.push_back (point);
+              }
+          }
+        points.swap (next);
+      }
+    return points;
+  }
+
+  /**
+   * \param point a grid point
+   * \return a file-name friendly label such as "distance125-run2"
+   */
+  std::string GetLabel (const Point &point) const
+  {
+    std::ostringstream oss;
+    for (std::vector<Axis>::const_iterator a = m_axes.begin (); a != m_axes.end (); ++a)
+      {
+        if (a != m_axes.begin ())
+          {
+            oss << "-";
+          }
+        oss << a->first << point.find (a->first)->second;
+      }
+    return oss.str ();
+  }
+
+  /**
+   * \brief Run every point of the grid and write the merged summary.
+   * \param runOne callback executed in a child process for each point
+   * \return the number of runs that did not exit successfully
+   */
+  uint32_t Run (RunCallback runOne)
+  {
+    std::vector<Point> points = GetPoints ();
+    std::map<pid_t, uint32_t> running;
+    std::vector<int> status (points.size (), -1);
+    uint32_t next = 0;
+
+    std::cout << "Sweeping " << points.size () << " runs on "
+              << m_jobs << " workers" << std::endl;
+    std::cout.flush ();
+    while (next < points.size () || !running.empty ())
+      {
+        while (next < points.size () && running.size () < m_jobs)
+          {
+            pid_t pid = fork ();
+            NS_ABORT_MSG_IF (pid < 0, "ParameterSweep: fork failed");
+            if (pid == 0)
+              {
+                std::ofstream part (GetPartFile (next).c_str ());
+                runOne (points[next], part);
+                part.close ();
+                std::cout.flush ();
+                _exit (part.fail () ? 1 : 0);
+              }
+            running[pid] = next++;
+          }
+        int wstatus;
+        pid_t done = waitpid (-1, &wstatus, 0);
+        if (done < 0)
+          {
+            break;
+          }
+        std::map<pid_t, uint32_t>::iterator it = running.find (done);
+        if (it == running.end ())
+          {
+            continue;
+          }
+        status[it->second] = (WIFEXITED (wstatus) && WEXITSTATUS (wstatus) == 0) ? 0 : 1;
+        std::cout << "Run " << GetLabel (points[it->second])
+                  << (status[it->second] == 0 ? " done" : " FAILED") << std::endl;
+        running.erase (it);
+      }
+
+    return Merge (points, status);
+  }
+
+private:
+  /// A parameter name with its list of values.
+  typedef std::pair<std::string, std::vector<std::string> > Axis;
+
+  static uint32_t DefaultJobs (void)
+  {
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<uint32_t> (n) : 1;
+  }
+
+  static std::vector<std::string> ParseValues (std::string values)
+  {
+    std::vector<std::string> list;
+    std::istringstream iss (values);
+    std::string item;
+    while (std::getline (iss, item, ','))
+      {
+        if (item.empty ())
+          {
+            continue;
+          }
+        std::string::size_type colon = item.find (':');
+        if (colon == std::string::npos)
+          {
+            list.push_back (item);
+            continue;
+          }
+        long lo = std::atol (item.substr (0, colon).c_str ());
+        long hi = std::atol (item.substr (colon + 1).c_str ());
+        NS_ABORT_MSG_IF (hi < lo, "ParameterSweep: empty range " << item);
+        for (long v = lo; v <= hi; ++v)
+          {
+            std::ostringstream oss;
+            oss << v;
+            list.push_back (oss.str ());
+          }
+      }
+    return list;
+  }
+
+  std::string GetPartFile (uint32_t index) const
+  {
+    std::ostringstream oss;
+    oss << m_summaryFile << ".part" << index;
+    return oss.str ();
+  }
+
+  uint32_t Merge (const std::vector<Point> &points, const std::vector<int> &status) const
+  {
+    std::ofstream out (m_summaryFile.c_str ());
+    for (std::vector<Axis>::const_iterator a = m_axes.begin (); a != m_axes.end (); ++a)
+      {
+        out << a->first << ",";
+      }
+    out << m_columns << std::endl;
+
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < points.size (); ++i)
+      {
+        std::string partFile = GetPartFile (i);
+        if (status[i] != 0)
+          {
+            ++failed;
+          }
+        std::ostringstream key;
+        for (std::vector<Axis>::const_iterator a = m_axes.begin (); a != m_axes.end (); ++a)
+          {
+            key << points[i].find (a->first)->second << ",";
+          }
+        std::ifstream part (partFile.c_str ());
+        std::string line;
+        while (std::getline (part, line))
+          {
+            out << key.str () << line << std::endl;
+          }
+        part.close ();
+        std::remove (partFile.c_str ());
+      }
+    std::cout << "Sweep summary written to " << m_summaryFile
+              << " (" << failed << " failed runs)" << std::endl;
+    return failed;
+  }
+
+  std::vector<Axis> m_axes;   //!< swept parameters, outermost first
+  uint32_t m_jobs;            //!< maximum number of concurrent runs
+  std::string m_summaryFile;  //!< merged summary table
+  std::string m_columns;      //!< header of the per-run columns
+};
+
+} // namespace ns3
+
+#endif /* PARAMETER_SWEEP_H */
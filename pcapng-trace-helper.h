@@ -0,0 +1,296 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PCAPNG_TRACE_HELPER_H
+#define PCAPNG_TRACE_HELPER_H
+
+//
+// Capture of many wifi devices into a single pcapng file.
+//
+// WifiPhyHelper::EnablePcap opens one pcap file per device and captures
+// every frame in full.  This helper writes one section with an interface
+// description block per device (named "node<N>-dev<D>", nanosecond
+// timestamps) and an enhanced packet block per transmitted or received
+// frame, through one large stdio buffer.  A snap length limits how many
+// bytes of each 802.11 frame are kept: 64 bytes hold the 802.11, LLC,
+// IPv4 and UDP headers of a data frame.  The radiotap header is always
+// captured in full.
+//
+// tcpdump, tshark and wireshark read the file directly, e.g.
+//
+// tshark -r taller1.pcapng -Y "frame.interface_name == node3-dev0"
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-mode.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-phy-state-helper.h"
+
+namespace ns3 {
+
+/// Largest radiotap header written by WriteRadiotapHeader.
+static const uint32_t RADIOTAP_MAX_SIZE = 23;
+
+/**
+ * \brief Write a radiotap header with TSFT, flags, rate, channel and, for
+ * received frames, the SNR as dB antenna signal.
+ * \param buf where to write, at least RADIOTAP_MAX_SIZE bytes
+ * \param timeNs capture time (ns)
+ * \param rate data rate in units of 500 kb/s
+ * \param cck true for DSSS/CCK modes, false for OFDM
+ * \param freq channel frequency (MHz)
+ * \param rx true for a received frame
+ * \param snr SNR of a received frame (dB)
+ * \return the size of the header
+ */
+inline uint32_t
+WriteRadiotapHeader (uint8_t *buf, int64_t timeNs, uint8_t rate, bool cck,
+                     uint16_t freq, bool rx, int8_t snr)
+{
+  uint16_t length = rx ? 23 : 22;
+  uint32_t present = 0x0000000f | (rx ? (1 << 12) : 0);
+  uint64_t tsft = timeNs / 1000;
+  uint16_t channelFlags = (freq < 3000 ? 0x0080 : 0x0100) | (cck ? 0x0020 : 0x0040);
+  std::memset (buf, 0, length);
+  std::memcpy (buf + 2, &length, 2);
+  std::memcpy (buf + 4, &present, 4);
+  std::memcpy (buf + 8, &tsft, 8);
+  buf[16] = 0x10; // frame includes FCS
+  buf[17] = rate;
+  std::memcpy (buf + 18, &freq, 2);
+  std::memcpy (buf + 20, &channelFlags, 2);
+  if (rx)
+    {
+      buf[22] = static_cast<uint8_t> (snr);
+    }
+  return length;
+}
+
+/**
+ * \brief Capture the frames of wifi devices into one pcapng file.
+ */
+class PcapngTraceHelper
+{
+public:
+  PcapngTraceHelper ()
+    : m_snapLen (0)
+  {
+  }
+
+  ~PcapngTraceHelper ()
+  {
+    Close ();
+  }
+
+  /// \param snapLen bytes of each 802.11 frame to keep; 0 keeps all of it
+  void SetSnapLen (uint32_t snapLen)
+  {
+    m_snapLen = snapLen;
+  }
+
+  /**
+   * \brief Capture the given wifi devices, one interface each.
+   * \param filename the pcapng file
+   * \param devices the devices to capture
+   */
+  void EnableAll (std::string filename, NetDeviceContainer devices)
+  {
+    m_file = Create<File> ();
+    m_file->f = fopen (filename.c_str (), "wb");
+    NS_ABORT_MSG_IF (m_file->f == 0, "PcapngTraceHelper: cannot open " << filename);
+    m_file->buffer.resize (1 << 20);
+    setvbuf (m_file->f, &m_file->buffer[0], _IOFBF, m_file->buffer.size ());
+    m_file->snapLen = m_snapLen;
+    WriteSectionHeader ();
+
+    uint32_t interface = 0;
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i, ++interface)
+      {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+        NS_ABORT_MSG_IF (device == 0, "PcapngTraceHelper: not a WifiNetDevice");
+        Ptr<Context> ctx = Create<Context> ();
+        ctx->file = m_file;
+        ctx->interface = interface;
+        ctx->width = device->GetPhy ()->GetChannelWidth ();
+        ctx->freq = device->GetPhy ()->GetFrequency ();
+        ctx->modeUid = ~0u;
+        ctx->rate = 0;
+        ctx->cck = false;
+        WriteInterfaceDescription (device->GetNode ()->GetId (), device->GetIfIndex ());
+        Ptr<WifiPhyStateHelper> state = device->GetPhy ()->GetState ();
+        state->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&PcapngTraceHelper::TxSink, ctx));
+        state->TraceConnectWithoutContext ("RxOk", MakeBoundCallback (&PcapngTraceHelper::RxSink, ctx));
+      }
+  }
+
+  /// \brief Flush and close the pcapng file.
+  void Close (void)
+  {
+    if (m_file != 0 && m_file->f != 0)
+      {
+        fclose (m_file->f);
+        m_file->f = 0;
+      }
+    m_file = 0;
+  }
+
+private:
+  /// The pcapng file shared by all the interfaces.
+  struct File : public SimpleRefCount<File>
+  {
+    FILE *f;                    //!< the file
+    std::vector<char> buffer;   //!< stdio buffer
+    uint32_t snapLen;           //!< bytes of each frame to keep, 0 for all
+  };
+
+  /// What a trace sink needs to know about its device.
+  struct Context : public SimpleRefCount<Context>
+  {
+    Ptr<File> file;      //!< the pcapng file
+    uint32_t interface;  //!< pcapng interface id
+    uint16_t width;      //!< channel width (MHz)
+    uint16_t freq;       //!< channel frequency (MHz)
+    uint32_t modeUid;    //!< uid of the last mode seen
+    uint8_t rate;        //!< its rate, in units of 500 kb/s
+    bool cck;            //!< whether it is a DSSS/CCK mode
+  };
+
+  static void Write32 (FILE *f, uint32_t v)
+  {
+    fwrite (&v, 4, 1, f);
+  }
+
+  void WriteSectionHeader (void)
+  {
+    FILE *f = m_file->f;
+    int64_t sectionLength = -1;
+    Write32 (f, 0x0A0D0D0A);
+    Write32 (f, 28);
+    Write32 (f, 0x1A2B3C4D);
+    uint16_t version[2] = {1, 0};
+    fwrite (version, 2, 2, f);
+    fwrite (&sectionLength, 8, 1, f);
+    Write32 (f, 28);
+  }
+
+  void WriteInterfaceDescription (uint32_t node, uint32_t device)
+  {
+    FILE *f = m_file->f;
+    char name[32];
+    int nameLen = snprintf (name, sizeof (name), "node%u-dev%u", node, device);
+    uint32_t namePadded = (nameLen + 3) & ~3u;
+    uint32_t total = 20 + 4 + namePadded + 8 + 4;
+    uint16_t linkType[2] = {127, 0}; // LINKTYPE_IEEE802_11_RADIOTAP
+    Write32 (f, 0x00000001);
+    Write32 (f, total);
+    fwrite (linkType, 2, 2, f);
+    Write32 (f, m_file->snapLen == 0 ? 0 : m_file->snapLen + RADIOTAP_MAX_SIZE);
+    // if_name
+    uint16_t option[2] = {2, static_cast<uint16_t> (nameLen)};
+    fwrite (option, 2, 2, f);
+    std::memset (name + nameLen, 0, sizeof (name) - nameLen);
+    fwrite (name, 1, namePadded, f);
+    // if_tsresol: nanoseconds
+    option[0] = 9;
+    option[1] = 1;
+    fwrite (option, 2, 2, f);
+    uint8_t resolution[4] = {9, 0, 0, 0};
+    fwrite (resolution, 1, 4, f);
+    // opt_endofopt
+    Write32 (f, 0);
+    Write32 (f, total);
+  }
+
+  static void Capture (Ptr<Context> ctx, Ptr<const Packet> p, WifiMode mode, bool rx, int8_t snr)
+  {
+    FILE *f = ctx->file->f;
+    if (f == 0)
+      {
+        return;
+      }
+    if (mode.GetUid () != ctx->modeUid)
+      {
+        ctx->modeUid = mode.GetUid ();
+        ctx->rate = static_cast<uint8_t> (mode.GetDataRate (ctx->width) / 500000);
+        ctx->cck = mode.GetModulationClass () == WIFI_MOD_CLASS_DSSS
+          || mode.GetModulationClass () == WIFI_MOD_CLASS_HR_DSSS;
+      }
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    uint8_t frame[RADIOTAP_MAX_SIZE + 256];
+    uint32_t radiotap = WriteRadiotapHeader (frame, now, ctx->rate, ctx->cck, ctx->freq, rx, snr);
+    uint32_t size = p->GetSize ();
+    uint32_t snapLen = ctx->file->snapLen;
+    uint32_t captured = (snapLen == 0 || size < snapLen) ? size : snapLen;
+    std::vector<uint8_t> large;
+    uint8_t *data = frame;
+    if (radiotap + captured > sizeof (frame))
+      {
+        large.resize (radiotap + captured);
+        std::memcpy (&large[0], frame, radiotap);
+        data = &large[0];
+      }
+    p->CopyData (data + radiotap, captured);
+    uint32_t length = radiotap + captured;
+    uint32_t padded = (length + 3) & ~3u;
+    uint32_t total = 28 + padded + 4;
+    Write32 (f, 0x00000006);
+    Write32 (f, total);
+    Write32 (f, ctx->interface);
+    Write32 (f, static_cast<uint32_t> (static_cast<uint64_t> (now) >> 32));
+    Write32 (f, static_cast<uint32_t> (now));
+    Write32 (f, length);
+    Write32 (f, radiotap + size);
+    fwrite (data, 1, length, f);
+    uint32_t zero = 0;
+    fwrite (&zero, 1, padded - length, f);
+    Write32 (f, total);
+  }
+
+  static void TxSink (Ptr<Context> ctx, Ptr<const Packet> p, WifiMode mode,
+                      WifiPreamble preamble, uint8_t txLevel)
+  {
+    Capture (ctx, p, mode, false, 0);
+  }
+
+  static void RxSink (Ptr<Context> ctx, Ptr<const Packet> p, double snr,
+                      WifiMode mode, WifiPreamble preamble)
+  {
+    double snrDb = 10 * std::log10 (snr);
+    Capture (ctx, p, mode, true, static_cast<int8_t> (std::max (-128.0, std::min (127.0, snrDb))));
+  }
+
+  uint32_t m_snapLen;  //!< bytes of each 802.11 frame to keep
+  Ptr<File> m_file;    //!< the pcapng file in use
+};
+
+} // namespace ns3
+
+#endif /* PCAPNG_TRACE_HELPER_H */
@@ -0,0 +1,446 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef POOLED_ALLOCATOR_H
+#define POOLED_ALLOCATOR_H
+
+//
+// Size-class pool for the per-packet allocations.
+//
+// Every packet sent by an OnOff application costs a handful of heap
+// allocations: the Packet object, its byte buffer and tag lists, and
+// the copies made for every receiver.  Packet is not ours to give a
+// class-specific operator new, so the pool sits behind the global one
+// but only serves the size classes of packets: LearnSizes runs a
+// callback that builds a sample packet and marks the 16-byte size class
+// of every block it allocates, up to 2 KiB.  Every other allocation
+// goes straight to malloc.
+//
+// Pooled blocks come from per-thread free lists refilled from 64 KiB
+// slabs.  Each block carries a 16-byte header with its size class and
+// the pool of the thread that carved it; a block freed by another
+// thread, e.g. the writer thread of binary-trace-helper.h, is pushed
+// onto a lock-free list of its own pool, which that pool drains when
+// its free list runs out.  The pool is off until
+// PooledAllocator::Enable (true) is called, so it can be switched from
+// the command line; blocks allocated before or after the switch are
+// freed correctly either way.  The header also records the component
+// and size of the block for MemoryAccounting (see memory-accounting.h),
+// whether or not the pool is on.
+//
+// The global allocator is only replaced in a build configured with
+//
+//   CXXFLAGS="-DPOOLED_ALLOCATOR=1" ./waf configure
+//
+// since the header and the out-of-line calls cost every allocation of
+// the program, pool or not.  Otherwise the stock allocator is used, and
+// the pool, MemoryAccounting and MemoryCensus are unavailable
+// (IsInstalled).  The replaceable global allocation functions are only
+// defined in the translation unit that defines
+// POOLED_ALLOCATOR_DEFINE_GLOBAL_NEW before including this header, the
+// scenario's main file; the scratch programs are single files, so no
+// other .cc can hold them.
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <ostream>
+
+#include "ns3/callback.h"
+#include "ns3/llc-snap-header.h"
+#include "ns3/packet.h"
+#include "ns3/socket.h"
+
+#include "memory-accounting.h"
+
+#ifndef POOLED_ALLOCATOR
+#define POOLED_ALLOCATOR 0 // stock global allocator
+#endif
+
+namespace ns3 {
+
+/**
+ * \brief Per-thread size-class pool of the per-packet allocations, used
+ * by the global operator new.
+ */
+class PooledAllocator
+{
+public:
+  /// Counters of the calling thread.
+  struct Stats
+  {
+    uint64_t hits;      //!< blocks served from a free list
+    uint64_t misses;    //!< blocks carved from a new slab
+    uint64_t remote;    //!< blocks freed to the pools of other threads
+    uint64_t other;     //!< blocks of sizes not pooled, handed to malloc
+    uint64_t frees;     //!< blocks returned to a free list
+    uint64_t slabs;     //!< slabs allocated
+  };
+
+  /// \return true if the build replaces the global allocator with this one
+  static bool IsInstalled (void)
+  {
+    return POOLED_ALLOCATOR != 0;
+  }
+
+  /// \param enabled whether new allocations of the pooled sizes are served by the pool
+  static void Enable (bool enabled)
+  {
+    Enabled () = enabled;
+  }
+
+  /**
+   * \brief Pool the size classes of every block allocated by a callback,
+   * e.g. one that creates and copies a packet of the scenario's size.
+   * \param sample the callback
+   * \return the number of size classes pooled
+   */
+  static uint32_t LearnSizes (Callback<void> sample)
+  {
+    Learning () = true;
+    sample ();
+    Learning () = false;
+    uint32_t n = 0;
+    for (std::size_t c = 1; c < N_CLASSES; ++c)
+      {
+        n += Pooled (c) ? 1 : 0;
+      }
+    return n;
+  }
+
+  /**
+   * \brief Pool the size classes of a packet of the scenario: the
+   * Packet, its buffer once headers are added, a copy and a tag.
+   * \param payloadSize size of the application payload
+   * \return the number of size classes pooled
+   */
+  static uint32_t LearnPacketSizes (uint32_t payloadSize)
+  {
+    return LearnSizes (MakeBoundCallback (&SamplePacket, payloadSize));
+  }
+
+  /// \return the counters of the calling thread
+  static const Stats &GetStats (void)
+  {
+    return GetPool ()->stats;
+  }
+
+  /**
+   * \brief Print the counters of the calling thread.
+   * \param os the output stream
+   */
+  static void PrintStats (std::ostream &os)
+  {
+    const Stats &s = GetStats ();
+    uint64_t pooled = s.hits + s.misses;
+    os << "PooledAllocator: " << pooled << " packet-sized allocations, "
+       << s.hits << " from the pool (" << (pooled > 0 ? 100.0 * s.hits / pooled : 0)
+       << "% hit rate, malloc calls avoided), " << s.misses << " carved from "
+       << s.slabs << " slabs, " << s.remote << " freed to other threads' pools; "
+       << s.other << " other allocations left to malloc" << std::endl;
+  }
+
+  /// \param size requested size \return the block, or 0 if out of memory
+  static __attribute__ ((noinline)) void *Allocate (std::size_t size)
+  {
+    std::size_t c = (size + GRANULE - 1) / GRANULE;
+    if (c == 0)
+      {
+        c = 1;
+      }
+    if (c < N_CLASSES && Learning ())
+      {
+        Pooled (c) = true;
+      }
+    if (!Enabled () || c >= N_CLASSES || !Pooled (c))
+      {
+        uint8_t *raw = static_cast<uint8_t *> (malloc (size + HEADER));
+        if (raw == 0)
+          {
+            return 0;
+          }
+        raw[0] = LARGE;
+        *reinterpret_cast<uint64_t *> (raw + 8) = size;
+        Account (raw, size);
+        if (Enabled ())
+          {
+            ++GetPool ()->stats.other;
+          }
+        return raw + HEADER;
+      }
+    Pool *pool = GetPool ();
+    FreeBlock *block = pool->lists[c];
+    if (block == 0)
+      {
+        block = pool->remote[c].exchange (0, std::memory_order_acquire);
+      }
+    if (block != 0)
+      {
+        pool->lists[c] = block->next;
+        ++pool->stats.hits;
+      }
+    else
+      {
+        block = Refill (pool, c);
+        if (block == 0)
+          {
+            return 0;
+          }
+        ++pool->stats.misses;
+      }
+    uint8_t *raw = reinterpret_cast<uint8_t *> (block);
+    raw[0] = static_cast<uint8_t> (c);
+    Account (raw, c * GRANULE);
+    return raw + HEADER;
+  }
+
+  /**
+   * \param p a block returned by Allocate
+   * \return its usable size, from its header
+   */
+  static std::size_t GetSize (const void *p)
+  {
+    const uint8_t *raw = static_cast<const uint8_t *> (p) - HEADER;
+    return raw[0] == LARGE ? *reinterpret_cast<const uint64_t *> (raw + 8) : raw[0] * GRANULE;
+  }
+
+  /// \param p a block returned by Allocate, or 0
+  static __attribute__ ((noinline)) void Deallocate (void *p)
+  {
+    if (p == 0)
+      {
+        return;
+      }
+    uint8_t *raw = static_cast<uint8_t *> (p) - HEADER;
+    std::size_t c = raw[0];
+    if (raw[1] != MemoryAccounting::UNTRACKED)
+      {
+        MemoryAccounting::Add (raw[1], -static_cast<int64_t> (c == LARGE
+                                                              ? *reinterpret_cast<uint64_t *> (raw + 8)
+                                                              : c * GRANULE));
+      }
+    if (c == LARGE)
+      {
+        free (raw);
+        return;
+      }
+    Pool *owner = *reinterpret_cast<Pool **> (raw + 8);
+    FreeBlock *block = reinterpret_cast<FreeBlock *> (raw);
+    Pool *pool = GetPool ();
+    if (owner == pool)
+      {
+        block->next = pool->lists[c];
+        pool->lists[c] = block;
+      }
+    else
+      {
+        // Back to the pool that carved it, which drains it when it runs out
+        ++pool->stats.remote;
+        block->next = owner->remote[c].load (std::memory_order_relaxed);
+        while (!owner->remote[c].compare_exchange_weak (block->next, block, std::memory_order_release,
+                                                        std::memory_order_relaxed))
+          {
+          }
+      }
+    ++pool->stats.frees;
+  }
+
+private:
+  static const std::size_t HEADER = 16;       //!< header before each block
+  static const std::size_t GRANULE = 16;      //!< size class step
+  static const std::size_t N_CLASSES = 129;   //!< size classes up to 2 KiB (class 0 unused)
+  static const std::size_t SLAB = 64 * 1024;  //!< refill size
+  static const uint8_t LARGE = 0xff;          //!< header of malloc'ed blocks
+
+  /// A block in a free list; overlays the size class of the block header.
+  struct FreeBlock
+  {
+    FreeBlock *next;  //!< next free block of the same class
+  };
+
+  /// Free lists and counters of one thread; never freed, since blocks
+  /// may outlive their thread.
+  struct Pool
+  {
+    FreeBlock *lists[N_CLASSES];                     //!< blocks freed by the owner
+    std::atomic<FreeBlock *> remote[N_CLASSES];      //!< blocks freed by other threads
+    Stats stats;                                     //!< counters
+  };
+
+  static bool &Enabled (void)
+  {
+    static bool enabled = false;
+    return enabled;
+  }
+
+  static void SamplePacket (uint32_t payloadSize)
+  {
+    Ptr<Packet> packet = Create<Packet> (payloadSize);
+    LlcSnapHeader llc;
+    for (uint32_t i = 0; i < 8; ++i)
+      {
+        // About the UDP, IPv4, LLC and MAC headers
+        packet->AddHeader (llc);
+      }
+    SocketIpTtlTag ttl;
+    packet->AddPacketTag (ttl);
+    Ptr<Packet> copy = packet->Copy ();
+    copy->RemoveHeader (llc);
+  }
+
+  static bool &Learning (void)
+  {
+    static thread_local bool learning = false;
+    return learning;
+  }
+
+  static bool &Pooled (std::size_t c)
+  {
+    static bool pooled[N_CLASSES];
+    return pooled[c];
+  }
+
+  /// Record the component of a block in its header.
+  static void Account (uint8_t *raw, std::size_t bytes)
+  {
+    if (!MemoryAccounting::IsEnabled ())
+      {
+        raw[1] = MemoryAccounting::UNTRACKED;
+        return;
+      }
+    raw[1] = MemoryAccounting::GetCurrent ();
+    MemoryAccounting::Add (raw[1], bytes);
+  }
+
+  static Pool *GetPool (void)
+  {
+    static thread_local Pool *pool = 0;
+    if (pool == 0)
+      {
+        // calloc: zeroed lists and counters, and no recursion into operator new
+        pool = static_cast<Pool *> (calloc (1, sizeof (Pool)));
+        if (pool == 0)
+          {
+            abort ();
+          }
+      }
+    return pool;
+  }
+
+  /// Carve a new slab into blocks of class c owned by a pool; return one of them.
+  static FreeBlock *Refill (Pool *pool, std::size_t c)
+  {
+    std::size_t blockSize = HEADER + c * GRANULE;
+    uint8_t *slab = static_cast<uint8_t *> (malloc (SLAB));
+    if (slab == 0)
+      {
+        return 0;
+      }
+    ++pool->stats.slabs;
+    for (std::size_t off = 0; off + blockSize <= SLAB; off += blockSize)
+      {
+        *reinterpret_cast<Pool **> (slab + off + 8) = pool;
+      }
+    for (std::size_t off = blockSize; off + blockSize <= SLAB; off += blockSize)
+      {
+        FreeBlock *block = reinterpret_cast<FreeBlock *> (slab + off);
+        block->next = pool->lists[c];
+        pool->lists[c] = block;
+      }
+    return reinterpret_cast<FreeBlock *> (slab);
+  }
+};
+
+} // namespace ns3
+
+#if defined (POOLED_ALLOCATOR_DEFINE_GLOBAL_NEW) && POOLED_ALLOCATOR
+
+void *
+operator new (std::size_t size)
+{
+  for (;;)
+    {
+      void *p = ns3::PooledAllocator::Allocate (size);
+      if (p != 0)
+        {
+          return p;
+        }
+      // As the standard operator new: let the handler free memory, or throw
+      std::new_handler handler = std::get_new_handler ();
+      if (handler == 0)
+        {
+          throw std::bad_alloc ();
+        }
+      handler ();
+    }
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return operator new (size);
+}
+
+void *
+operator new (std::size_t size, const std::nothrow_t &) noexcept
+{
+  try
+    {
+      return operator new (size);
+    }
+  catch (const std::bad_alloc &)
+    {
+      return 0;
+    }
+}
+
+void *
+operator new[] (std::size_t size, const std::nothrow_t &) noexcept
+{
+  return operator new (size, std::nothrow);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  ns3::PooledAllocator::Deallocate (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  ns3::PooledAllocator::Deallocate (p);
+}
+
+void
+operator delete (void *p, const std::nothrow_t &) noexcept
+{
+  ns3::PooledAllocator::Deallocate (p);
+}
+
+void
+operator delete[] (void *p, const std::nothrow_t &) noexcept
+{
+  ns3::PooledAllocator::Deallocate (p);
+}
+
+#endif /* POOLED_ALLOCATOR_DEFINE_GLOBAL_NEW && POOLED_ALLOCATOR */
+
+#endif /* POOLED_ALLOCATOR_H */
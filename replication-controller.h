@@ -0,0 +1,498 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REPLICATION_CONTROLLER_H
+#define REPLICATION_CONTROLLER_H
+
+//
+// Independent replications of every point of a ParameterSweep (see
+// parameter-sweep.h), with as many RNG runs as each point needs.
+//
+// Every replication runs in a child process, with the values of its
+// configuration and a "run" value, 1, 2, ...; at most "jobs" children
+// are alive at a time, shared by all the configurations.  A run writes
+// the rows of SetColumns; the chosen metric columns are summed over its
+// rows, so a run writes either one row of totals or rows that add up.
+//
+// The running mean and variance of every metric are updated in run
+// order, whatever the order in which the children finish, and a
+// configuration stops once the Student-t confidence interval of every
+// metric is narrower than the target, relative to the mean by default,
+// or after the maximum number of runs.  Runs already started when a
+// configuration stops are discarded, so the results do not depend on
+// the number of jobs.  The summary has one row per configuration:
+//
+//   <axes>,runs,converged,<metric>Mean,<metric>HalfWidth,...
+//
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+
+#include "parameter-sweep.h"
+
+namespace ns3 {
+
+/**
+ * \brief Replicate every point of a parameter sweep until the confidence
+ * intervals of its metrics are narrow enough.
+ */
+class ReplicationController
+{
+public:
+  /**
+   * \param configurations the configurations, one per point of the
+   *        grid; a grid without axes is one configuration
+   */
+  ReplicationController (const ParameterSweep &configurations)
+    : m_configurations (configurations),
+      m_jobs (1),
+      m_minRuns (3),
+      m_maxRuns (30),
+      m_level (0.95),
+      m_target (0.05),
+      m_relative (true),
+      m_summaryFile ("replications.csv")
+  {
+    SetJobs (0);
+  }
+
+  /// \param jobs maximum number of runs in flight; 0 means one per core
+  void SetJobs (uint32_t jobs)
+  {
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+    m_jobs = jobs > 0 ? jobs : (n > 0 ? static_cast<uint32_t> (n) : 1);
+  }
+
+  /**
+   * \param minRuns runs of every configuration before it may stop, at
+   *        least 2
+   * \param maxRuns runs after which a configuration stops anyway
+   */
+  void SetRuns (uint32_t minRuns, uint32_t maxRuns)
+  {
+    NS_ABORT_MSG_UNLESS (minRuns >= 2 && maxRuns >= minRuns,
+                         "ReplicationController: need 2 <= minRuns <= maxRuns");
+    m_minRuns = minRuns;
+    m_maxRuns = maxRuns;
+  }
+
+  /**
+   * \param level confidence level of the intervals, e.g. 0.95
+   * \param target half-width below which a metric has converged
+   * \param relative true if the target is a fraction of the mean
+   */
+  void SetTarget (double level, double target, bool relative)
+  {
+    NS_ABORT_MSG_UNLESS (level > 0 && level < 1, "ReplicationController: confidence level must be in (0, 1)");
+    m_level = level;
+    m_target = target;
+    m_relative = relative;
+  }
+
+  /// \param columns comma separated names of the columns written by a run
+  void SetColumns (std::string columns)
+  {
+    m_columns = Split (columns);
+  }
+
+  /// \param metrics comma separated columns whose intervals are tracked
+  void SetMetrics (std::string metrics)
+  {
+    m_metrics = Split (metrics);
+  }
+
+  /// \param filename file receiving one row per configuration
+  void SetSummaryFile (std::string filename)
+  {
+    m_summaryFile = filename;
+  }
+
+  /**
+   * \param point a configuration with its "run" value
+   * \return a file-name friendly label such as "distance125-run2"
+   */
+  std::string GetLabel (const ParameterSweep::Point &point) const
+  {
+    std::string label = m_configurations.GetLabel (point);
+    return (label.empty () ? "" : label + "-") + "run" + point.find ("run")->second;
+  }
+
+  /**
+   * \brief Replicate every configuration and write the summary.
+   * \param runOne callback executed in a child process for each run
+   * \return the number of runs that did not exit successfully
+   */
+  uint32_t Run (ParameterSweep::RunCallback runOne)
+  {
+    m_indices.clear ();
+    for (uint32_t m = 0; m < m_metrics.size (); ++m)
+      {
+        uint32_t c = 0;
+        while (c < m_columns.size () && m_columns[c] != m_metrics[m])
+          {
+            ++c;
+          }
+        NS_ABORT_MSG_IF (c == m_columns.size (), "ReplicationController: no column " << m_metrics[m]);
+        m_indices.push_back (c);
+      }
+    NS_ABORT_MSG_IF (m_metrics.empty (), "ReplicationController: no metric");
+    std::vector<ParameterSweep::Point> points = m_configurations.GetPoints ();
+    std::vector<Configuration> configurations (points.size ());
+    for (uint32_t i = 0; i < points.size (); ++i)
+      {
+        configurations[i].point = points[i];
+        configurations[i].mean.assign (m_metrics.size (), 0);
+        configurations[i].m2.assign (m_metrics.size (), 0);
+      }
+    std::map<pid_t, std::pair<uint32_t, uint32_t> > running;
+    uint32_t failed = 0;
+
+    std::cout << "Replicating " << points.size () << " configurations, " << m_minRuns << " to "
+              << m_maxRuns << " runs each, on " << m_jobs << " workers" << std::endl;
+    std::cout.flush ();
+    while (true)
+      {
+        // Start the next run of the configuration with the fewest runs
+        while (running.size () < m_jobs)
+          {
+            Configuration *next = 0;
+            for (uint32_t i = 0; i < configurations.size (); ++i)
+              {
+                Configuration &c = configurations[i];
+                if (!c.done && c.started < m_maxRuns && (next == 0 || c.started < next->started))
+                  {
+                    next = &c;
+                  }
+              }
+            if (next == 0)
+              {
+                break;
+              }
+            uint32_t index = next - &configurations[0];
+            uint32_t run = ++next->started;
+            ParameterSweep::Point point = next->point;
+            std::ostringstream oss;
+            oss << run;
+            point["run"] = oss.str ();
+            pid_t pid = fork ();
+            NS_ABORT_MSG_IF (pid < 0, "ReplicationController: fork failed");
+            if (pid == 0)
+              {
+                std::ofstream part (GetPartFile (index, run).c_str ());
+                runOne (point, part);
+                part.close ();
+                std::cout.flush ();
+                _exit (part.fail () ? 1 : 0);
+              }
+            running[pid] = std::make_pair (index, run);
+          }
+        if (running.empty ())
+          {
+            break;
+          }
+        int wstatus;
+        pid_t done = waitpid (-1, &wstatus, 0);
+        if (done < 0)
+          {
+            break;
+          }
+        std::map<pid_t, std::pair<uint32_t, uint32_t> >::iterator it = running.find (done);
+        if (it == running.end ())
+          {
+            continue;
+          }
+        Configuration &c = configurations[it->second.first];
+        uint32_t run = it->second.second;
+        std::string partFile = GetPartFile (it->second.first, run);
+        running.erase (it);
+        bool ok = WIFEXITED (wstatus) && WEXITSTATUS (wstatus) == 0;
+        if (c.done)
+          {
+            std::remove (partFile.c_str ());
+            continue;
+          }
+        if (!ok)
+          {
+            ++failed;
+            std::cout << "Run " << run << " of configuration " << it->second.first << " FAILED" << std::endl;
+          }
+        c.results[run] = ok ? ReadMetrics (partFile) : std::vector<double> ();
+        std::remove (partFile.c_str ());
+        Accept (c);
+      }
+
+    WriteSummary (configurations);
+    std::cout << "Replication summary written to " << m_summaryFile
+              << " (" << failed << " failed runs)" << std::endl;
+    return failed;
+  }
+
+  /**
+   * \param p a probability in (0, 1)
+   * \param dof degrees of freedom
+   * \return the p-quantile of the Student t distribution
+   */
+  static double StudentQuantile (double p, uint32_t dof)
+  {
+    if (p < 0.5)
+      {
+        return -StudentQuantile (1 - p, dof);
+      }
+    double lo = 0;
+    double hi = 1;
+    while (StudentCdf (hi, dof) < p)
+      {
+        hi *= 2;
+      }
+    for (uint32_t i = 0; i < 100 && hi - lo > 1e-12 * hi; ++i)
+      {
+        double mid = (lo + hi) / 2;
+        (StudentCdf (mid, dof) < p ? lo : hi) = mid;
+      }
+    return (lo + hi) / 2;
+  }
+
+private:
+  /// Replications of one configuration.
+  struct Configuration
+  {
+    Configuration ()
+      : started (0),
+        accepted (0),
+        failed (0),
+        done (false),
+        converged (false)
+    {
+    }
+
+    ParameterSweep::Point point;                    //!< values of the swept parameters
+    uint32_t started;                               //!< runs started, the last run number
+    uint32_t accepted;                              //!< runs in the statistics, in run order
+    uint32_t failed;                                //!< failed runs among them
+    bool done;                                      //!< no more runs
+    bool converged;                                 //!< stopped on the target
+    std::map<uint32_t, std::vector<double> > results; //!< finished runs not yet accepted
+    std::vector<double> mean;                       //!< running mean of each metric
+    std::vector<double> m2;                         //!< sum of squared deviations of each metric
+  };
+
+  static std::vector<std::string> Split (std::string list)
+  {
+    std::vector<std::string> items;
+    std::istringstream iss (list);
+    std::string item;
+    while (std::getline (iss, item, ','))
+      {
+        items.push_back (item);
+      }
+    return items;
+  }
+
+  std::string GetPartFile (uint32_t configuration, uint32_t run) const
+  {
+    std::ostringstream oss;
+    oss << m_summaryFile << ".part" << configuration << "-" << run;
+    return oss.str ();
+  }
+
+  /// \return the metrics of a run, summed over the rows it wrote
+  std::vector<double> ReadMetrics (std::string partFile) const
+  {
+    std::vector<double> metrics (m_metrics.size (), 0);
+    std::ifstream part (partFile.c_str ());
+    std::string line;
+    while (std::getline (part, line))
+      {
+        std::vector<std::string> fields = Split (line);
+        for (uint32_t m = 0; m < m_indices.size (); ++m)
+          {
+            if (m_indices[m] < fields.size ())
+              {
+                metrics[m] += std::atof (fields[m_indices[m]].c_str ());
+              }
+          }
+      }
+    return metrics;
+  }
+
+  /// Add the finished runs that follow the accepted ones, in order; a
+  /// failed run, with no metrics, is counted but not averaged.
+  void Accept (Configuration &c) const
+  {
+    std::map<uint32_t, std::vector<double> >::iterator r;
+    while (!c.done && (r = c.results.find (c.accepted + 1)) != c.results.end ())
+      {
+        ++c.accepted;
+        if (r->second.empty ())
+          {
+            ++c.failed;
+          }
+        else
+          {
+            uint32_t n = c.accepted - c.failed;
+            for (uint32_t m = 0; m < m_metrics.size (); ++m)
+              {
+                // Welford's update
+                double delta = r->second[m] - c.mean[m];
+                c.mean[m] += delta / n;
+                c.m2[m] += delta * (r->second[m] - c.mean[m]);
+              }
+          }
+        c.results.erase (r);
+        c.converged = Converged (c);
+        c.done = c.converged || c.accepted == m_maxRuns;
+      }
+  }
+
+  bool Converged (const Configuration &c) const
+  {
+    if (c.accepted - c.failed < m_minRuns)
+      {
+        return false;
+      }
+    for (uint32_t m = 0; m < m_metrics.size (); ++m)
+      {
+        if (HalfWidth (c, m) > m_target * (m_relative ? std::fabs (c.mean[m]) : 1))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+  double HalfWidth (const Configuration &c, uint32_t m) const
+  {
+    uint32_t n = c.accepted - c.failed;
+    if (n < 2)
+      {
+        return 0;
+      }
+    return StudentQuantile (0.5 + m_level / 2, n - 1) * std::sqrt (c.m2[m] / (n - 1) / n);
+  }
+
+  void WriteSummary (const std::vector<Configuration> &configurations) const
+  {
+    std::ofstream out (m_summaryFile.c_str ());
+    const ParameterSweep::Point &first = configurations[0].point;
+    for (ParameterSweep::Point::const_iterator a = first.begin (); a != first.end (); ++a)
+      {
+        out << a->first << ",";
+      }
+    out << "runs,converged";
+    for (uint32_t m = 0; m < m_metrics.size (); ++m)
+      {
+        out << "," << m_metrics[m] << "Mean," << m_metrics[m] << "HalfWidth";
+      }
+    out << std::endl;
+    for (uint32_t i = 0; i < configurations.size (); ++i)
+      {
+        const Configuration &c = configurations[i];
+        std::string label = m_configurations.GetLabel (c.point);
+        std::cout << "Configuration " << (label.empty () ? "-" : label) << ": " << c.accepted - c.failed << " runs"
+                  << (c.converged ? "" : " (not converged)");
+        for (ParameterSweep::Point::const_iterator a = c.point.begin (); a != c.point.end (); ++a)
+          {
+            out << a->second << ",";
+          }
+        out << c.accepted - c.failed << "," << c.converged;
+        for (uint32_t m = 0; m < m_metrics.size (); ++m)
+          {
+            out << "," << c.mean[m] << "," << HalfWidth (c, m);
+            std::cout << ", " << m_metrics[m] << " " << c.mean[m] << " +/- " << HalfWidth (c, m);
+          }
+        out << std::endl;
+        std::cout << std::endl;
+      }
+  }
+
+  /// \return P(T <= t) for t >= 0 and a Student T with dof degrees of freedom
+  static double StudentCdf (double t, uint32_t dof)
+  {
+    double x = dof / (dof + t * t);
+    return 1 - 0.5 * IncompleteBeta (dof / 2.0, 0.5, x);
+  }
+
+  /// \return the regularized incomplete beta function I_x(a, b)
+  static double IncompleteBeta (double a, double b, double x)
+  {
+    if (x <= 0 || x >= 1)
+      {
+        return x <= 0 ? 0 : 1;
+      }
+    double front = std::exp (std::lgamma (a + b) - std::lgamma (a) - std::lgamma (b)
+                             + a * std::log (x) + b * std::log (1 - x));
+    if (x > (a + 1) / (a + b + 2))
+      {
+        return 1 - IncompleteBeta (b, a, 1 - x);
+      }
+    // Continued fraction, by the modified Lentz method
+    const double tiny = 1e-300;
+    double f = 1;
+    double c = 1;
+    double d = 1 - (a + b) * x / (a + 1);
+    d = 1 / (std::fabs (d) < tiny ? tiny : d);
+    f = d;
+    for (uint32_t k = 1; k < 300; ++k)
+      {
+        double numerators[2] = {k * (b - k) * x / ((a + 2 * k - 1) * (a + 2 * k)),
+                                -(a + k) * (a + b + k) * x / ((a + 2 * k) * (a + 2 * k + 1))};
+        double delta = 1;
+        for (uint32_t j = 0; j < 2; ++j)
+          {
+            d = 1 + numerators[j] * d;
+            d = 1 / (std::fabs (d) < tiny ? tiny : d);
+            c = 1 + numerators[j] / c;
+            c = std::fabs (c) < tiny ? tiny : c;
+            delta = c * d;
+            f *= delta;
+          }
+        if (std::fabs (delta - 1) < 1e-15)
+          {
+            break;
+          }
+      }
+    return front * f / a;
+  }
+
+  ParameterSweep m_configurations;     //!< the grid of configurations
+  uint32_t m_jobs;                     //!< maximum number of concurrent runs
+  uint32_t m_minRuns;                  //!< runs before a configuration may stop
+  uint32_t m_maxRuns;                  //!< runs after which it stops anyway
+  double m_level;                      //!< confidence level
+  double m_target;                     //!< target half-width
+  bool m_relative;                     //!< target relative to the mean
+  std::string m_summaryFile;           //!< one row per configuration
+  std::vector<std::string> m_columns;  //!< columns written by a run
+  std::vector<std::string> m_metrics;  //!< tracked columns
+  std::vector<uint32_t> m_indices;     //!< position of each tracked column
+};
+
+} // namespace ns3
+
+#endif /* REPLICATION_CONTROLLER_H */
@@ -0,0 +1,236 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ROUTE_CHANGE_LOG_H
+#define ROUTE_CHANGE_LOG_H
+
+//
+// Log of the changes of the OLSR routing tables.
+//
+// OlsrHelper::PrintRoutingTableAllEvery dumps every table of every node
+// at a fixed period, although with slow mobility almost nothing changes
+// between two dumps.  This logger is called by the "RoutingTableChanged"
+// trace of each node, each time OLSR recomputes its table, and only
+// writes the entries that changed, one line each:
+//
+//   <time ns> <node> + <destination> <next hop> <interface> <distance>
+//   <time ns> <node> ~ <destination> <next hop> <interface> <distance>
+//   <time ns> <node> - <destination>
+//
+// for an added, changed and removed route.  Symmetric one-hop neighbors
+// (routes whose next hop is the destination) are also logged as they
+// appear and disappear:
+//
+//   <time ns> <node> N+ <neighbor>
+//   <time ns> <node> N- <neighbor>
+//
+// route-replay rebuilds the table of any node at any time from the log.
+//
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/node-container.h"
+#include "ns3/olsr-routing-protocol.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+/**
+ * \brief Write the changes of the OLSR routing tables of a set of nodes.
+ */
+class RouteChangeLog
+{
+public:
+  RouteChangeLog ()
+    : m_changes (0)
+  {
+  }
+
+  ~RouteChangeLog ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Log the route changes of the given nodes.
+   * \param filename the log file
+   * \param nodes nodes running OLSR, directly or in an Ipv4ListRouting
+   *
+   * Nodes without OLSR are skipped.
+   */
+  void Install (std::string filename, NodeContainer nodes)
+  {
+    m_file.open (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (m_file.is_open (), "RouteChangeLog: cannot open " << filename);
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+      {
+        Ptr<olsr::RoutingProtocol> olsr = GetOlsr (*i);
+        if (olsr == 0)
+          {
+            continue;
+          }
+        Ptr<Context> ctx = Create<Context> ();
+        ctx->log = this;
+        ctx->node = (*i)->GetId ();
+        ctx->olsr = olsr;
+        olsr->TraceConnectWithoutContext ("RoutingTableChanged", MakeBoundCallback (&RouteChangeLog::TableChanged, ctx));
+      }
+  }
+
+  /// \brief Close the log file.
+  void Close (void)
+  {
+    if (m_file.is_open ())
+      {
+        m_file.close ();
+      }
+  }
+
+  /// \return number of lines written
+  uint64_t GetChanges (void) const
+  {
+    return m_changes;
+  }
+
+private:
+  /// Route to one destination: next hop, interface and distance.
+  struct Route
+  {
+    Ipv4Address next;    //!< next hop
+    uint32_t interface;  //!< outgoing interface
+    uint32_t distance;   //!< hops to the destination
+  };
+  typedef std::map<Ipv4Address, Route> Table;
+
+  /// What the trace sink of a node needs.
+  struct Context : public SimpleRefCount<Context>
+  {
+    RouteChangeLog *log;             //!< the logger
+    uint32_t node;                   //!< node id
+    Ptr<olsr::RoutingProtocol> olsr; //!< OLSR instance of the node
+    Table table;                     //!< table as last logged
+  };
+
+  static Ptr<olsr::RoutingProtocol> GetOlsr (Ptr<Node> node)
+  {
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    if (ipv4 == 0)
+      {
+        return 0;
+      }
+    Ptr<Ipv4RoutingProtocol> routing = ipv4->GetRoutingProtocol ();
+    Ptr<olsr::RoutingProtocol> olsr = DynamicCast<olsr::RoutingProtocol> (routing);
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (routing);
+    for (uint32_t i = 0; olsr == 0 && list != 0 && i < list->GetNRoutingProtocols (); ++i)
+      {
+        int16_t priority;
+        olsr = DynamicCast<olsr::RoutingProtocol> (list->GetRoutingProtocol (i, priority));
+      }
+    return olsr;
+  }
+
+  static void TableChanged (Ptr<Context> ctx, uint32_t size)
+  {
+    RouteChangeLog *log = ctx->log;
+    if (!log->m_file.is_open ())
+      {
+        return;
+      }
+    Table table;
+    std::vector<olsr::RoutingTableEntry> entries = ctx->olsr->GetRoutingTableEntries ();
+    for (std::vector<olsr::RoutingTableEntry>::const_iterator e = entries.begin (); e != entries.end (); ++e)
+      {
+        Route route;
+        route.next = e->nextAddr;
+        route.interface = e->interface;
+        route.distance = e->distance;
+        table[e->destAddr] = route;
+      }
+
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    Table::const_iterator o = ctx->table.begin ();
+    Table::const_iterator n = table.begin ();
+    while (o != ctx->table.end () || n != table.end ())
+      {
+        if (n == table.end () || (o != ctx->table.end () && o->first < n->first))
+          {
+            log->m_file << now << " " << ctx->node << " - " << o->first << "\n";
+            ++log->m_changes;
+            if (o->second.next == o->first)
+              {
+                log->LogNeighbor (now, ctx->node, o->first, false);
+              }
+            ++o;
+          }
+        else if (o == ctx->table.end () || n->first < o->first)
+          {
+            log->LogRoute (now, ctx->node, '+', n);
+            if (n->second.next == n->first)
+              {
+                log->LogNeighbor (now, ctx->node, n->first, true);
+              }
+            ++n;
+          }
+        else
+          {
+            const Route &a = o->second;
+            const Route &b = n->second;
+            if (a.next != b.next || a.interface != b.interface || a.distance != b.distance)
+              {
+                log->LogRoute (now, ctx->node, '~', n);
+                bool wasNeighbor = a.next == o->first;
+                bool isNeighbor = b.next == n->first;
+                if (wasNeighbor != isNeighbor)
+                  {
+                    log->LogNeighbor (now, ctx->node, n->first, isNeighbor);
+                  }
+              }
+            ++o;
+            ++n;
+          }
+      }
+    ctx->table.swap (table);
+  }
+
+  void LogRoute (int64_t now, uint32_t node, char op, Table::const_iterator r)
+  {
+    m_file << now << " " << node << " " << op << " " << r->first << " " << r->second.next
+           << " " << r->second.interface << " " << r->second.distance << "\n";
+    ++m_changes;
+  }
+
+  void LogNeighbor (int64_t now, uint32_t node, Ipv4Address neighbor, bool up)
+  {
+    m_file << now << " " << node << (up ? " N+ " : " N- ") << neighbor << "\n";
+    ++m_changes;
+  }
+
+  std::ofstream m_file;   //!< the log file
+  uint64_t m_changes;     //!< lines written
+};
+
+} // namespace ns3
+
+#endif /* ROUTE_CHANGE_LOG_H */
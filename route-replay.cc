@@ -0,0 +1,141 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Rebuild OLSR routing tables from the change log written by
+// RouteChangeLog (see route-change-log.h).  The changes are applied up
+// to the given time and the table and neighbors of the node are printed
+// in the layout of OlsrHelper::PrintRoutingTableAllEvery:
+//
+// ./waf --run "route-replay --input=taller1.routelog --node=3 --time=12.5"
+//
+// Without --node, the tables of every node in the log are printed.
+//
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/ipv4-address.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("RouteReplay");
+
+namespace {
+
+/// Route to one destination, as logged.
+struct Route
+{
+  std::string next;       //!< next hop
+  uint32_t interface;     //!< outgoing interface
+  uint32_t distance;      //!< hops to the destination
+};
+
+/// Routes and neighbors of one node.
+struct NodeState
+{
+  std::map<Ipv4Address, Route> routes;  //!< routing table
+  std::set<Ipv4Address> neighbors;      //!< symmetric neighbors
+};
+
+} // unnamed namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "taller1.routelog";
+  int32_t node = -1;
+  double time = 1e9;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("input", "change log written by RouteChangeLog", input);
+  cmd.AddValue ("node", "node whose table is printed (-1: all)", node);
+  cmd.AddValue ("time", "simulation time (seconds) of the table (default: end of the log)", time);
+  cmd.Parse (argc, argv);
+
+  std::ifstream is (input.c_str ());
+  NS_ABORT_MSG_UNLESS (is.is_open (), "cannot open " << input);
+  int64_t limit = static_cast<int64_t> (time * 1e9);
+  std::map<uint32_t, NodeState> nodes;
+  std::string line;
+  uint64_t applied = 0;
+  while (std::getline (is, line))
+    {
+      std::istringstream fields (line);
+      int64_t t;
+      uint32_t id;
+      std::string op;
+      std::string destination;
+      if (!(fields >> t >> id >> op >> destination))
+        {
+          continue;
+        }
+      if (t > limit)
+        {
+          break;
+        }
+      if (node >= 0 && id != static_cast<uint32_t> (node))
+        {
+          continue;
+        }
+      NodeState &state = nodes[id];
+      Ipv4Address dest (destination.c_str ());
+      if (op == "+" || op == "~")
+        {
+          Route &route = state.routes[dest];
+          fields >> route.next >> route.interface >> route.distance;
+        }
+      else if (op == "-")
+        {
+          state.routes.erase (dest);
+        }
+      else if (op == "N+")
+        {
+          state.neighbors.insert (dest);
+        }
+      else if (op == "N-")
+        {
+          state.neighbors.erase (dest);
+        }
+      ++applied;
+    }
+
+  for (std::map<uint32_t, NodeState>::const_iterator n = nodes.begin (); n != nodes.end (); ++n)
+    {
+      std::cout << "Node: " << n->first << ", Time: " << time << "s, OLSR Routing table" << std::endl;
+      std::cout << "Destination\t\tNextHop\t\tInterface\tDistance" << std::endl;
+      const std::map<Ipv4Address, Route> &routes = n->second.routes;
+      for (std::map<Ipv4Address, Route>::const_iterator r = routes.begin (); r != routes.end (); ++r)
+        {
+          std::cout << r->first << "\t\t" << r->second.next << "\t\t" << r->second.interface
+                    << "\t\t" << r->second.distance << std::endl;
+        }
+      std::cout << "Neighbors:";
+      const std::set<Ipv4Address> &neighbors = n->second.neighbors;
+      for (std::set<Ipv4Address>::const_iterator a = neighbors.begin (); a != neighbors.end (); ++a)
+        {
+          std::cout << " " << *a;
+        }
+      std::cout << std::endl << std::endl;
+    }
+  NS_LOG_UNCOND ("Applied " << applied << " changes from " << input);
+  return 0;
+}
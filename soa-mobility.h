@@ -0,0 +1,351 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SOA_MOBILITY_H
+#define SOA_MOBILITY_H
+
+//
+// Structure-of-arrays position engine for the mobility models.
+//
+// The random waypoint, random direction and hierarchical models of the
+// scenarios all move their nodes in straight segments at constant
+// velocity between two course changes.  A PositionTable keeps, for every
+// node, the start time, position and velocity of its current segment in
+// separate contiguous arrays, so that
+//
+//  - the position of one node is p0 + v * (t - t0), without a virtual
+//    call into the model that drives it;
+//  - GetDistances computes the distances from one node to a batch of
+//    others, as SpatialIndexSpectrumChannel needs them for the candidate
+//    receivers of a frame, in one loop over the rows of that batch,
+//    which the compiler vectorizes.
+//
+// Positions are only computed when asked for: a channel that queries
+// the nodes one by one, such as YansWifiChannel, gets the first point
+// but not the batched pass.
+//
+// SoaMobilityModel is the MobilityModel of a node: a thin view of its
+// row of the table.  The "Driver" model it creates (RandomWaypoint,
+// RandomDirection2d, ...) still decides the trajectory; the view copies
+// each new segment into the table on the CourseChange of the driver.
+// With a "Parent" model the driver is wrapped in a hierarchical model,
+// so that the table holds the absolute positions of the stations of a
+// LAN; as with MobilityHelper::PushReferenceMobilityModel, positions set
+// on the view, e.g. by the position allocator, are relative to the
+// parent.  The views are installed with the usual MobilityHelper:
+//
+//   ObjectFactory driver;
+//   driver.SetTypeId ("ns3::RandomWaypointMobilityModel");
+//   driver.Set ("PositionAllocator", PointerValue (positionAlloc));
+//   mobility.SetMobilityModel ("ns3::SoaMobilityModel",
+//                              "Table", PointerValue (CreateObject<PositionTable> ()),
+//                              "Driver", ObjectFactoryValue (driver));
+//
+// The driver must notify a course change whenever its velocity changes,
+// as the ns-3 models do.
+//
+
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/hierarchical-mobility-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/object.h"
+#include "ns3/object-factory.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/vector.h"
+
+namespace ns3 {
+
+/**
+ * \brief Current trajectory segment of every node, in structure-of-arrays
+ * layout.
+ */
+class PositionTable : public Object
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::PositionTable")
+      .SetParent<Object> ()
+      .SetGroupName ("Mobility")
+      .AddConstructor<PositionTable> ()
+    ;
+    return tid;
+  }
+
+  PositionTable ()
+    : m_batches (0),
+      m_distances (0)
+  {
+  }
+
+  /// \return index of a new row, at rest at the origin
+  uint32_t Add (void)
+  {
+    m_t0.push_back (0);
+    m_x0.push_back (0);
+    m_y0.push_back (0);
+    m_z0.push_back (0);
+    m_vx.push_back (0);
+    m_vy.push_back (0);
+    m_vz.push_back (0);
+    return m_t0.size () - 1;
+  }
+
+  /// \return number of rows
+  uint32_t GetN (void) const
+  {
+    return m_t0.size ();
+  }
+
+  /**
+   * \brief Start a new segment of row i at the current time.
+   * \param i the row
+   * \param position the position now
+   * \param velocity the velocity from now on
+   */
+  void SetSegment (uint32_t i, const Vector &position, const Vector &velocity)
+  {
+    m_t0[i] = Simulator::Now ().GetSeconds ();
+    m_x0[i] = position.x;
+    m_y0[i] = position.y;
+    m_z0[i] = position.z;
+    m_vx[i] = velocity.x;
+    m_vy[i] = velocity.y;
+    m_vz[i] = velocity.z;
+  }
+
+  /// \param i the row \return its position now
+  Vector GetPosition (uint32_t i) const
+  {
+    double dt = Simulator::Now ().GetSeconds () - m_t0[i];
+    return Vector (m_x0[i] + m_vx[i] * dt, m_y0[i] + m_vy[i] * dt, m_z0[i] + m_vz[i] * dt);
+  }
+
+  /// \param i the row \return its velocity now
+  Vector GetVelocity (uint32_t i) const
+  {
+    return Vector (m_vx[i], m_vy[i], m_vz[i]);
+  }
+
+  /**
+   * \brief Distances from one row to a batch of rows, at the current time.
+   * \param from the row of the transmitter
+   * \param to the rows of the receivers
+   * \param distances set to the distance (m) to each of them
+   */
+  void GetDistances (uint32_t from, const std::vector<uint32_t> &to, std::vector<double> &distances)
+  {
+    Vector f = GetPosition (from);
+    distances.resize (to.size ());
+    Measure (Simulator::Now ().GetSeconds (), f.x, f.y, f.z, to.size (), to.data (),
+             m_t0.data (), m_x0.data (), m_y0.data (), m_z0.data (),
+             m_vx.data (), m_vy.data (), m_vz.data (), distances.data ());
+    ++m_batches;
+    m_distances += to.size ();
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    os << "PositionTable: " << m_t0.size () << " nodes, "
+       << m_batches << " distance batches, "
+       << m_distances << " distances" << std::endl;
+  }
+
+private:
+  // The loop takes restrict parameters, which GCC and clang honour when
+  // vectorizing, unlike restrict locals.
+
+  /// Distance from (fx, fy, fz) to each of the n given rows at now.
+  static void Measure (double now, double fx, double fy, double fz, uint32_t n,
+                       const uint32_t *__restrict__ rows, const double *__restrict__ t0,
+                       const double *__restrict__ x0, const double *__restrict__ y0,
+                       const double *__restrict__ z0, const double *__restrict__ vx,
+                       const double *__restrict__ vy, const double *__restrict__ vz,
+                       double *__restrict__ d)
+  {
+    for (uint32_t k = 0; k < n; ++k)
+      {
+        uint32_t i = rows[k];
+        double dt = now - t0[i];
+        double dx = x0[i] + vx[i] * dt - fx;
+        double dy = y0[i] + vy[i] * dt - fy;
+        double dz = z0[i] + vz[i] * dt - fz;
+        d[k] = std::sqrt (dx * dx + dy * dy + dz * dz);
+      }
+  }
+
+  std::vector<double> m_t0;    //!< segment start time (s)
+  std::vector<double> m_x0;    //!< x at the segment start
+  std::vector<double> m_y0;    //!< y at the segment start
+  std::vector<double> m_z0;    //!< z at the segment start
+  std::vector<double> m_vx;    //!< x velocity (m/s)
+  std::vector<double> m_vy;    //!< y velocity (m/s)
+  std::vector<double> m_vz;    //!< z velocity (m/s)
+  uint64_t m_batches;          //!< GetDistances calls
+  uint64_t m_distances;        //!< distances computed in batches
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PositionTable);
+
+/**
+ * \brief MobilityModel reading the position of its node from a
+ * PositionTable row kept up to date by a driver model.
+ */
+class SoaMobilityModel : public MobilityModel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::SoaMobilityModel")
+      .SetParent<MobilityModel> ()
+      .SetGroupName ("Mobility")
+      .AddConstructor<SoaMobilityModel> ()
+      .AddAttribute ("Table",
+                     "The position table holding the node.",
+                     PointerValue (),
+                     MakePointerAccessor (&SoaMobilityModel::m_table),
+                     MakePointerChecker<PositionTable> ())
+      .AddAttribute ("Driver",
+                     "Factory of the model that moves the node.",
+                     ObjectFactoryValue (),
+                     MakeObjectFactoryAccessor (&SoaMobilityModel::m_driverFactory),
+                     MakeObjectFactoryChecker ())
+      .AddAttribute ("Parent",
+                     "Model the driver moves relative to, if any.",
+                     PointerValue (),
+                     MakePointerAccessor (&SoaMobilityModel::m_parent),
+                     MakePointerChecker<MobilityModel> ())
+    ;
+    return tid;
+  }
+
+  SoaMobilityModel ()
+    : m_index (0),
+      m_segments (0)
+  {
+  }
+
+  /// \return the table holding the node
+  Ptr<PositionTable> GetTable (void) const
+  {
+    return m_table;
+  }
+
+  /// \return the row of the node in the table
+  uint32_t GetIndex (void) const
+  {
+    return m_index;
+  }
+
+  /// \return the model that moves the node
+  Ptr<MobilityModel> GetDriver (void) const
+  {
+    return m_driver;
+  }
+
+protected:
+  virtual void NotifyConstructionCompleted (void)
+  {
+    MobilityModel::NotifyConstructionCompleted ();
+    NS_ABORT_MSG_IF (m_table == 0, "SoaMobilityModel: no Table");
+    NS_ABORT_MSG_IF (m_driverFactory.GetTypeId () == TypeId (), "SoaMobilityModel: no Driver");
+    m_driver = m_driverFactory.Create<MobilityModel> ();
+    m_child = m_driver;
+    if (m_parent != 0)
+      {
+        Ptr<HierarchicalMobilityModel> hierarchical = CreateObject<HierarchicalMobilityModel> ();
+        hierarchical->SetParent (m_parent);
+        hierarchical->SetChild (m_child);
+        m_driver = hierarchical;
+      }
+    m_index = m_table->Add ();
+    m_driver->TraceConnectWithoutContext ("CourseChange",
+                                          MakeCallback (&SoaMobilityModel::DriverCourseChanged, this));
+  }
+
+  virtual void DoInitialize (void)
+  {
+    m_driver->Initialize ();
+    MobilityModel::DoInitialize ();
+  }
+
+  virtual void DoDispose (void)
+  {
+    m_driver->Dispose ();
+    m_driver = 0;
+    m_child = 0;
+    m_parent = 0;
+    m_table = 0;
+    MobilityModel::DoDispose ();
+  }
+
+private:
+  void DriverCourseChanged (Ptr<const MobilityModel> driver)
+  {
+    m_table->SetSegment (m_index, driver->GetPosition (), driver->GetVelocity ());
+    ++m_segments;
+    NotifyCourseChange ();
+  }
+
+  virtual Vector DoGetPosition (void) const
+  {
+    return m_table->GetPosition (m_index);
+  }
+
+  virtual void DoSetPosition (const Vector &position)
+  {
+    // Relative to the parent, if any; the ns-3 models notify the new
+    // position themselves, which starts the segment and notifies ours
+    uint64_t segments = m_segments;
+    m_child->SetPosition (position);
+    if (m_segments == segments)
+      {
+        DriverCourseChanged (m_driver);
+      }
+  }
+
+  virtual Vector DoGetVelocity (void) const
+  {
+    return m_table->GetVelocity (m_index);
+  }
+
+  virtual int64_t DoAssignStreams (int64_t stream)
+  {
+    return m_driver->AssignStreams (stream);
+  }
+
+  Ptr<PositionTable> m_table;       //!< table holding the node
+  ObjectFactory m_driverFactory;    //!< factory of the driver
+  Ptr<MobilityModel> m_parent;      //!< reference of the driver, if any
+  Ptr<MobilityModel> m_driver;      //!< model that moves the node
+  Ptr<MobilityModel> m_child;       //!< the created driver, inside m_driver with a parent
+  uint32_t m_index;                 //!< row of the node in the table
+  uint64_t m_segments;              //!< segments started in the table
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SoaMobilityModel);
+
+} // namespace ns3
+
+#endif /* SOA_MOBILITY_H */
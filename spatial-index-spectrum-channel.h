@@ -0,0 +1,606 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SPATIAL_INDEX_SPECTRUM_CHANNEL_H
+#define SPATIAL_INDEX_SPECTRUM_CHANNEL_H
+
+//
+// A single-model spectrum channel that keeps the receivers in a uniform
+// grid indexed by position, so that a transmission is only delivered to
+// the PHYs that can be within the maximum range of the transmitter
+// instead of to every PHY attached to the channel.
+//
+// The maximum range is either given with the "MaxRange" attribute or
+// derived from the propagation loss model as the distance at which the
+// loss reaches "MaxLossDb".  A receiver is binned at the first frame
+// after its mobility model is known, and re-binned on every
+// CourseChange of that model; all of them are re-binned every
+// "RefreshInterval", and in between the search radius is widened by the
+// largest distance any node can have travelled since it was binned.  A
+// frame thus only visits the cells within reach, and the few receivers
+// that have no mobility model yet, kept in a list of their own.
+//
+// When the mobility models are views of a PositionTable (see
+// soa-mobility.h), the distances from the transmitter to all the
+// candidates of a frame are computed in one batch, and the candidates
+// beyond the range are dropped before the loss model is called.
+//
+// With "Validate" set, every transmission is also evaluated against
+// every PHY with no MaxLossDb cutoff, as the stock
+// MultiModelSpectrumChannel does: the received power of each PHY is
+// computed from the transmitted PSD, the loss model and the spectrum
+// loss model, and a PHY that gets at least "ValidationSensitivityDbm"
+// but was not delivered the frame is counted and logged as a mismatch.
+// Receivers wrongly dropped by the spatial index and by a MaxLossDb or
+// MaxRange that is too small, e.g. for a PHY sending above the power it
+// was derived from, are thus both caught.
+//
+// Antenna gains are not applied: every PHY is assumed isotropic, as the
+// wifi PHYs of these scenarios are.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/mobility-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/nstime.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/simulator.h"
+#include "ns3/spectrum-channel.h"
+#include "ns3/spectrum-phy.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/spectrum-value.h"
+
+#include "soa-mobility.h"
+
+namespace ns3 {
+
+/**
+ * \brief SpectrumChannel delivering frames only to receivers found in a
+ * uniform-grid spatial index around the transmitter.
+ */
+class SpatialIndexSpectrumChannel : public SpectrumChannel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::SpatialIndexSpectrumChannel")
+      .SetParent<SpectrumChannel> ()
+      .SetGroupName ("Spectrum")
+      .AddConstructor<SpatialIndexSpectrumChannel> ()
+      .AddAttribute ("MaxRange",
+                     "Maximum range (m) at which a frame is delivered; "
+                     "0 derives it from the loss model and MaxLossDb.",
+                     DoubleValue (0),
+                     MakeDoubleAccessor (&SpatialIndexSpectrumChannel::m_maxRange),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("RefreshInterval",
+                     "Interval between two re-binnings of every receiver.",
+                     TimeValue (Seconds (1)),
+                     MakeTimeAccessor (&SpatialIndexSpectrumChannel::m_refreshInterval),
+                     MakeTimeChecker ())
+      .AddAttribute ("Validate",
+                     "Compare every delivered set with an unfiltered scan of every PHY.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&SpatialIndexSpectrumChannel::m_validate),
+                     MakeBooleanChecker ())
+      .AddAttribute ("ValidationSensitivityDbm",
+                     "Received power, before any PHY gain, from which a PHY "
+                     "must be delivered the frame when validating.",
+                     DoubleValue (-101),
+                     MakeDoubleAccessor (&SpatialIndexSpectrumChannel::m_validationSensitivityDbm),
+                     MakeDoubleChecker<double> ())
+    ;
+    return tid;
+  }
+
+  SpatialIndexSpectrumChannel ()
+    : m_maxRange (0),
+      m_validate (false),
+      m_validationSensitivityDbm (-101),
+      m_cellSize (0),
+      m_maxSpeed (0),
+      m_transmissions (0),
+      m_candidates (0),
+      m_deliveries (0),
+      m_mismatches (0),
+      m_outOfRange (0)
+  {
+  }
+
+  // inherited from SpectrumChannel
+  virtual void AddRx (Ptr<SpectrumPhy> phy)
+  {
+    Receiver rx;
+    rx.phy = phy;
+    rx.cell = 0;
+    rx.slot = 0;
+    rx.binned = false;
+    rx.row = -1;
+    m_unbound.push_back (m_receivers.size ());
+    m_receivers.push_back (rx);
+  }
+
+  virtual void StartTx (Ptr<SpectrumSignalParameters> txParams)
+  {
+    NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+    NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+    m_txSigParamsTrace (txParams->Copy ());
+    UpdateIndex ();
+
+    Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+    std::vector<uint32_t> delivered;
+    if (senderMobility == 0 || m_cellSize <= 0)
+      {
+        // No range or no sender position: every PHY, as the stock channel
+        for (uint32_t i = 0; i < m_receivers.size (); ++i)
+          {
+            TryDeliver (txParams, senderMobility, i, delivered);
+          }
+      }
+    else
+      {
+        // Candidates from the cells within reach, then the unbound ones
+        Vector pos = senderMobility->GetPosition ();
+        double radius = m_cellSize + m_maxSpeed * (Simulator::Now () - m_lastRefresh).GetSeconds ();
+        int64_t reach = static_cast<int64_t> (std::ceil (radius / m_cellSize));
+        int64_t cx = CellCoordinate (pos.x);
+        int64_t cy = CellCoordinate (pos.y);
+        for (int64_t x = cx - reach; x <= cx + reach; ++x)
+          {
+            for (int64_t y = cy - reach; y <= cy + reach; ++y)
+              {
+                std::map<uint64_t, std::vector<uint32_t> >::const_iterator cell = m_grid.find (CellKey (x, y));
+                if (cell == m_grid.end ())
+                  {
+                    continue;
+                  }
+                m_batch.insert (m_batch.end (), cell->second.begin (), cell->second.end ());
+              }
+          }
+        m_batch.insert (m_batch.end (), m_unbound.begin (), m_unbound.end ());
+        FilterByDistance (senderMobility);
+        for (uint32_t k = 0; k < m_batch.size (); ++k)
+          {
+            TryDeliver (txParams, senderMobility, m_batch[k], delivered);
+          }
+        m_batch.clear ();
+      }
+    ++m_transmissions;
+    m_deliveries += delivered.size ();
+
+    if (m_validate)
+      {
+        Validate (txParams, senderMobility, delivered);
+      }
+  }
+
+  // inherited from Channel
+  virtual std::size_t GetNDevices (void) const
+  {
+    return m_receivers.size ();
+  }
+
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const
+  {
+    return m_receivers.at (i).phy->GetDevice ();
+  }
+
+  /// \return the maximum delivery range in use (0 if unbounded)
+  double GetMaxRange (void) const
+  {
+    return m_cellSize;
+  }
+
+  /// \return number of frames that missed a receiver of the unfiltered scan
+  uint64_t GetMismatches (void) const
+  {
+    return m_mismatches;
+  }
+
+  /**
+   * \brief Print the delivery statistics of the channel.
+   * \param os the output stream
+   */
+  void PrintStats (std::ostream &os) const
+  {
+    os << "SpatialIndexSpectrumChannel: range " << m_cellSize << " m, "
+       << m_transmissions << " transmissions, "
+       << m_candidates << " candidate receivers, "
+       << m_deliveries << " deliveries (brute force: "
+       << m_transmissions * (m_receivers.empty () ? 0 : m_receivers.size () - 1) << ")";
+    if (m_positions != 0)
+      {
+        os << ", " << m_outOfRange << " candidates beyond range by batched distance";
+      }
+    if (m_validate)
+      {
+        os << ", " << m_mismatches << " mismatches";
+      }
+    os << std::endl;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_receivers.clear ();
+    m_grid.clear ();
+    m_byMobility.clear ();
+    m_unbound.clear ();
+    m_positions = 0;
+    SpectrumChannel::DoDispose ();
+  }
+
+private:
+  /// A receiving PHY and its place in the grid.
+  struct Receiver
+  {
+    Ptr<SpectrumPhy> phy;           //!< the receiving PHY
+    Ptr<MobilityModel> mobility;    //!< its mobility model, once known
+    uint64_t cell;                  //!< key of the cell holding it
+    uint32_t slot;                  //!< position within that cell
+    bool binned;                    //!< true once inserted in the grid
+    int64_t row;                    //!< row in m_positions, -1 if none
+  };
+
+  int64_t CellCoordinate (double v) const
+  {
+    return static_cast<int64_t> (std::floor (v / m_cellSize));
+  }
+
+  static uint64_t CellKey (int64_t x, int64_t y)
+  {
+    return (static_cast<uint64_t> (static_cast<uint32_t> (x)) << 32) | static_cast<uint32_t> (y);
+  }
+
+  /**
+   * \brief Derive the cell size, bin the receivers whose mobility model
+   * became known, and re-bin all of them once per RefreshInterval.
+   *
+   * Only the unbound receivers are visited on every frame; the others
+   * are kept in place by their CourseChange.
+   */
+  void UpdateIndex (void)
+  {
+    bool refresh = Simulator::Now () - m_lastRefresh >= m_refreshInterval;
+    if (m_cellSize <= 0)
+      {
+        m_cellSize = m_maxRange > 0 ? m_maxRange : DeriveMaxRange ();
+        if (m_cellSize <= 0)
+          {
+            return;
+          }
+        refresh = true;
+      }
+    if (refresh)
+      {
+        m_lastRefresh = Simulator::Now ();
+        m_maxSpeed = 0;
+        for (uint32_t i = 0; i < m_receivers.size (); ++i)
+          {
+            if (m_receivers[i].mobility != 0)
+              {
+                Bin (i);
+              }
+          }
+      }
+    uint32_t kept = 0;
+    for (uint32_t k = 0; k < m_unbound.size (); ++k)
+      {
+        uint32_t i = m_unbound[k];
+        if (Bind (i))
+          {
+            Bin (i);
+          }
+        else
+          {
+            m_unbound[kept++] = i;
+          }
+      }
+    m_unbound.resize (kept);
+  }
+
+  /// \return true if the mobility model of receiver i is known, and follow it
+  bool Bind (uint32_t i)
+  {
+    Receiver &rx = m_receivers[i];
+    rx.mobility = rx.phy->GetMobility ();
+    if (rx.mobility == 0)
+      {
+        return false;
+      }
+    m_byMobility[PeekPointer (rx.mobility)] = i;
+    rx.row = GetRow (rx.mobility);
+    rx.mobility->TraceConnectWithoutContext ("CourseChange",
+                                             MakeCallback (&SpatialIndexSpectrumChannel::CourseChanged, this));
+    return true;
+  }
+
+  /// Move receiver i to the cell of its current position.
+  void Bin (uint32_t i)
+  {
+    Receiver &rx = m_receivers[i];
+    if (rx.binned)
+      {
+        std::vector<uint32_t> &old = m_grid[rx.cell];
+        old[rx.slot] = old.back ();
+        m_receivers[old[rx.slot]].slot = rx.slot;
+        old.pop_back ();
+      }
+    Vector pos = rx.mobility->GetPosition ();
+    Vector vel = rx.mobility->GetVelocity ();
+    m_maxSpeed = std::max (m_maxSpeed, std::sqrt (vel.x * vel.x + vel.y * vel.y));
+    rx.cell = CellKey (CellCoordinate (pos.x), CellCoordinate (pos.y));
+    std::vector<uint32_t> &cell = m_grid[rx.cell];
+    rx.slot = cell.size ();
+    cell.push_back (i);
+    rx.binned = true;
+  }
+
+  void CourseChanged (Ptr<const MobilityModel> mobility)
+  {
+    if (m_cellSize <= 0)
+      {
+        return;
+      }
+    std::map<const MobilityModel *, uint32_t>::const_iterator it = m_byMobility.find (PeekPointer (mobility));
+    if (it != m_byMobility.end ())
+      {
+        Bin (it->second);
+      }
+  }
+
+  /**
+   * \param mobility a mobility model
+   * \return its row in m_positions, or -1 if it is not a view of that
+   *         table (the first view seen selects the table)
+   */
+  int64_t GetRow (Ptr<MobilityModel> mobility)
+  {
+    Ptr<SoaMobilityModel> view = DynamicCast<SoaMobilityModel> (mobility);
+    if (view == 0)
+      {
+        return -1;
+      }
+    if (m_positions == 0)
+      {
+        m_positions = view->GetTable ();
+      }
+    return view->GetTable () == m_positions ? view->GetIndex () : -1;
+  }
+
+  /**
+   * \brief Drop the candidates of m_batch farther than the range, with
+   * one batched distance computation, when the sender and all of them
+   * are rows of m_positions.  The loss model is then only evaluated
+   * within range, so it must not decrease with distance, as MaxLossDb
+   * already assumes.
+   */
+  void FilterByDistance (Ptr<MobilityModel> senderMobility)
+  {
+    if (m_positions == 0 || m_batch.empty ())
+      {
+        return;
+      }
+    int64_t from = GetRow (senderMobility);
+    if (from < 0)
+      {
+        return;
+      }
+    m_rows.clear ();
+    for (uint32_t k = 0; k < m_batch.size (); ++k)
+      {
+        if (m_receivers[m_batch[k]].row < 0)
+          {
+            return;
+          }
+        m_rows.push_back (m_receivers[m_batch[k]].row);
+      }
+    m_positions->GetDistances (from, m_rows, m_distances);
+    uint32_t kept = 0;
+    for (uint32_t k = 0; k < m_batch.size (); ++k)
+      {
+        if (m_distances[k] <= m_cellSize)
+          {
+            m_batch[kept++] = m_batch[k];
+          }
+      }
+    m_outOfRange += m_batch.size () - kept;
+    m_batch.resize (kept);
+  }
+
+  /// \return the distance at which the loss model reaches MaxLossDb
+  double DeriveMaxRange (void) const
+  {
+    if (m_propagationLoss == 0 || m_maxLossDb >= 1e8)
+      {
+        return 0;
+      }
+    Ptr<MobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+    Ptr<MobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+    double lo = 0;
+    double hi = 1;
+    for (b->SetPosition (Vector (hi, 0, 0));
+         -m_propagationLoss->CalcRxPower (0, a, b) <= m_maxLossDb;
+         b->SetPosition (Vector (hi, 0, 0)))
+      {
+        lo = hi;
+        hi *= 2;
+        if (hi > 1e7)
+          {
+            return 0;
+          }
+      }
+    for (int k = 0; k < 60; ++k)
+      {
+        double mid = (lo + hi) / 2;
+        b->SetPosition (Vector (mid, 0, 0));
+        if (-m_propagationLoss->CalcRxPower (0, a, b) <= m_maxLossDb)
+          {
+            lo = mid;
+          }
+        else
+          {
+            hi = mid;
+          }
+      }
+    return hi;
+  }
+
+  /// \return the path loss (dB) between two mobility models
+  double GetPathLossDb (Ptr<MobilityModel> sender, Ptr<MobilityModel> receiver) const
+  {
+    return m_propagationLoss ? -m_propagationLoss->CalcRxPower (0, sender, receiver) : 0;
+  }
+
+  /// Deliver the frame to receiver i if it is within MaxLossDb.
+  void TryDeliver (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility,
+                   uint32_t i, std::vector<uint32_t> &delivered)
+  {
+    Ptr<SpectrumPhy> rxPhy = m_receivers[i].phy;
+    if (rxPhy == txParams->txPhy)
+      {
+        return;
+      }
+    ++m_candidates;
+    Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+    Time delay = MicroSeconds (0);
+    Ptr<MobilityModel> receiverMobility = rxPhy->GetMobility ();
+    if (senderMobility && receiverMobility)
+      {
+        double pathLossDb = GetPathLossDb (senderMobility, receiverMobility);
+        m_pathLossTrace (txParams->txPhy, rxPhy, pathLossDb);
+        if (pathLossDb > m_maxLossDb)
+          {
+            return;
+          }
+        *(rxParams->psd) *= std::pow (10.0, -pathLossDb / 10.0);
+        if (m_spectrumPropagationLoss)
+          {
+            rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, senderMobility, receiverMobility);
+          }
+        if (m_propagationDelay)
+          {
+            delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+          }
+      }
+    delivered.push_back (i);
+    Ptr<NetDevice> netDev = rxPhy->GetDevice ();
+    if (netDev)
+      {
+        Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), delay,
+                                        &SpatialIndexSpectrumChannel::StartRx, rxParams, rxPhy);
+      }
+    else
+      {
+        Simulator::Schedule (delay, &SpatialIndexSpectrumChannel::StartRx, rxParams, rxPhy);
+      }
+  }
+
+  /**
+   * \brief Check the delivered set against an unfiltered scan of every
+   * PHY of the channel: every PHY that receives at least the validation
+   * sensitivity must have been delivered the frame.
+   */
+  void Validate (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility,
+                 std::vector<uint32_t> delivered)
+  {
+    std::sort (delivered.begin (), delivered.end ());
+    uint32_t missed = 0;
+    double strongestMissedDbm = -1e9;
+    for (uint32_t i = 0; i < m_receivers.size (); ++i)
+      {
+        Ptr<SpectrumPhy> rxPhy = m_receivers[i].phy;
+        if (rxPhy == txParams->txPhy || std::binary_search (delivered.begin (), delivered.end (), i))
+          {
+            continue;
+          }
+        double rxPowerDbm = GetRxPowerDbm (txParams, senderMobility, rxPhy->GetMobility ());
+        if (rxPowerDbm >= m_validationSensitivityDbm)
+          {
+            ++missed;
+            strongestMissedDbm = std::max (strongestMissedDbm, rxPowerDbm);
+          }
+      }
+    if (missed > 0)
+      {
+        ++m_mismatches;
+        NS_LOG_UNCOND ("SpatialIndexSpectrumChannel: at " << Simulator::Now ().GetSeconds ()
+                       << "s delivered " << delivered.size () << " frames, missed " << missed
+                       << " receivers of up to " << strongestMissedDbm << " dBm");
+      }
+  }
+
+  /// \return the received power (dBm) of a frame as the unfiltered channel computes it
+  double GetRxPowerDbm (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility,
+                        Ptr<MobilityModel> receiverMobility) const
+  {
+    Ptr<SpectrumValue> psd = txParams->psd->Copy ();
+    if (senderMobility && receiverMobility)
+      {
+        *psd *= std::pow (10.0, -GetPathLossDb (senderMobility, receiverMobility) / 10.0);
+        if (m_spectrumPropagationLoss)
+          {
+            psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (psd, senderMobility, receiverMobility);
+          }
+      }
+    double watts = Integral (*psd);
+    return watts > 0 ? 10 * std::log10 (watts * 1000) : -1e9;
+  }
+
+  static void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+  {
+    receiver->StartRx (params);
+  }
+
+  double m_maxRange;                  //!< configured range, 0 to derive it
+  Time m_refreshInterval;             //!< period of the full re-binning
+  bool m_validate;                    //!< compare with the unfiltered scan
+  double m_validationSensitivityDbm;  //!< weakest power that must be delivered
+  double m_cellSize;                  //!< range in use, also the cell size
+  double m_maxSpeed;                  //!< fastest node since last refresh
+  Time m_lastRefresh;                 //!< time of the last full re-binning
+  std::vector<Receiver> m_receivers;  //!< every PHY on the channel
+  std::map<uint64_t, std::vector<uint32_t> > m_grid; //!< cell -> receivers
+  std::map<const MobilityModel *, uint32_t> m_byMobility; //!< mobility -> receiver
+  std::vector<uint32_t> m_unbound;    //!< receivers with no mobility model yet
+  uint64_t m_transmissions;           //!< frames sent on the channel
+  uint64_t m_candidates;              //!< receivers evaluated
+  uint64_t m_deliveries;              //!< receptions scheduled
+  uint64_t m_mismatches;              //!< sets that failed validation
+  Ptr<PositionTable> m_positions;     //!< table of the receivers, if any
+  std::vector<uint32_t> m_batch;      //!< candidate receivers of a frame
+  std::vector<uint32_t> m_rows;       //!< their rows in m_positions
+  std::vector<double> m_distances;    //!< their distances to the sender
+  uint64_t m_outOfRange;              //!< candidates dropped by distance
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SpatialIndexSpectrumChannel);
+
+} // namespace ns3
+
+#endif /* SPATIAL_INDEX_SPECTRUM_CHANNEL_H */
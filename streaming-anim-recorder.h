@@ -0,0 +1,289 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef STREAMING_ANIM_RECORDER_H
+#define STREAMING_ANIM_RECORDER_H
+
+//
+// NetAnim recorder with bounded memory.
+//
+// AnimationInterface records every course change and keeps every wifi
+// packet in flight in its own tables until it is received.  This
+// recorder writes the NetAnim XML as it goes instead:
+//
+//  - node positions are sampled every "position period" and only the
+//    nodes that moved since the last sample are written;
+//  - a wifi frame is written as AnimationInterface writes it: a "wpr"
+//    with its sender and first and last bit sent (fbTx, lbTx) when its
+//    transmission ends, and a "wpr" with the receiver and first and last
+//    bit received (fbRx, lbRx) when each receiver gets it, keyed by the
+//    packet uid;
+//  - only one packet in "sampling" (by uid) is recorded, and at most
+//    "maxPacketsPerSecond" per second of simulated time.  Transmission
+//    ends and receptions are matched against a fixed-size table of
+//    recently recorded uids and their transmission times.
+//
+// Memory use only depends on the number of nodes.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/node.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+
+namespace ns3 {
+
+/**
+ * \brief Write a NetAnim trace with sampled positions and rate-limited
+ * packet records.
+ */
+class StreamingAnimRecorder
+{
+public:
+  StreamingAnimRecorder ()
+    : m_positionPeriod (Seconds (1)),
+      m_sampling (1),
+      m_maxPacketsPerSecond (1000),
+      m_recent (4096, ~static_cast<uint64_t> (0)),
+      m_fbTx (4096, 0),
+      m_txDuration (4096, 0),
+      m_second (-1),
+      m_packetsThisSecond (0),
+      m_dropped (0)
+  {
+  }
+
+  ~StreamingAnimRecorder ()
+  {
+    Close ();
+  }
+
+  /// \param period interval between two position samples
+  void SetPositionPeriod (Time period)
+  {
+    m_positionPeriod = period;
+  }
+
+  /// \param sampling record one packet in this many (by packet uid)
+  void SetPacketSampling (uint32_t sampling)
+  {
+    m_sampling = sampling == 0 ? 1 : sampling;
+  }
+
+  /// \param maxPacketsPerSecond packet records per simulated second, 0 for none
+  void SetMaxPacketsPerSecond (uint32_t maxPacketsPerSecond)
+  {
+    m_maxPacketsPerSecond = maxPacketsPerSecond;
+  }
+
+  /**
+   * \brief Start recording the given nodes and their wifi devices.
+   * \param filename the NetAnim XML file
+   * \param nodes the nodes to animate
+   */
+  void Install (std::string filename, NodeContainer nodes)
+  {
+    m_file.open (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (m_file.is_open (), "StreamingAnimRecorder: cannot open " << filename);
+    m_nodes = nodes;
+    m_last.assign (nodes.GetN (), Vector (NAN, NAN, NAN));
+
+    double minX = 0, minY = 0, maxX = 0, maxY = 0;
+    for (uint32_t i = 0; i < nodes.GetN (); ++i)
+      {
+        Vector pos = GetPosition (nodes.Get (i));
+        minX = i == 0 ? pos.x : std::min (minX, pos.x);
+        minY = i == 0 ? pos.y : std::min (minY, pos.y);
+        maxX = i == 0 ? pos.x : std::max (maxX, pos.x);
+        maxY = i == 0 ? pos.y : std::max (maxY, pos.y);
+      }
+    m_file << "<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n";
+    m_file << "<topology minX=\"" << minX << "\" minY=\"" << minY
+           << "\" maxX=\"" << maxX << "\" maxY=\"" << maxY << "\" >\n";
+    for (uint32_t i = 0; i < nodes.GetN (); ++i)
+      {
+        Ptr<Node> node = nodes.Get (i);
+        Vector pos = GetPosition (node);
+        m_last[i] = pos;
+        m_file << "<node id=\"" << node->GetId () << "\" sysId=\"0\" locX=\"" << pos.x
+               << "\" locY=\"" << pos.y << "\" />\n";
+        for (uint32_t d = 0; d < node->GetNDevices (); ++d)
+          {
+            Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (node->GetDevice (d));
+            if (device == 0)
+              {
+                continue;
+              }
+            Ptr<Context> ctx = Create<Context> ();
+            ctx->recorder = this;
+            ctx->node = node->GetId ();
+            device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&StreamingAnimRecorder::TxSink, ctx));
+            device->GetPhy ()->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&StreamingAnimRecorder::TxEndSink, ctx));
+            device->GetPhy ()->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&StreamingAnimRecorder::RxSink, ctx));
+          }
+      }
+    m_file << "</topology>\n";
+    m_sampleEvent = Simulator::Schedule (m_positionPeriod, &StreamingAnimRecorder::SamplePositions, this);
+  }
+
+  /// \brief Finish the XML document and close the file.
+  void Close (void)
+  {
+    if (!m_file.is_open ())
+      {
+        return;
+      }
+    Simulator::Cancel (m_sampleEvent);
+    m_file << "</anim>\n";
+    m_file.close ();
+  }
+
+  /// \return number of packet records dropped by sampling or rate limiting
+  uint64_t GetDropped (void) const
+  {
+    return m_dropped;
+  }
+
+private:
+  /// What a trace sink needs to know about its device.
+  struct Context : public SimpleRefCount<Context>
+  {
+    StreamingAnimRecorder *recorder;  //!< the recorder
+    uint32_t node;                    //!< node id
+  };
+
+  static Vector GetPosition (Ptr<Node> node)
+  {
+    Ptr<MobilityModel> mobility = node->GetObject<MobilityModel> ();
+    return mobility == 0 ? Vector () : mobility->GetPosition ();
+  }
+
+  void SamplePositions (void)
+  {
+    double now = Simulator::Now ().GetSeconds ();
+    for (uint32_t i = 0; i < m_nodes.GetN (); ++i)
+      {
+        Vector pos = GetPosition (m_nodes.Get (i));
+        if (pos.x == m_last[i].x && pos.y == m_last[i].y)
+          {
+            continue;
+          }
+        m_last[i] = pos;
+        m_file << "<nu p=\"p\" t=\"" << now << "\" id=\"" << m_nodes.Get (i)->GetId ()
+               << "\" x=\"" << pos.x << "\" y=\"" << pos.y << "\" />\n";
+      }
+    m_sampleEvent = Simulator::Schedule (m_positionPeriod, &StreamingAnimRecorder::SamplePositions, this);
+  }
+
+  /// \return true if the transmission of this packet is to be recorded
+  bool Admit (uint64_t uid)
+  {
+    if (uid % m_sampling != 0)
+      {
+        ++m_dropped;
+        return false;
+      }
+    int64_t second = static_cast<int64_t> (Simulator::Now ().GetSeconds ());
+    if (second != m_second)
+      {
+        m_second = second;
+        m_packetsThisSecond = 0;
+      }
+    if (m_packetsThisSecond >= m_maxPacketsPerSecond)
+      {
+        ++m_dropped;
+        return false;
+      }
+    ++m_packetsThisSecond;
+    uint32_t slot = uid % m_recent.size ();
+    m_recent[slot] = uid;
+    m_fbTx[slot] = Simulator::Now ().GetSeconds ();
+    m_txDuration[slot] = 0;
+    return true;
+  }
+
+  static void TxSink (Ptr<Context> ctx, Ptr<const Packet> p, double txPowerW)
+  {
+    StreamingAnimRecorder *r = ctx->recorder;
+    if (r->m_file.is_open ())
+      {
+        r->Admit (p->GetUid ());
+      }
+  }
+
+  static void TxEndSink (Ptr<Context> ctx, Ptr<const Packet> p)
+  {
+    StreamingAnimRecorder *r = ctx->recorder;
+    uint64_t uid = p->GetUid ();
+    uint32_t slot = uid % r->m_recent.size ();
+    if (!r->m_file.is_open () || r->m_recent[slot] != uid)
+      {
+        return;
+      }
+    double now = Simulator::Now ().GetSeconds ();
+    r->m_txDuration[slot] = now - r->m_fbTx[slot];
+    r->m_file << "<wpr uId=\"" << uid << "\" fId=\"" << ctx->node
+              << "\" fbTx=\"" << r->m_fbTx[slot] << "\" lbTx=\"" << now << "\" />\n";
+  }
+
+  static void RxSink (Ptr<Context> ctx, Ptr<const Packet> p)
+  {
+    StreamingAnimRecorder *r = ctx->recorder;
+    uint64_t uid = p->GetUid ();
+    uint32_t slot = uid % r->m_recent.size ();
+    if (!r->m_file.is_open () || r->m_recent[slot] != uid)
+      {
+        return;
+      }
+    // The last bit arrives now, one transmission time after the first
+    double now = Simulator::Now ().GetSeconds ();
+    r->m_file << "<wpr uId=\"" << uid << "\" tId=\"" << ctx->node
+              << "\" fbRx=\"" << now - r->m_txDuration[slot] << "\" lbRx=\"" << now << "\" />\n";
+  }
+
+  std::ofstream m_file;               //!< the NetAnim XML file
+  NodeContainer m_nodes;              //!< animated nodes
+  std::vector<Vector> m_last;         //!< last written position of each node
+  Time m_positionPeriod;              //!< interval between position samples
+  uint32_t m_sampling;                //!< record one packet in this many
+  uint32_t m_maxPacketsPerSecond;     //!< packet records per simulated second
+  std::vector<uint64_t> m_recent;     //!< uids of recently recorded packets
+  std::vector<double> m_fbTx;         //!< their first bit sent (s)
+  std::vector<double> m_txDuration;   //!< their transmission time (s)
+  int64_t m_second;                   //!< current second of the rate limit
+  uint32_t m_packetsThisSecond;       //!< packets recorded in that second
+  uint64_t m_dropped;                 //!< packet records not written
+  EventId m_sampleEvent;              //!< next position sample
+};
+
+} // namespace ns3
+
+#endif /* STREAMING_ANIM_RECORDER_H */
@@ -0,0 +1,841 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TOPOLOGY_BUILDER_H
+#define TOPOLOGY_BUILDER_H
+
+//
+// Declarative description and batched construction of the mixed
+// wireless topology: an adhoc backbone whose every node heads a LAN of
+// stations on its own channel, with OLSR everywhere, hierarchical
+// mobility for the stations and one OnOff flow.
+//
+// A TopologySpec holds the parameters as flat keys with defaults and can
+// be loaded from a JSON file; only the keys given in the file change:
+//
+//   {
+//     "backbone": { "nodes": 6, "dataMode": "OfdmRate54Mbps", "network": "192.168.0.0" },
+//     "lans": { "stations": 5, "dataMode": "OfdmRate54Mbps", "network": "172.16.0.0",
+//               "phy": "yans", "phyTable": "mixed-wireless-lanphy.csv" },
+//     "mobility": { "minX": 20, "minY": 20, "deltaX": 20, "deltaY": 20, "gridWidth": 5,
+//                   "bounds": [-500, 500, -500, 500], "speed": 2, "pause": 0.2,
+//                   "engine": "model" },
+//     "traffic": { "meanPacketsPerSecond": 10, "packetSize": 1000,
+//                  "dataRate": "50Mbps", "port": 9, "start": 3, "generator": "onoff",
+//                  "matrix": "none", "matrixFlows": 100 },
+//     "stack": { "ipv6": 1, "queueDiscs": 1, "streams": "auto" }
+//   }
+//
+// Every network is a /24; LAN i uses the i-th /24 after lans.network,
+// all of them within the /16 of lans.network, so a spec has at most
+// 256 LANs (fewer if lans.network does not start its /16) of at most
+// 253 stations.
+// The flow goes from the first station of the first LAN to the last
+// station of the last LAN.
+//
+// TopologyBuilder configures every helper, factory and attribute once
+// and then creates the nodes, devices, stacks, addresses, mobility
+// models and applications phase by phase over all the LANs, timing each
+// phase.  It can build a single partition (the backbone, or one LAN)
+// for the parallel mode.  stack.streams "auto" leaves the random
+// streams in creation order, as the original scenario did; "partition"
+// assigns them from the node or partition, so that every partition sees
+// the same random numbers whatever else is built, and a single
+// partition needs it.  The devices of a LAN get a fixed block of
+// LAN_PHY_STREAMS streams, so that its stack draws the same streams
+// with either lans.phy.
+//
+// With mobility.engine "soa" every node gets a view of one shared
+// PositionTable (see soa-mobility.h) driven by its random direction
+// model, the stations relative to their backbone node; the Yans
+// channels read the positions one node at a time, so this saves the
+// calls into the drivers but has no batched pass.  With
+// traffic.generator "burst" the source is a BurstOnOffApplication (see
+// burst-onoff-application.h), which sends at the same times with fewer
+// events.  traffic.matrix adds many flows between the stations, at the
+// rate and size of the OnOff flow (see traffic-matrix.h): "gateway" from
+// every station to the sink station, "random" between
+// traffic.matrixFlows random pairs, or a flow file whose node indices
+// count the stations LAN by LAN.  Its sinks listen on traffic.port + 1;
+// the matrix needs every partition.
+//
+// stack.ipv6 0 leaves out the IPv6 stack, which nothing here uses, and
+// stack.queueDiscs 0 removes the queue discs that address assignment
+// puts under every device, the wifi MAC queues sufficing: both cut the
+// memory of every node.  The heap blocks allocated in each phase are
+// charged to it for MemoryAccounting (see memory-accounting.h).
+//
+// lans.phy "abstract" replaces the wifi devices of the LANs with
+// SimpleNetDevices on one AbstractLanChannel per LAN (see
+// abstract-lan-channel.h), at the rate of lans.dataMode and with the
+// frame error rates of the PerTable in lans.phyTable.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/application-container.h"
+#include "ns3/double.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/mobility-model.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node-container.h"
+#include "ns3/object-factory.h"
+#include "ns3/olsr-helper.h"
+#include "ns3/onoff-application.h"
+#include "ns3/packet-sink.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/pointer.h"
+#include "ns3/position-allocator.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/rectangle.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/string.h"
+#include "ns3/traffic-control-helper.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+#include "ns3/yans-wifi-helper.h"
+
+#include "abstract-lan-channel.h"
+#include "burst-onoff-application.h"
+#include "soa-mobility.h"
+#include "traffic-matrix.h"
+#include "memory-accounting.h"
+
+namespace ns3 {
+
+/**
+ * \brief Parameters of the mixed wireless topology, as flat keys such as
+ * "backbone.nodes" or "mobility.bounds[2]".
+ */
+class TopologySpec
+{
+public:
+  TopologySpec ()
+  {
+    Set ("backbone.nodes", "6");
+    Set ("backbone.dataMode", "OfdmRate54Mbps");
+    Set ("backbone.network", "192.168.0.0");
+    Set ("lans.stations", "5");
+    Set ("lans.dataMode", "OfdmRate54Mbps");
+    Set ("lans.network", "172.16.0.0");
+    Set ("lans.phy", "yans");
+    Set ("lans.phyTable", "mixed-wireless-lanphy.csv");
+    Set ("mobility.minX", "20");
+    Set ("mobility.minY", "20");
+    Set ("mobility.deltaX", "20");
+    Set ("mobility.deltaY", "20");
+    Set ("mobility.gridWidth", "5");
+    Set ("mobility.bounds[0]", "-500");
+    Set ("mobility.bounds[1]", "500");
+    Set ("mobility.bounds[2]", "-500");
+    Set ("mobility.bounds[3]", "500");
+    Set ("mobility.speed", "2");
+    Set ("mobility.pause", "0.2");
+    Set ("mobility.engine", "model");
+    Set ("traffic.meanPacketsPerSecond", "10");
+    Set ("traffic.packetSize", "1000");
+    Set ("traffic.dataRate", "50Mbps");
+    Set ("traffic.port", "9");
+    Set ("traffic.start", "3");
+    Set ("traffic.generator", "onoff");
+    Set ("traffic.matrix", "none");
+    Set ("traffic.matrixFlows", "100");
+    Set ("stack.ipv6", "1");
+    Set ("stack.queueDiscs", "1");
+    Set ("stack.streams", "auto");
+  }
+
+  /// \param key a key \param value its new value
+  void Set (std::string key, std::string value)
+  {
+    m_values[key] = value;
+  }
+
+  /// \param key a key \param value its new value
+  void Set (std::string key, double value)
+  {
+    std::ostringstream oss;
+    oss << value;
+    m_values[key] = oss.str ();
+  }
+
+  /// \param key a key \return its value
+  std::string Get (std::string key) const
+  {
+    std::map<std::string, std::string>::const_iterator i = m_values.find (key);
+    NS_ABORT_MSG_IF (i == m_values.end (), "TopologySpec: no key " << key);
+    return i->second;
+  }
+
+  /// \param key a key \return its value as a number
+  double GetDouble (std::string key) const
+  {
+    return std::atof (Get (key).c_str ());
+  }
+
+  /// \param key a key \return its value as an unsigned integer
+  uint32_t GetUinteger (std::string key) const
+  {
+    return static_cast<uint32_t> (std::atol (Get (key).c_str ()));
+  }
+
+  /**
+   * \brief Override the keys given in a JSON file.
+   * \param filename the file
+   *
+   * Keys that have no default are rejected, to catch typos.
+   */
+  void Load (std::string filename)
+  {
+    std::ifstream is (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (is.is_open (), "TopologySpec: cannot open " << filename);
+    std::ostringstream text;
+    text << is.rdbuf ();
+    std::map<std::string, std::string> values;
+    std::string s = text.str ();
+    std::string::size_type pos = 0;
+    Parse (s, pos, "", values);
+    for (std::map<std::string, std::string>::const_iterator i = values.begin (); i != values.end (); ++i)
+      {
+        NS_ABORT_MSG_UNLESS (m_values.count (i->first), filename << ": unknown key " << i->first);
+        m_values[i->first] = i->second;
+      }
+  }
+
+private:
+  static void SkipSpace (const std::string &s, std::string::size_type &pos)
+  {
+    while (pos < s.size () && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+      {
+        ++pos;
+      }
+  }
+
+  static void Expect (const std::string &s, std::string::size_type &pos, char c)
+  {
+    SkipSpace (s, pos);
+    NS_ABORT_MSG_UNLESS (pos < s.size () && s[pos] == c,
+                         "TopologySpec: expected '" << c << "' at offset " << pos);
+    ++pos;
+  }
+
+  static std::string ParseString (const std::string &s, std::string::size_type &pos)
+  {
+    Expect (s, pos, '"');
+    std::string value;
+    while (pos < s.size () && s[pos] != '"')
+      {
+        if (s[pos] == '\\' && pos + 1 < s.size ())
+          {
+            ++pos;
+          }
+        value += s[pos++];
+      }
+    Expect (s, pos, '"');
+    return value;
+  }
+
+  /// Parse a JSON value into flat keys under path.
+  static void Parse (const std::string &s, std::string::size_type &pos, std::string path,
+                     std::map<std::string, std::string> &values)
+  {
+    SkipSpace (s, pos);
+    NS_ABORT_MSG_IF (pos >= s.size (), "TopologySpec: unexpected end of file");
+    if (s[pos] == '{')
+      {
+        ++pos;
+        SkipSpace (s, pos);
+        while (pos < s.size () && s[pos] != '}')
+          {
+            std::string key = ParseString (s, pos);
+            Expect (s, pos, ':');
+            Parse (s, pos, path.empty () ? key : path + "." + key, values);
+            SkipSpace (s, pos);
+            if (pos < s.size () && s[pos] == ',')
+              {
+                ++pos;
+                SkipSpace (s, pos);
+              }
+          }
+        Expect (s, pos, '}');
+      }
+    else if (s[pos] == '[')
+      {
+        ++pos;
+        SkipSpace (s, pos);
+        for (uint32_t index = 0; pos < s.size () && s[pos] != ']'; ++index)
+          {
+            std::ostringstream key;
+            key << path << "[" << index << "]";
+            Parse (s, pos, key.str (), values);
+            SkipSpace (s, pos);
+            if (pos < s.size () && s[pos] == ',')
+              {
+                ++pos;
+              }
+            SkipSpace (s, pos);
+          }
+        Expect (s, pos, ']');
+      }
+    else if (s[pos] == '"')
+      {
+        values[path] = ParseString (s, pos);
+      }
+    else
+      {
+        std::string::size_type end = s.find_first_of (",}] \t\r\n", pos);
+        values[path] = s.substr (pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? s.size () : end;
+      }
+  }
+
+  std::map<std::string, std::string> m_values;  //!< value of every key
+};
+
+/**
+ * \brief Build the mixed wireless topology of a TopologySpec in batches.
+ */
+class TopologyBuilder
+{
+public:
+  /// Construction phases, in order.
+  enum Phase
+  {
+    NODES = 0,
+    DEVICES,
+    INTERNET,
+    ADDRESSES,
+    MOBILITY,
+    STREAMS,
+    APPLICATIONS,
+    N_PHASES
+  };
+
+  // Stream numbers: per partition for the devices and protocol stacks,
+  // per node for the mobility models.
+  static const int64_t PARTITION_STREAM_BASE = 1000000;
+  static const int64_t PARTITION_STREAM_STRIDE = 100000;
+  static const int64_t LAN_PHY_STREAMS = 10000;
+  static const int64_t MOBILITY_STREAM_BASE = 100000000;
+  static const int64_t MOBILITY_STREAM_STRIDE = 16;
+  static const int64_t APPLICATION_STREAM = 1;
+  static const int64_t MATRIX_STREAM = 2;
+
+  /**
+   * \param spec the topology
+   * \param partition partition to build: 0 for the backbone, i + 1 for
+   *        the LAN of backbone node i, -1 for all of them
+   */
+  TopologyBuilder (const TopologySpec &spec, int32_t partition)
+    : m_spec (spec)
+  {
+    uint32_t nPartitions = spec.GetUinteger ("backbone.nodes") + 1;
+    m_built.assign (nPartitions, partition < 0);
+    if (partition >= 0)
+      {
+        m_built[partition] = true;
+      }
+    for (uint32_t i = 0; i < N_PHASES; ++i)
+      {
+        m_seconds[i] = 0;
+      }
+  }
+
+  /**
+   * \brief Build the topology.
+   * \param stopTime time (s) at which the OnOff application stops
+   */
+  void Build (double stopTime)
+  {
+    uint32_t backboneNodes = m_spec.GetUinteger ("backbone.nodes");
+    uint32_t stations = m_spec.GetUinteger ("lans.stations");
+    NS_ABORT_MSG_UNLESS (backboneNodes > 0 && stations > 0, "TopologyBuilder: empty backbone or LAN");
+    uint32_t lanNetwork = Ipv4Address (m_spec.Get ("lans.network").c_str ()).Get ();
+    NS_ABORT_MSG_IF ((lanNetwork & 0xffff) + (static_cast<uint64_t> (backboneNodes) << 8) > 0x10000,
+                     "TopologyBuilder: " << backboneNodes << " LANs do not fit in the /16 of lans.network "
+                     << m_spec.Get ("lans.network"));
+    NS_ABORT_MSG_IF (stations > 253, "TopologyBuilder: " << stations << " stations do not fit in a /24");
+    std::string streams = m_spec.Get ("stack.streams");
+    NS_ABORT_MSG_UNLESS (streams == "auto" || streams == "partition", "TopologyBuilder: unknown stack.streams " << streams);
+    NS_ABORT_MSG_IF (streams == "auto" && std::find (m_built.begin (), m_built.end (), false) != m_built.end (),
+                     "TopologyBuilder: a single partition needs stack.streams \"partition\"");
+
+    //
+    // Nodes: all of them, whatever the partition, so that ids are the
+    // same in every partition
+    //
+    Clock::time_point start = Clock::now ();
+    MemoryAccounting::Scope memoryScope (GetPhaseName (NODES));
+    m_backbone.Create (backboneNodes);
+    m_lans.resize (backboneNodes);
+    for (uint32_t i = 0; i < backboneNodes; ++i)
+      {
+        m_lans[i].Create (stations);
+      }
+    start = EndPhase (NODES, start);
+
+    //
+    // Devices: one helper for the backbone and one for all the LANs; a
+    // new channel per LAN from the same channel helper, or an abstract
+    // channel per LAN sharing one PerTable
+    //
+    WifiMacHelper mac;
+    mac.SetType ("ns3::AdhocWifiMac");
+    YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
+    YansWifiPhyHelper phy;
+    phy.SetPcapDataLinkType (WifiPhyHelper::DLT_IEEE802_11_RADIO);
+    WifiHelper backboneWifi;
+    backboneWifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                          "DataMode", StringValue (m_spec.Get ("backbone.dataMode")));
+    WifiHelper lanWifi;
+    lanWifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
+                                     "DataMode", StringValue (m_spec.Get ("lans.dataMode")));
+    if (m_built[0])
+      {
+        phy.SetChannel (channel.Create ());
+        m_backboneDevices = backboneWifi.Install (phy, mac, m_backbone);
+      }
+    std::string lanPhy = m_spec.Get ("lans.phy");
+    NS_ABORT_MSG_UNLESS (lanPhy == "yans" || lanPhy == "abstract", "TopologyBuilder: unknown lans.phy " << lanPhy);
+    Ptr<PerTable> perTable;
+    SimpleNetDeviceHelper simple;
+    if (lanPhy == "abstract")
+      {
+        perTable = Create<PerTable> ();
+        perTable->Load (m_spec.Get ("lans.phyTable"));
+      }
+    m_lanDevices.resize (backboneNodes);
+    m_lanChannels.resize (backboneNodes);
+    for (uint32_t i = 0; i < backboneNodes; ++i)
+      {
+        if (!m_built[i + 1])
+          {
+            continue;
+          }
+        if (perTable != 0)
+          {
+            m_lanChannels[i] = CreateObject<AbstractLanChannel> ();
+            m_lanChannels[i]->SetAttribute ("DataRate", DataRateValue (GetLanDataRate ()));
+            m_lanChannels[i]->SetTable (perTable);
+            m_lanDevices[i] = simple.Install (m_lans[i], m_lanChannels[i]);
+          }
+        else
+          {
+            phy.SetChannel (channel.Create ());
+            m_lanDevices[i] = lanWifi.Install (phy, mac, m_lans[i]);
+          }
+      }
+    start = EndPhase (DEVICES, start);
+
+    //
+    // Internet stacks with OLSR, installed on every built node at once
+    //
+    OlsrHelper olsr;
+    InternetStackHelper internet;
+    internet.SetRoutingHelper (olsr);
+    internet.SetIpv6StackInstall (m_spec.GetUinteger ("stack.ipv6") != 0);
+    NodeContainer all;
+    if (m_built[0])
+      {
+        all.Add (m_backbone);
+      }
+    for (uint32_t i = 0; i < backboneNodes; ++i)
+      {
+        if (m_built[i + 1])
+          {
+            all.Add (m_lans[i]);
+          }
+      }
+    internet.Install (all);
+    start = EndPhase (INTERNET, start);
+
+    //
+    // Addresses: one /24 for the backbone and one per LAN
+    //
+    Ipv4AddressHelper ipAddrs;
+    if (m_built[0])
+      {
+        ipAddrs.SetBase (Ipv4Address (m_spec.Get ("backbone.network").c_str ()), "255.255.255.0");
+        ipAddrs.Assign (m_backboneDevices);
+      }
+    for (uint32_t i = 0; i < backboneNodes; ++i)
+      {
+        if (m_built[i + 1])
+          {
+            ipAddrs.SetBase (GetLanNetwork (i), "255.255.255.0");
+            ipAddrs.Assign (m_lanDevices[i]);
+          }
+      }
+    if (m_spec.GetUinteger ("stack.queueDiscs") == 0)
+      {
+        TrafficControlHelper trafficControl;
+        if (m_built[0])
+          {
+            trafficControl.Uninstall (m_backboneDevices);
+          }
+        for (uint32_t i = 0; i < backboneNodes; ++i)
+          {
+            if (m_built[i + 1])
+              {
+                trafficControl.Uninstall (m_lanDevices[i]);
+              }
+          }
+      }
+    start = EndPhase (ADDRESSES, start);
+
+    //
+    // Mobility: the backbone everywhere, since the stations move relative
+    // to their backbone node; a new grid allocator per LAN from one
+    // factory
+    //
+    ObjectFactory grid;
+    grid.SetTypeId ("ns3::GridPositionAllocator");
+    grid.Set ("MinX", DoubleValue (m_spec.GetDouble ("mobility.minX")));
+    grid.Set ("MinY", DoubleValue (m_spec.GetDouble ("mobility.minY")));
+    grid.Set ("DeltaX", DoubleValue (m_spec.GetDouble ("mobility.deltaX")));
+    grid.Set ("DeltaY", DoubleValue (m_spec.GetDouble ("mobility.deltaY")));
+    grid.Set ("GridWidth", UintegerValue (m_spec.GetUinteger ("mobility.gridWidth")));
+    grid.Set ("LayoutType", StringValue ("RowFirst"));
+    Ptr<ConstantRandomVariable> speed = CreateObject<ConstantRandomVariable> ();
+    speed->SetAttribute ("Constant", DoubleValue (m_spec.GetDouble ("mobility.speed")));
+    Ptr<ConstantRandomVariable> pause = CreateObject<ConstantRandomVariable> ();
+    pause->SetAttribute ("Constant", DoubleValue (m_spec.GetDouble ("mobility.pause")));
+    Rectangle bounds (m_spec.GetDouble ("mobility.bounds[0]"), m_spec.GetDouble ("mobility.bounds[1]"),
+                      m_spec.GetDouble ("mobility.bounds[2]"), m_spec.GetDouble ("mobility.bounds[3]"));
+    std::string engine = m_spec.Get ("mobility.engine");
+    NS_ABORT_MSG_UNLESS (engine == "model" || engine == "soa", "unknown mobility.engine " << engine);
+    ObjectFactory direction;
+    direction.SetTypeId ("ns3::RandomDirection2dMobilityModel");
+    direction.Set ("Bounds", RectangleValue (bounds));
+    direction.Set ("Speed", PointerValue (speed));
+    direction.Set ("Pause", PointerValue (pause));
+    MobilityHelper mobility;
+    if (engine == "soa")
+      {
+        m_positions = CreateObject<PositionTable> ();
+        mobility.SetMobilityModel ("ns3::SoaMobilityModel",
+                                   "Table", PointerValue (m_positions),
+                                   "Driver", ObjectFactoryValue (direction));
+      }
+    else
+      {
+        mobility.SetMobilityModel ("ns3::RandomDirection2dMobilityModel",
+                                   "Bounds", RectangleValue (bounds),
+                                   "Speed", PointerValue (speed),
+                                   "Pause", PointerValue (pause));
+      }
+    mobility.SetPositionAllocator (grid.Create<PositionAllocator> ());
+    mobility.Install (m_backbone);
+    for (uint32_t i = 0; i < backboneNodes; ++i)
+      {
+        if (!m_built[i + 1])
+          {
+            continue;
+          }
+        mobility.SetPositionAllocator (grid.Create<PositionAllocator> ());
+        if (m_positions != 0)
+          {
+            // The views of the stations hold their absolute positions
+            mobility.SetMobilityModel ("ns3::SoaMobilityModel",
+                                       "Table", PointerValue (m_positions),
+                                       "Driver", ObjectFactoryValue (direction),
+                                       "Parent", PointerValue (m_backbone.Get (i)->GetObject<MobilityModel> ()));
+            mobility.Install (m_lans[i]);
+          }
+        else
+          {
+            mobility.PushReferenceMobilityModel (m_backbone.Get (i));
+            mobility.Install (m_lans[i]);
+            mobility.PopReferenceMobilityModel ();
+          }
+      }
+    start = EndPhase (MOBILITY, start);
+
+    //
+    // Random streams, from the partition or the node
+    //
+    if (streams == "partition" && m_built[0])
+      {
+        int64_t stream = PARTITION_STREAM_BASE;
+        stream += backboneWifi.AssignStreams (m_backboneDevices, stream);
+        stream += internet.AssignStreams (m_backbone, stream);
+        olsr.AssignStreams (m_backbone, stream);
+      }
+    for (uint32_t i = 0; i < backboneNodes; ++i)
+      {
+        if (streams == "partition" && m_built[i + 1])
+          {
+            int64_t stream = PARTITION_STREAM_BASE + PARTITION_STREAM_STRIDE * (i + 1);
+            int64_t used = m_lanChannels[i] != 0 ? m_lanChannels[i]->AssignStreams (stream)
+                                                 : lanWifi.AssignStreams (m_lanDevices[i], stream);
+            NS_ABORT_MSG_IF (used > LAN_PHY_STREAMS, "TopologyBuilder: LAN " << i << " uses " << used
+                             << " device streams, more than LAN_PHY_STREAMS");
+            stream += LAN_PHY_STREAMS;
+            stream += internet.AssignStreams (m_lans[i], stream);
+            olsr.AssignStreams (m_lans[i], stream);
+            AssignMobilityStreams (m_lans[i]);
+          }
+      }
+    // The hierarchical models of the stations also assign the streams of
+    // their backbone node, so the backbone comes last.
+    if (streams == "partition")
+      {
+        AssignMobilityStreams (m_backbone);
+      }
+    start = EndPhase (STREAMS, start);
+
+    //
+    // Applications: an OnOff source on the first station of the first LAN
+    // and a sink on the last station of the last LAN
+    //
+    uint16_t port = static_cast<uint16_t> (m_spec.GetUinteger ("traffic.port"));
+    double appStart = m_spec.GetDouble ("traffic.start");
+    if (m_built[1])
+      {
+        m_offTime = CreateObject<ExponentialRandomVariable> ();
+        m_offTime->SetAttribute ("Mean", DoubleValue (1.0 / m_spec.GetDouble ("traffic.meanPacketsPerSecond")));
+        if (streams == "partition")
+          {
+            m_offTime->SetStream (APPLICATION_STREAM);
+          }
+        std::string generator = m_spec.Get ("traffic.generator");
+        NS_ABORT_MSG_UNLESS (generator == "onoff" || generator == "burst", "unknown traffic.generator " << generator);
+        ObjectFactory onoff;
+        onoff.SetTypeId (generator == "burst" ? "ns3::BurstOnOffApplication" : "ns3::OnOffApplication");
+        onoff.Set ("Protocol", TypeIdValue (UdpSocketFactory::GetTypeId ()));
+        onoff.Set ("Remote", AddressValue (InetSocketAddress (GetSinkAddress (), port)));
+        onoff.Set ("OnTime", PointerValue (CreateObject<ConstantRandomVariable> ()));
+        onoff.Set ("OffTime", PointerValue (m_offTime));
+        onoff.Set ("PacketSize", UintegerValue (m_spec.GetUinteger ("traffic.packetSize")));
+        onoff.Set ("DataRate", StringValue (m_spec.Get ("traffic.dataRate")));
+        Ptr<Application> source = onoff.Create<Application> ();
+        m_lans[0].Get (0)->AddApplication (source);
+        source->SetStartTime (Seconds (appStart));
+        source->SetStopTime (Seconds (stopTime - 1));
+      }
+    if (m_built[backboneNodes])
+      {
+        PacketSinkHelper sink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+        ApplicationContainer apps = sink.Install (m_lans[backboneNodes - 1].Get (stations - 1));
+        apps.Start (Seconds (appStart));
+        m_sink = DynamicCast<PacketSink> (apps.Get (0));
+      }
+    std::string matrixType = m_spec.Get ("traffic.matrix");
+    if (matrixType != "none")
+      {
+        NS_ABORT_MSG_IF (std::find (m_built.begin (), m_built.end (), false) != m_built.end (),
+                         "TopologyBuilder: traffic.matrix needs every partition");
+        NodeContainer all;
+        for (uint32_t i = 0; i < backboneNodes; ++i)
+          {
+            all.Add (m_lans[i]);
+          }
+        double rate = m_spec.GetDouble ("traffic.meanPacketsPerSecond");
+        uint32_t size = m_spec.GetUinteger ("traffic.packetSize");
+        TrafficMatrix matrix;
+        if (matrixType == "gateway")
+          {
+            matrix.AddAllToOne (all.GetN (), all.GetN () - 1, rate, size);
+          }
+        else if (matrixType == "random")
+          {
+            Ptr<UniformRandomVariable> pairs = CreateObject<UniformRandomVariable> ();
+            pairs->SetStream (MATRIX_STREAM);
+            matrix.AddRandomPairs (all.GetN (), m_spec.GetUinteger ("traffic.matrixFlows"), rate, size, pairs);
+          }
+        else
+          {
+            matrix.Load (matrixType, rate, size);
+          }
+        m_matrix.reset (new TrafficMatrixHelper (port + 1));
+        m_matrix->Install (matrix, all, Seconds (appStart), Seconds (stopTime - 1));
+        m_matrix->AssignStreams (MATRIX_STREAM + 1);
+      }
+    EndPhase (APPLICATIONS, start);
+  }
+
+  /// \return true if the given partition was built
+  bool IsBuilt (uint32_t partition) const
+  {
+    return m_built[partition];
+  }
+
+  /// \return number of partitions: the backbone and one per LAN
+  uint32_t GetNPartitions (void) const
+  {
+    return m_built.size ();
+  }
+
+  /// \return the backbone nodes
+  NodeContainer GetBackbone (void) const
+  {
+    return m_backbone;
+  }
+
+  /// \param i a backbone node \return the stations of its LAN
+  NodeContainer GetLan (uint32_t i) const
+  {
+    return m_lans[i];
+  }
+
+  /// \return the backbone devices, if the backbone was built
+  NetDeviceContainer GetBackboneDevices (void) const
+  {
+    return m_backboneDevices;
+  }
+
+  /// \param i a backbone node \return the devices of its LAN, if built
+  NetDeviceContainer GetLanDevices (uint32_t i) const
+  {
+    return m_lanDevices[i];
+  }
+
+  /// \param i a backbone node \return the channel of its LAN, with lans.phy "abstract"
+  Ptr<AbstractLanChannel> GetLanChannel (uint32_t i) const
+  {
+    return m_lanChannels[i];
+  }
+
+  /// \return the OffTime variable of the source, if built
+  Ptr<RandomVariableStream> GetOffTime (void) const
+  {
+    return m_offTime;
+  }
+
+  /// \return the sink application, if built
+  Ptr<PacketSink> GetSink (void) const
+  {
+    return m_sink;
+  }
+
+  /// \return the traffic matrix, if any
+  const TrafficMatrixHelper *GetMatrix (void) const
+  {
+    return m_matrix.get ();
+  }
+
+  /// \return the position table of the nodes, with mobility.engine "soa"
+  Ptr<PositionTable> GetPositions (void) const
+  {
+    return m_positions;
+  }
+
+  /// \param i a backbone node \return the network of its LAN
+  Ipv4Address GetLanNetwork (uint32_t i) const
+  {
+    return Ipv4Address (Ipv4Address (m_spec.Get ("lans.network").c_str ()).Get () + (i << 8));
+  }
+
+  /// \return the address of the last station of the last LAN
+  Ipv4Address GetSinkAddress (void) const
+  {
+    uint32_t backboneNodes = m_spec.GetUinteger ("backbone.nodes");
+    return Ipv4Address (GetLanNetwork (backboneNodes - 1).Get () + m_spec.GetUinteger ("lans.stations"));
+  }
+
+  /// \param phase a phase \return wall-clock seconds spent in it
+  double GetSeconds (Phase phase) const
+  {
+    return m_seconds[phase];
+  }
+
+  /// \param phase a phase \return its name
+  static const char *GetPhaseName (Phase phase)
+  {
+    static const char *names[N_PHASES] = {"nodes", "devices", "internet", "addresses",
+                                          "mobility", "streams", "applications"};
+    return names[phase];
+  }
+
+  /// \param os the output stream
+  void PrintPhaseTimes (std::ostream &os) const
+  {
+    double total = 0;
+    os << "TopologyBuilder:";
+    for (uint32_t i = 0; i < N_PHASES; ++i)
+      {
+        os << " " << GetPhaseName (static_cast<Phase> (i)) << " " << m_seconds[i] << " s,";
+        total += m_seconds[i];
+      }
+    os << " total " << total << " s" << std::endl;
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  Clock::time_point EndPhase (Phase phase, Clock::time_point start)
+  {
+    Clock::time_point now = Clock::now ();
+    m_seconds[phase] += std::chrono::duration<double> (now - start).count ();
+    if (phase + 1 < N_PHASES)
+      {
+        MemoryAccounting::Charge (GetPhaseName (static_cast<Phase> (phase + 1)));
+      }
+    return now;
+  }
+
+  /// \return the rate of lans.dataMode, e.g. 54 Mbps for "OfdmRate54Mbps"
+  DataRate GetLanDataRate (void) const
+  {
+    std::string mode = m_spec.Get ("lans.dataMode");
+    std::string::size_type begin = mode.find ("Rate");
+    std::string::size_type end = mode.find ("Mbps");
+    NS_ABORT_MSG_IF (begin == std::string::npos || end == std::string::npos || end < begin,
+                     "TopologyBuilder: no rate in lans.dataMode " << mode);
+    std::string rate = mode.substr (begin + 4, end - begin - 4);
+    std::replace (rate.begin (), rate.end (), '_', '.');
+    return DataRate (rate + "Mbps");
+  }
+
+  static void AssignMobilityStreams (NodeContainer nodes)
+  {
+    for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+      {
+        (*n)->GetObject<MobilityModel> ()->AssignStreams (MOBILITY_STREAM_BASE + MOBILITY_STREAM_STRIDE * (*n)->GetId ());
+      }
+  }
+
+  TopologySpec m_spec;                         //!< the topology
+  std::vector<bool> m_built;                   //!< built partitions
+  NodeContainer m_backbone;                    //!< backbone nodes
+  std::vector<NodeContainer> m_lans;           //!< stations of each LAN
+  NetDeviceContainer m_backboneDevices;        //!< backbone devices
+  std::vector<NetDeviceContainer> m_lanDevices; //!< devices of each LAN
+  std::vector<Ptr<AbstractLanChannel> > m_lanChannels; //!< abstract channel of each LAN, if any
+  Ptr<RandomVariableStream> m_offTime;         //!< OffTime of the source
+  Ptr<PacketSink> m_sink;                      //!< the sink
+  Ptr<PositionTable> m_positions;              //!< shared positions, if any
+  std::unique_ptr<TrafficMatrixHelper> m_matrix; //!< traffic matrix, if any
+  double m_seconds[N_PHASES];                  //!< time spent in each phase
+};
+
+} // namespace ns3
+
+#endif /* TOPOLOGY_BUILDER_H */
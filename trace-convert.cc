@@ -0,0 +1,297 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+//
+// Offline converter for the record files written by BinaryTraceHelper
+// (see binary-trace-helper.h).  It rebuilds the ascii trace that
+// WifiPhyHelper::EnableAsciiAll writes and one radiotap pcap file per
+// device, like WifiPhyHelper::EnablePcap:
+//
+// ./waf --run "trace-convert --input=taller1.trb --ascii=taller1.tr --pcap=taller1"
+//
+// Compressed record files (.gz, .zst) are decompressed on the fly.  The
+// ascii packet dump is rebuilt by decoding the headers these scenarios
+// put on the air (802.11, LLC/SNAP, ARP, IPv4, UDP, TCP and OLSR); any
+// other bytes are shown as payload.
+//
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/wifi-mac-trailer.h"
+#include "ns3/arp-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/tcp-header.h"
+#include "ns3/olsr-header.h"
+
+#include "binary-trace-helper.h"
+#include "pcapng-trace-helper.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TraceConvert");
+
+namespace {
+
+/// A wifi mode defined by a MODE record.
+struct ModeInfo
+{
+  std::string name;  //!< unique name of the mode
+  uint16_t rate;     //!< rate in units of 500 kb/s
+};
+
+template <typename H>
+void
+PrintHeader (std::ostream &os, Ptr<Packet> p, H &header)
+{
+  p->RemoveHeader (header);
+  os << header.GetInstanceTypeId ().GetName () << " (";
+  header.Print (os);
+  os << ") ";
+}
+
+//
+// Print a frame the way Packet::Print does for the packets of these
+// scenarios: "ns3::WifiMacHeader (...) ... Payload (size=N) ns3::WifiMacTrailer ()"
+//
+void
+PrintFrame (std::ostream &os, const uint8_t *data, uint32_t size)
+{
+  Ptr<Packet> p = Create<Packet> (data, size);
+  WifiMacTrailer fcs;
+  if (p->GetSize () >= fcs.GetSerializedSize ())
+    {
+      p->RemoveTrailer (fcs);
+    }
+  WifiMacHeader mac;
+  PrintHeader (os, p, mac);
+  if (mac.IsData () && p->GetSize () >= 8)
+    {
+      LlcSnapHeader llc;
+      PrintHeader (os, p, llc);
+      if (llc.GetType () == 0x0806)
+        {
+          ArpHeader arp;
+          PrintHeader (os, p, arp);
+        }
+      else if (llc.GetType () == 0x0800 && p->GetSize () >= 20)
+        {
+          Ipv4Header ip;
+          PrintHeader (os, p, ip);
+          if (ip.GetProtocol () == 17 && p->GetSize () >= 8)
+            {
+              UdpHeader udp;
+              PrintHeader (os, p, udp);
+              if (udp.GetDestinationPort () == 698)
+                {
+                  olsr::PacketHeader olsrPacket;
+                  PrintHeader (os, p, olsrPacket);
+                  // Stop at a message whose size is zero, shorter than
+                  // its header or longer than what is left: the rest is
+                  // shown as payload
+                  uint8_t prefix[4];
+                  while (p->GetSize () >= sizeof (prefix))
+                    {
+                      p->CopyData (prefix, sizeof (prefix));
+                      uint32_t messageSize = (prefix[2] << 8) | prefix[3];
+                      if (messageSize < 12 || messageSize > p->GetSize ())
+                        {
+                          break;
+                        }
+                      olsr::MessageHeader message;
+                      PrintHeader (os, p, message);
+                    }
+                }
+            }
+          else if (ip.GetProtocol () == 6 && p->GetSize () >= 20)
+            {
+              TcpHeader tcp;
+              PrintHeader (os, p, tcp);
+            }
+        }
+    }
+  if (p->GetSize () > 0)
+    {
+      os << "Payload (size=" << p->GetSize () << ") ";
+    }
+  os << "ns3::WifiMacTrailer ()";
+}
+
+//
+// Start a decompressor on a file, without a shell, and return the read
+// end of its output
+//
+FILE *
+OpenDecompressor (const char *program, const char *options, std::string input, pid_t *pid)
+{
+  int fds[2];
+  if (pipe (fds) != 0)
+    {
+      return 0;
+    }
+  *pid = fork ();
+  if (*pid < 0)
+    {
+      close (fds[0]);
+      close (fds[1]);
+      return 0;
+    }
+  if (*pid == 0)
+    {
+      dup2 (fds[1], STDOUT_FILENO);
+      close (fds[0]);
+      close (fds[1]);
+      execlp (program, program, options, "--", input.c_str (), (char *) 0);
+      _exit (127);
+    }
+  close (fds[1]);
+  return fdopen (fds[0], "rb");
+}
+
+} // unnamed namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "taller1.trb";
+  std::string ascii;
+  std::string pcap;
+  uint16_t frequency = 2412;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("input", "record file written by BinaryTraceHelper", input);
+  cmd.AddValue ("ascii", "ascii trace to write (empty: none)", ascii);
+  cmd.AddValue ("pcap", "prefix of the pcap files to write (empty: none)", pcap);
+  cmd.AddValue ("frequency", "channel frequency (MHz) stored in the radiotap headers", frequency);
+  cmd.Parse (argc, argv);
+
+  FILE *in;
+  pid_t decompressor = -1;
+  if (input.size () > 3 && input.compare (input.size () - 3, 3, ".gz") == 0)
+    {
+      in = OpenDecompressor ("gzip", "-dc", input, &decompressor);
+    }
+  else if (input.size () > 4 && input.compare (input.size () - 4, 4, ".zst") == 0)
+    {
+      in = OpenDecompressor ("zstd", "-dqc", input, &decompressor);
+    }
+  else
+    {
+      in = fopen (input.c_str (), "rb");
+    }
+  NS_ABORT_MSG_IF (in == 0, "cannot open " << input);
+
+  std::ofstream asciiOut;
+  if (!ascii.empty ())
+    {
+      asciiOut.open (ascii.c_str ());
+    }
+  std::map<std::pair<uint32_t, uint16_t>, PcapFile *> pcapFiles;
+  std::vector<ModeInfo> modes (256);
+  std::vector<uint8_t> data;
+  uint8_t header[BinaryTraceHelper::HEADER_SIZE];
+  uint64_t records = 0;
+
+  while (fread (header, 1, sizeof (header), in) == sizeof (header))
+    {
+      uint8_t type = header[0];
+      uint8_t modeId = header[1];
+      uint16_t device;
+      uint32_t node;
+      int64_t timeNs;
+      uint32_t length;
+      std::memcpy (&device, header + 2, 2);
+      std::memcpy (&node, header + 4, 4);
+      std::memcpy (&timeNs, header + 8, 8);
+      std::memcpy (&length, header + 16, 4);
+      int8_t snr = static_cast<int8_t> (header[20]);
+      data.resize (length);
+      if (length > 0 && fread (&data[0], 1, length, in) != length)
+        {
+          NS_LOG_UNCOND ("truncated record at the end of " << input);
+          break;
+        }
+      ++records;
+
+      if (type == BinaryTraceHelper::MODE)
+        {
+          if (length < 2)
+            {
+              NS_LOG_UNCOND ("malformed MODE record " << records << " in " << input);
+              break;
+            }
+          std::memcpy (&modes[modeId].rate, &data[0], 2);
+          modes[modeId].name.assign (reinterpret_cast<const char *> (&data[2]), length - 2);
+          continue;
+        }
+      bool rx = type == BinaryTraceHelper::RX;
+
+      if (asciiOut.is_open ())
+        {
+          asciiOut << (rx ? "r " : "t ") << NanoSeconds (timeNs).GetSeconds ()
+                   << " /NodeList/" << node << "/DeviceList/" << device
+                   << "/$ns3::WifiNetDevice/Phy/State/" << (rx ? "RxOk " : "Tx ")
+                   << modes[modeId].name << " ";
+          PrintFrame (asciiOut, length > 0 ? &data[0] : 0, length);
+          asciiOut << std::endl;
+        }
+
+      if (!pcap.empty ())
+        {
+          PcapFile *&file = pcapFiles[std::make_pair (node, device)];
+          if (file == 0)
+            {
+              std::ostringstream name;
+              name << pcap << "-" << node << "-" << device << ".pcap";
+              file = new PcapFile ();
+              file->Open (name.str (), std::ios::out | std::ios::binary);
+              file->Init (PcapHelper::DLT_IEEE802_11_RADIO, 65535);
+            }
+          std::vector<uint8_t> frame (RADIOTAP_MAX_SIZE);
+          bool cck = modes[modeId].name.compare (0, 4, "Dsss") == 0;
+          frame.resize (WriteRadiotapHeader (&frame[0], timeNs, modes[modeId].rate, cck, frequency, rx, snr));
+          frame.insert (frame.end (), data.begin (), data.end ());
+          file->Write (timeNs / 1000000000, (timeNs / 1000) % 1000000, &frame[0], frame.size ());
+        }
+    }
+
+  for (std::map<std::pair<uint32_t, uint16_t>, PcapFile *>::iterator i = pcapFiles.begin (); i != pcapFiles.end (); ++i)
+    {
+      i->second->Close ();
+      delete i->second;
+    }
+  fclose (in);
+  if (decompressor > 0)
+    {
+      int status;
+      waitpid (decompressor, &status, 0);
+      NS_ABORT_MSG_UNLESS (WIFEXITED (status) && WEXITSTATUS (status) == 0,
+                           "decompressing " << input << " failed");
+    }
+  NS_LOG_UNCOND ("Converted " << records << " records from " << input);
+  return 0;
+}
@@ -0,0 +1,663 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TRAFFIC_MATRIX_H
+#define TRAFFIC_MATRIX_H
+
+//
+// Many-to-many UDP workloads.
+//
+// A TrafficMatrix lists flows between node indices, each with a Poisson
+// packet rate and a packet size.  It is filled with
+//
+//  - AddAllToOne: every node to a gateway;
+//  - AddRandomPairs: flows between random distinct nodes;
+//  - Load: a CSV file of "source,destination[,packetsPerSecond[,packetSize]]"
+//    lines, with '#' comments; missing columns take the defaults given.
+//
+// TrafficMatrixHelper installs a matrix with one TrafficMatrixSource per
+// sending node and one TrafficMatrixSink per receiving node, whatever the
+// number of flows: a flow is a row in the vectors of its source and a
+// counter in the table of its sink, not an application, a socket and a
+// random variable of its own.  Every packet carries a 12-byte header
+// with its flow id and send time; the sink keeps the packets, bytes and
+// delay of each flow in a flat open-addressing hash table keyed by the
+// flow id, so accounting a packet is one probe in a contiguous array.
+//
+// WriteSummary writes one CSV row per flow:
+//
+//   flow,source,destination,txPackets,rxPackets,rxBytes,meanDelayMs
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/application.h"
+#include "ns3/double.h"
+#include "ns3/event-id.h"
+#include "ns3/header.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+/**
+ * \brief Flow id and send time carried by every workload packet.
+ */
+class TrafficMatrixHeader : public Header
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::TrafficMatrixHeader")
+      .SetParent<Header> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<TrafficMatrixHeader> ()
+    ;
+    return tid;
+  }
+
+  TrafficMatrixHeader ()
+    : m_flow (0),
+      m_txTime (0)
+  {
+  }
+
+  void SetFlow (uint32_t flow)
+  {
+    m_flow = flow;
+  }
+
+  uint32_t GetFlow (void) const
+  {
+    return m_flow;
+  }
+
+  void SetTxTime (Time time)
+  {
+    m_txTime = time.GetNanoSeconds ();
+  }
+
+  Time GetTxTime (void) const
+  {
+    return NanoSeconds (m_txTime);
+  }
+
+  // inherited from Header
+  virtual TypeId GetInstanceTypeId (void) const
+  {
+    return GetTypeId ();
+  }
+
+  virtual uint32_t GetSerializedSize (void) const
+  {
+    return 12;
+  }
+
+  virtual void Serialize (Buffer::Iterator start) const
+  {
+    start.WriteHtonU32 (m_flow);
+    start.WriteHtonU64 (m_txTime);
+  }
+
+  virtual uint32_t Deserialize (Buffer::Iterator start)
+  {
+    m_flow = start.ReadNtohU32 ();
+    m_txTime = start.ReadNtohU64 ();
+    return 12;
+  }
+
+  virtual void Print (std::ostream &os) const
+  {
+    os << "flow=" << m_flow << " txTime=+" << m_txTime << "ns";
+  }
+
+private:
+  uint32_t m_flow;     //!< flow id
+  int64_t m_txTime;    //!< send time (ns)
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TrafficMatrixHeader);
+
+/**
+ * \brief Flows between node indices.
+ */
+class TrafficMatrix
+{
+public:
+  /// One flow.
+  struct Flow
+  {
+    uint32_t source;            //!< index of the sending node
+    uint32_t destination;       //!< index of the receiving node
+    double packetsPerSecond;    //!< mean Poisson packet rate
+    uint32_t packetSize;        //!< bytes, header included
+  };
+
+  /// \return a new flow id
+  uint32_t AddFlow (uint32_t source, uint32_t destination, double packetsPerSecond, uint32_t packetSize)
+  {
+    NS_ABORT_MSG_IF (source == destination, "TrafficMatrix: flow from node " << source << " to itself");
+    NS_ABORT_MSG_UNLESS (packetsPerSecond > 0, "TrafficMatrix: flow rate must be positive");
+    Flow flow = {source, destination, packetsPerSecond, packetSize};
+    m_flows.push_back (flow);
+    return m_flows.size () - 1;
+  }
+
+  /// \brief Add a flow from every one of n nodes but the gateway to it.
+  void AddAllToOne (uint32_t n, uint32_t gateway, double packetsPerSecond, uint32_t packetSize)
+  {
+    for (uint32_t i = 0; i < n; ++i)
+      {
+        if (i != gateway)
+          {
+            AddFlow (i, gateway, packetsPerSecond, packetSize);
+          }
+      }
+  }
+
+  /**
+   * \brief Add flows between random distinct nodes among n.
+   * \param rng the variable the pairs are drawn from
+   */
+  void AddRandomPairs (uint32_t n, uint32_t flows, double packetsPerSecond, uint32_t packetSize,
+                       Ptr<UniformRandomVariable> rng)
+  {
+    NS_ABORT_MSG_IF (n < 2, "TrafficMatrix: random pairs need two nodes");
+    for (uint32_t k = 0; k < flows; ++k)
+      {
+        uint32_t source = rng->GetInteger (0, n - 1);
+        uint32_t destination = rng->GetInteger (0, n - 2);
+        destination += destination >= source ? 1 : 0;
+        AddFlow (source, destination, packetsPerSecond, packetSize);
+      }
+  }
+
+  /**
+   * \brief Add the flows of a CSV file.
+   * \param filename the file
+   * \param packetsPerSecond rate of the lines without one
+   * \param packetSize size of the lines without one
+   */
+  void Load (std::string filename, double packetsPerSecond, uint32_t packetSize)
+  {
+    std::ifstream is (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (is.is_open (), "TrafficMatrix: cannot open " << filename);
+    std::string line;
+    for (uint32_t number = 1; std::getline (is, line); ++number)
+      {
+        line = line.substr (0, line.find ('#'));
+        if (line.find_first_not_of (" \t\r") == std::string::npos)
+          {
+            continue;
+          }
+        std::replace (line.begin (), line.end (), ',', ' ');
+        std::istringstream fields (line);
+        uint32_t source;
+        uint32_t destination;
+        NS_ABORT_MSG_UNLESS (fields >> source >> destination, filename << ":" << number << ": bad flow");
+        double rate = packetsPerSecond;
+        uint32_t size = packetSize;
+        if (fields >> rate)
+          {
+            fields >> size;
+          }
+        AddFlow (source, destination, rate, size);
+      }
+  }
+
+  /// \return number of flows
+  uint32_t GetN (void) const
+  {
+    return m_flows.size ();
+  }
+
+  /// \param i a flow id \return the flow
+  const Flow &Get (uint32_t i) const
+  {
+    return m_flows[i];
+  }
+
+private:
+  std::vector<Flow> m_flows;  //!< the flows, by id
+};
+
+/**
+ * \brief Sending end of all the workload flows of a node.
+ */
+class TrafficMatrixSource : public Application
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::TrafficMatrixSource")
+      .SetParent<Application> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<TrafficMatrixSource> ()
+    ;
+    return tid;
+  }
+
+  TrafficMatrixSource ()
+  {
+    m_interval = CreateObject<ExponentialRandomVariable> ();
+    m_interval->SetAttribute ("Mean", DoubleValue (1));
+  }
+
+  /**
+   * \brief Add a flow sent by this node.
+   * \param flow the flow id
+   * \param destination the address and port of its sink
+   * \param packetsPerSecond its mean Poisson rate
+   * \param packetSize its packet size, header included
+   */
+  void AddFlow (uint32_t flow, InetSocketAddress destination, double packetsPerSecond, uint32_t packetSize)
+  {
+    m_flows.push_back (flow);
+    m_destinations.push_back (destination);
+    m_meanIntervals.push_back (1.0 / packetsPerSecond);
+    m_payloads.push_back (packetSize > 12 ? packetSize - 12 : 0);
+    m_txPackets.push_back (0);
+  }
+
+  /// \param stream the stream of the packet intervals \return 1
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_interval->SetStream (stream);
+    return 1;
+  }
+
+  /// \return number of flows of the node
+  uint32_t GetNFlows (void) const
+  {
+    return m_flows.size ();
+  }
+
+  /// \param i a flow of the node \return its flow id
+  uint32_t GetFlow (uint32_t i) const
+  {
+    return m_flows[i];
+  }
+
+  /// \param i a flow of the node \return packets sent on it
+  uint64_t GetTxPackets (uint32_t i) const
+  {
+    return m_txPackets[i];
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_socket = 0;
+    m_interval = 0;
+    Application::DoDispose ();
+  }
+
+private:
+  virtual void StartApplication (void)
+  {
+    m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+    m_socket->Bind ();
+    m_socket->ShutdownRecv ();
+    m_events.resize (m_flows.size ());
+    for (uint32_t i = 0; i < m_flows.size (); ++i)
+      {
+        ScheduleNext (i);
+      }
+  }
+
+  virtual void StopApplication (void)
+  {
+    for (uint32_t i = 0; i < m_events.size (); ++i)
+      {
+        m_events[i].Cancel ();
+      }
+    if (m_socket != 0)
+      {
+        m_socket->Close ();
+      }
+  }
+
+  void ScheduleNext (uint32_t i)
+  {
+    Time delay = Seconds (m_interval->GetValue () * m_meanIntervals[i]);
+    m_events[i] = Simulator::Schedule (delay, &TrafficMatrixSource::Send, this, i);
+  }
+
+  void Send (uint32_t i)
+  {
+    Ptr<Packet> packet = Create<Packet> (m_payloads[i]);
+    TrafficMatrixHeader header;
+    header.SetFlow (m_flows[i]);
+    header.SetTxTime (Simulator::Now ());
+    packet->AddHeader (header);
+    m_socket->SendTo (packet, 0, m_destinations[i]);
+    ++m_txPackets[i];
+    ScheduleNext (i);
+  }
+
+  Ptr<Socket> m_socket;                          //!< socket of every flow
+  Ptr<ExponentialRandomVariable> m_interval;     //!< unit-mean intervals
+  std::vector<uint32_t> m_flows;                 //!< flow ids
+  std::vector<InetSocketAddress> m_destinations; //!< sink of each flow
+  std::vector<double> m_meanIntervals;           //!< mean interval (s) of each flow
+  std::vector<uint32_t> m_payloads;              //!< payload bytes of each flow
+  std::vector<uint64_t> m_txPackets;             //!< packets sent on each flow
+  std::vector<EventId> m_events;                 //!< next packet of each flow
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TrafficMatrixSource);
+
+/**
+ * \brief Receiving end of all the workload flows of a node, with the
+ * per-flow counters in a flat hash table.
+ */
+class TrafficMatrixSink : public Application
+{
+public:
+  /// Counters of one flow.
+  struct Counters
+  {
+    uint32_t flow;        //!< flow id, EMPTY in a free slot
+    uint64_t packets;     //!< packets received
+    uint64_t bytes;       //!< bytes received
+    int64_t delay;        //!< sum of the delays (ns)
+  };
+
+  static const uint32_t EMPTY = 0xffffffff;  //!< flow id of a free slot
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::TrafficMatrixSink")
+      .SetParent<Application> ()
+      .SetGroupName ("Applications")
+      .AddConstructor<TrafficMatrixSink> ()
+      .AddAttribute ("Port", "Port the flows are received on.",
+                     UintegerValue (9),
+                     MakeUintegerAccessor (&TrafficMatrixSink::m_port),
+                     MakeUintegerChecker<uint16_t> ())
+    ;
+    return tid;
+  }
+
+  TrafficMatrixSink ()
+    : m_port (9),
+      m_size (0),
+      m_shift (29)
+  {
+    Counters empty = {EMPTY, 0, 0, 0};
+    m_slots.assign (8, empty);
+  }
+
+  /**
+   * \param flow a flow id
+   * \return its counters, or 0 if it received nothing
+   */
+  const Counters *Find (uint32_t flow) const
+  {
+    for (uint32_t i = Hash (flow);; i = (i + 1) & (m_slots.size () - 1))
+      {
+        if (m_slots[i].flow == flow)
+          {
+            return &m_slots[i];
+          }
+        if (m_slots[i].flow == EMPTY)
+          {
+            return 0;
+          }
+      }
+  }
+
+  /// \return number of flows received
+  uint32_t GetNFlows (void) const
+  {
+    return m_size;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_socket = 0;
+    Application::DoDispose ();
+  }
+
+private:
+  virtual void StartApplication (void)
+  {
+    m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+    NS_ABORT_MSG_IF (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port)) != 0,
+                     "TrafficMatrixSink: cannot bind port " << m_port);
+    m_socket->SetRecvCallback (MakeCallback (&TrafficMatrixSink::HandleRead, this));
+  }
+
+  virtual void StopApplication (void)
+  {
+    if (m_socket != 0)
+      {
+        m_socket->Close ();
+        m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      }
+  }
+
+  void HandleRead (Ptr<Socket> socket)
+  {
+    Ptr<Packet> packet;
+    while ((packet = socket->Recv ()))
+      {
+        TrafficMatrixHeader header;
+        if (packet->PeekHeader (header) != 12)
+          {
+            continue;
+          }
+        Counters &counters = Get (header.GetFlow ());
+        ++counters.packets;
+        counters.bytes += packet->GetSize ();
+        counters.delay += (Simulator::Now () - header.GetTxTime ()).GetNanoSeconds ();
+      }
+  }
+
+  uint32_t Hash (uint32_t flow) const
+  {
+    return (flow * 2654435761u) >> m_shift;
+  }
+
+  /// \return the counters of a flow, inserted if new
+  Counters &Get (uint32_t flow)
+  {
+    uint32_t i = Hash (flow);
+    for (; m_slots[i].flow != EMPTY; i = (i + 1) & (m_slots.size () - 1))
+      {
+        if (m_slots[i].flow == flow)
+          {
+            return m_slots[i];
+          }
+      }
+    if (2 * (m_size + 1) > m_slots.size ())
+      {
+        Grow ();
+        return Get (flow);
+      }
+    ++m_size;
+    m_slots[i].flow = flow;
+    return m_slots[i];
+  }
+
+  /// Double the table, keeping its load below one half.
+  void Grow (void)
+  {
+    std::vector<Counters> old;
+    old.swap (m_slots);
+    Counters empty = {EMPTY, 0, 0, 0};
+    m_slots.assign (old.size () * 2, empty);
+    --m_shift;
+    for (uint32_t k = 0; k < old.size (); ++k)
+      {
+        if (old[k].flow != EMPTY)
+          {
+            uint32_t i = Hash (old[k].flow);
+            while (m_slots[i].flow != EMPTY)
+              {
+                i = (i + 1) & (m_slots.size () - 1);
+              }
+            m_slots[i] = old[k];
+          }
+      }
+  }
+
+  uint16_t m_port;                  //!< port of the flows
+  Ptr<Socket> m_socket;             //!< the socket
+  std::vector<Counters> m_slots;    //!< open-addressing table, a power of two
+  uint32_t m_size;                  //!< flows in the table
+  uint32_t m_shift;                 //!< 32 - log2 of the table size
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TrafficMatrixSink);
+
+/**
+ * \brief Install a TrafficMatrix on nodes and report its flows.
+ */
+class TrafficMatrixHelper
+{
+public:
+  /**
+   * \param port port of the sinks
+   */
+  TrafficMatrixHelper (uint16_t port = 9)
+    : m_port (port)
+  {
+  }
+
+  /**
+   * \brief Install the sources and sinks of a matrix.
+   * \param matrix the flows, between indices of nodes
+   * \param nodes the nodes, with an IPv4 address on interface 1
+   * \param start the start time of every flow
+   * \param stop the stop time of every flow
+   */
+  void Install (const TrafficMatrix &matrix, NodeContainer nodes, Time start, Time stop)
+  {
+    m_matrix = matrix;
+    m_nodes = nodes;
+    m_sources.assign (nodes.GetN (), Ptr<TrafficMatrixSource> ());
+    m_sinks.assign (nodes.GetN (), Ptr<TrafficMatrixSink> ());
+    for (uint32_t f = 0; f < matrix.GetN (); ++f)
+      {
+        const TrafficMatrix::Flow &flow = matrix.Get (f);
+        NS_ABORT_MSG_UNLESS (flow.source < nodes.GetN () && flow.destination < nodes.GetN (),
+                             "TrafficMatrix: flow " << f << " between nodes beyond " << nodes.GetN ());
+        if (m_sinks[flow.destination] == 0)
+          {
+            m_sinks[flow.destination] = CreateObject<TrafficMatrixSink> ();
+            m_sinks[flow.destination]->SetAttribute ("Port", UintegerValue (m_port));
+            Install (m_sinks[flow.destination], nodes.Get (flow.destination), start, stop);
+          }
+        if (m_sources[flow.source] == 0)
+          {
+            m_sources[flow.source] = CreateObject<TrafficMatrixSource> ();
+            Install (m_sources[flow.source], nodes.Get (flow.source), start, stop);
+          }
+        Ipv4Address address = nodes.Get (flow.destination)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+        m_sources[flow.source]->AddFlow (f, InetSocketAddress (address, m_port),
+                                         flow.packetsPerSecond, flow.packetSize);
+      }
+  }
+
+  /**
+   * \param stream first stream of the packet intervals, one per source
+   * \return number of streams used
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    int64_t current = stream;
+    for (uint32_t i = 0; i < m_sources.size (); ++i)
+      {
+        if (m_sources[i] != 0)
+          {
+            current += m_sources[i]->AssignStreams (current);
+          }
+      }
+    return current - stream;
+  }
+
+  /// \param os the output stream
+  void WriteSummary (std::ostream &os) const
+  {
+    os << "flow,source,destination,txPackets,rxPackets,rxBytes,meanDelayMs" << std::endl;
+    std::vector<uint64_t> txPackets (m_matrix.GetN (), 0);
+    for (uint32_t i = 0; i < m_sources.size (); ++i)
+      {
+        for (uint32_t k = 0; m_sources[i] != 0 && k < m_sources[i]->GetNFlows (); ++k)
+          {
+            txPackets[m_sources[i]->GetFlow (k)] = m_sources[i]->GetTxPackets (k);
+          }
+      }
+    for (uint32_t f = 0; f < m_matrix.GetN (); ++f)
+      {
+        const TrafficMatrix::Flow &flow = m_matrix.Get (f);
+        const TrafficMatrixSink::Counters *rx = m_sinks[flow.destination]->Find (f);
+        os << f << "," << m_nodes.Get (flow.source)->GetId () << "," << m_nodes.Get (flow.destination)->GetId ()
+           << "," << txPackets[f] << "," << (rx ? rx->packets : 0) << "," << (rx ? rx->bytes : 0) << ","
+           << (rx ? rx->delay / 1e6 / rx->packets : 0) << "\n";
+      }
+  }
+
+  /// \param os the output stream
+  void PrintStats (std::ostream &os) const
+  {
+    uint32_t sources = 0;
+    uint32_t sinks = 0;
+    for (uint32_t i = 0; i < m_sources.size (); ++i)
+      {
+        sources += m_sources[i] != 0;
+        sinks += m_sinks[i] != 0;
+      }
+    os << "TrafficMatrix: " << m_matrix.GetN () << " flows, "
+       << sources << " sources, " << sinks << " sinks" << std::endl;
+  }
+
+private:
+  static void Install (Ptr<Application> app, Ptr<Node> node, Time start, Time stop)
+  {
+    node->AddApplication (app);
+    app->SetStartTime (start);
+    app->SetStopTime (stop);
+  }
+
+  uint16_t m_port;                                 //!< port of the sinks
+  TrafficMatrix m_matrix;                          //!< the installed flows
+  NodeContainer m_nodes;                           //!< nodes of the indices
+  std::vector<Ptr<TrafficMatrixSource> > m_sources; //!< source of each node, if any
+  std::vector<Ptr<TrafficMatrixSink> > m_sinks;     //!< sink of each node, if any
+};
+
+} // namespace ns3
+
+#endif /* TRAFFIC_MATRIX_H */